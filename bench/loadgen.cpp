@@ -0,0 +1,958 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "../code/metrics/metrics.h"
+
+using namespace std;
+
+/*
+ * HTTP/1.1 压测工具: 每个线程一个 epoll, 管理自己的一组长连接.
+ * 闭环: 每个连接保持 pipeline 个请求在途, 收到响应立即补发;
+ * 开环: 按固定速率生成请求, 延迟从"计划发出时间"算起, 连接全忙时请求排队等待,
+ *       排队时间计入延迟(修正 coordinated omission)
+ */
+namespace
+{
+    struct Options
+    {
+        string host = "127.0.0.1";
+        int port = 1316;
+        int threads = 2;
+        int connections = 50;
+        double duration = 10;
+        double warmup = 2;
+        double rate = 0; /* 总请求速率, 0 为闭环 */
+        int pipeline = 1;
+        bool keepAlive = true;
+        string mix = "GET /=1";
+        string resources;
+        string login = "bench:bench";
+        string json;
+        string label;
+        unsigned seed = 1;
+    };
+
+    struct RequestTemplate
+    {
+        string name;
+        string text;
+        int weight;
+    };
+
+    /* 一个在途请求; intended 为计划发出时间, 闭环下等于实际发出时间 */
+    struct Pending
+    {
+        uint64_t intended;
+        uint64_t sent;
+        size_t tpl;
+    };
+
+    /* 增量解析响应, 只记录状态码与是否关闭连接, 响应体直接跳过 */
+    class ResponseParser
+    {
+    public:
+        ResponseParser() { Reset(); }
+
+        void Reset()
+        {
+            state = HEAD;
+            head.clear();
+            remain = 0;
+            code = 0;
+            close = false;
+            chunked = false;
+        }
+
+        /* 返回消费的字节数, 一条响应结束时 *done 为 true 并停在响应边界 */
+        size_t Feed(const char *data, size_t len, bool *done, bool *error)
+        {
+            size_t pos = 0;
+            *done = false;
+            while (pos < len && !*done && !*error)
+            {
+                switch (state)
+                {
+                case HEAD:
+                case CHUNK_SIZE:
+                case TRAILER:
+                {
+                    const char *lf = static_cast<const char *>(memchr(data + pos, '\n', len - pos));
+                    size_t n = lf ? lf - (data + pos) + 1 : len - pos;
+                    head.append(data + pos, n);
+                    pos += n;
+                    if (head.size() > MAX_HEAD)
+                    {
+                        *error = true;
+                    }
+                    else if (lf)
+                    {
+                        OnLine(done, error);
+                    }
+                    break;
+                }
+                case BODY:
+                case CHUNK_DATA:
+                {
+                    size_t n = min(remain, len - pos);
+                    pos += n;
+                    remain -= n;
+                    if (remain == 0)
+                    {
+                        if (state == BODY)
+                        {
+                            *done = true;
+                        }
+                        else
+                        {
+                            state = CHUNK_CRLF;
+                            remain = 2;
+                        }
+                    }
+                    break;
+                }
+                case CHUNK_CRLF:
+                {
+                    size_t n = min(remain, len - pos);
+                    pos += n;
+                    remain -= n;
+                    if (remain == 0)
+                    {
+                        state = CHUNK_SIZE;
+                    }
+                    break;
+                }
+                }
+            }
+            return pos;
+        }
+
+        int code;
+        bool close;
+
+    private:
+        enum STATE
+        {
+            HEAD,
+            BODY,
+            CHUNK_SIZE,
+            CHUNK_DATA,
+            CHUNK_CRLF,
+            TRAILER,
+        };
+
+        static const size_t MAX_HEAD = 64 * 1024;
+
+        void OnLine(bool *done, bool *error)
+        {
+            if (state == CHUNK_SIZE)
+            {
+                char *end = nullptr;
+                remain = strtoul(head.c_str(), &end, 16);
+                if (end == head.c_str())
+                {
+                    *error = true;
+                }
+                head.clear();
+                state = remain ? CHUNK_DATA : TRAILER;
+                return;
+            }
+            if (state == TRAILER)
+            {
+                bool last = head == "\r\n" || head == "\n";
+                head.clear();
+                *done = last;
+                return;
+            }
+            /* 头部以空行结束 */
+            size_t n = head.size();
+            if (!(n >= 4 && head.compare(n - 4, 4, "\r\n\r\n") == 0) && !(n >= 2 && head.compare(n - 2, 2, "\n\n") == 0))
+            {
+                return;
+            }
+            if (head.compare(0, 5, "HTTP/") != 0 || head.size() < 12)
+            {
+                *error = true;
+                return;
+            }
+            code = atoi(head.c_str() + 9);
+            remain = 0;
+            size_t lineStart = head.find('\n') + 1;
+            while (lineStart < head.size())
+            {
+                size_t lineEnd = head.find('\n', lineStart);
+                const char *line = head.c_str() + lineStart;
+                if (strncasecmp(line, "Content-Length:", 15) == 0)
+                {
+                    remain = strtoull(line + 15, nullptr, 10);
+                }
+                else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked"))
+                {
+                    chunked = true;
+                }
+                else if (strncasecmp(line, "Connection:", 11) == 0)
+                {
+                    const char *value = line + 11;
+                    while (*value == ' ')
+                    {
+                        value++;
+                    }
+                    close = strncasecmp(value, "close", 5) == 0;
+                }
+                lineStart = lineEnd + 1;
+            }
+            head.clear();
+            if (code >= 100 && code < 200)
+            {
+                /* 100 Continue 之类的临时响应, 继续等真正的响应 */
+                state = HEAD;
+                return;
+            }
+            if (chunked)
+            {
+                state = CHUNK_SIZE;
+            }
+            else if (remain > 0)
+            {
+                state = BODY;
+            }
+            else
+            {
+                *done = true;
+            }
+        }
+
+        STATE state;
+        string head;
+        size_t remain;
+        bool chunked;
+    };
+
+    struct Conn
+    {
+        int fd = -1;
+        bool connecting = false;
+        bool closing = false; /* 服务端声明关闭, 在途请求收完后重连 */
+        string out;
+        size_t outPos = 0;
+        deque<Pending> inflight;
+        ResponseParser parser;
+    };
+
+    struct Result
+    {
+        Histogram latency;            /* 从计划发出时间算起 */
+        Histogram latencyUncorrected; /* 从实际写出时间算起 */
+        uint64_t requests = 0;
+        uint64_t status[6] = {0};     /* 下标为状态码百位, 0 为其他 */
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t errors = 0;
+        uint64_t reconnects = 0;
+        uint64_t backlog = 0; /* 结束时还没发出的请求(开环) */
+    };
+
+    class Worker
+    {
+    public:
+        Worker(const Options &opt, const vector<RequestTemplate> &tpls, const sockaddr_in &addr,
+               int connCount, double rate, unsigned seed)
+            : opt(opt), tpls(tpls), addr(addr), conns(connCount), rate(rate), rng(seed ? seed : 1)
+        {
+            totalWeight = 0;
+            for (const RequestTemplate &tpl : tpls)
+            {
+                totalWeight += tpl.weight;
+            }
+        }
+
+        void Run(uint64_t start, uint64_t measureStart, uint64_t end)
+        {
+            this->measureStart = measureStart;
+            epfd = epoll_create1(0);
+            for (Conn &conn : conns)
+            {
+                Connect(conn);
+            }
+            uint64_t interval = rate > 0 ? static_cast<uint64_t>(1e9 / rate) : 0;
+            uint64_t nextSend = start;
+            /* 开环的发送时刻精确到微秒, epoll_wait 的毫秒超时不够用, 也不能空转抢占被测服务的 CPU */
+            int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+            epoll_event timerEv = {0};
+            timerEv.events = EPOLLIN;
+            timerEv.data.u32 = TIMER_ID;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, timerFd, &timerEv);
+            epoll_event events[256];
+            while (true)
+            {
+                uint64_t now = Metrics::Now();
+                if (now >= end)
+                {
+                    break;
+                }
+                if (interval)
+                {
+                    /* 到点的请求先进入队列, 计划时间不受连接是否空闲影响 */
+                    while (nextSend <= now)
+                    {
+                        backlog.push_back(Pending{nextSend, 0, Pick()});
+                        nextSend += interval;
+                    }
+                }
+                Dispatch(now);
+                if (interval)
+                {
+                    itimerspec its = {{0, 0}, {static_cast<time_t>(nextSend / 1000000000), static_cast<long>(nextSend % 1000000000)}};
+                    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &its, nullptr);
+                }
+                int n = epoll_wait(epfd, events, 256, 10);
+                for (int i = 0; i < n; i++)
+                {
+                    if (events[i].data.u32 == TIMER_ID)
+                    {
+                        uint64_t expirations;
+                        ssize_t ret = read(timerFd, &expirations, sizeof(expirations));
+                        (void)ret;
+                        continue;
+                    }
+                    Conn &conn = conns[events[i].data.u32];
+                    if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    {
+                        Reconnect(conn, true);
+                        continue;
+                    }
+                    if (events[i].events & EPOLLOUT)
+                    {
+                        OnWritable(conn);
+                    }
+                    if (events[i].events & EPOLLIN)
+                    {
+                        OnReadable(conn);
+                    }
+                }
+            }
+            result.backlog = backlog.size();
+            close(timerFd);
+            for (Conn &conn : conns)
+            {
+                if (conn.fd >= 0)
+                {
+                    close(conn.fd);
+                }
+            }
+            close(epfd);
+        }
+
+        Result result;
+
+    private:
+        static const uint32_t TIMER_ID = UINT32_MAX;
+
+        size_t Pick()
+        {
+            /* xorshift32, 给定种子时请求序列可复现 */
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            int r = static_cast<int>(rng % static_cast<unsigned>(totalWeight));
+            for (size_t i = 0; i < tpls.size(); i++)
+            {
+                r -= tpls[i].weight;
+                if (r < 0)
+                {
+                    return i;
+                }
+            }
+            return 0;
+        }
+
+        void Connect(Conn &conn)
+        {
+            conn.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (conn.fd < 0)
+            {
+                result.errors++;
+                return;
+            }
+            int one = 1;
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            conn.connecting = true;
+            conn.closing = false;
+            conn.out.clear();
+            conn.outPos = 0;
+            conn.parser.Reset();
+            if (connect(conn.fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS)
+            {
+                result.errors++;
+                close(conn.fd);
+                conn.fd = -1;
+                return;
+            }
+            epoll_event ev = {0};
+            ev.events = EPOLLIN | EPOLLOUT;
+            ev.data.u32 = static_cast<uint32_t>(&conn - &conns[0]);
+            epoll_ctl(epfd, EPOLL_CTL_ADD, conn.fd, &ev);
+        }
+
+        /* 未收到响应的请求放回队首, 保留计划时间后重发 */
+        void Reconnect(Conn &conn, bool error)
+        {
+            if (conn.fd >= 0)
+            {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, conn.fd, nullptr);
+                close(conn.fd);
+                conn.fd = -1;
+            }
+            if (error && !conn.inflight.empty())
+            {
+                result.errors++;
+            }
+            while (!conn.inflight.empty())
+            {
+                Pending p = conn.inflight.back();
+                conn.inflight.pop_back();
+                if (rate > 0)
+                {
+                    backlog.push_front(p);
+                }
+            }
+            result.reconnects++;
+            Connect(conn);
+        }
+
+        void Dispatch(uint64_t now)
+        {
+            for (Conn &conn : conns)
+            {
+                if (conn.fd < 0)
+                {
+                    Reconnect(conn, false);
+                    continue;
+                }
+                if (conn.closing)
+                {
+                    continue;
+                }
+                bool queued = false;
+                int depth = opt.keepAlive ? opt.pipeline : 1;
+                while (static_cast<int>(conn.inflight.size()) < depth)
+                {
+                    Pending p;
+                    if (rate > 0)
+                    {
+                        if (backlog.empty())
+                        {
+                            break;
+                        }
+                        p = backlog.front();
+                        backlog.pop_front();
+                    }
+                    else
+                    {
+                        p = Pending{now, 0, Pick()};
+                    }
+                    p.sent = now;
+                    conn.out += tpls[p.tpl].text;
+                    conn.inflight.push_back(p);
+                    queued = true;
+                }
+                if (queued && !conn.connecting)
+                {
+                    OnWritable(conn);
+                }
+                if (rate > 0 && backlog.empty())
+                {
+                    break;
+                }
+            }
+        }
+
+        void OnWritable(Conn &conn)
+        {
+            if (conn.connecting)
+            {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err)
+                {
+                    Reconnect(conn, true);
+                    return;
+                }
+                conn.connecting = false;
+            }
+            while (conn.outPos < conn.out.size())
+            {
+                ssize_t n = send(conn.fd, conn.out.data() + conn.outPos, conn.out.size() - conn.outPos, MSG_NOSIGNAL);
+                if (n <= 0)
+                {
+                    if (n < 0 && errno == EAGAIN)
+                    {
+                        break;
+                    }
+                    Reconnect(conn, true);
+                    return;
+                }
+                conn.outPos += n;
+                result.bytesOut += n;
+            }
+            if (conn.outPos == conn.out.size())
+            {
+                conn.out.clear();
+                conn.outPos = 0;
+            }
+            /* 写完后只关心可读 */
+            epoll_event ev = {0};
+            ev.events = EPOLLIN | (conn.out.empty() ? 0 : EPOLLOUT);
+            ev.data.u32 = static_cast<uint32_t>(&conn - &conns[0]);
+            epoll_ctl(epfd, EPOLL_CTL_MOD, conn.fd, &ev);
+        }
+
+        void OnReadable(Conn &conn)
+        {
+            char buf[64 * 1024];
+            while (conn.fd >= 0)
+            {
+                ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+                if (n < 0 && errno == EAGAIN)
+                {
+                    return;
+                }
+                if (n <= 0)
+                {
+                    /* 服务端声明过关闭, 或没有在途请求时断开, 都是正常的长连接结束 */
+                    Reconnect(conn, !conn.closing && !conn.inflight.empty());
+                    return;
+                }
+                result.bytesIn += n;
+                size_t pos = 0;
+                while (pos < static_cast<size_t>(n))
+                {
+                    bool done = false, error = false;
+                    pos += conn.parser.Feed(buf + pos, n - pos, &done, &error);
+                    if (error || (done && conn.inflight.empty()))
+                    {
+                        Reconnect(conn, true);
+                        return;
+                    }
+                    if (done)
+                    {
+                        OnResponse(conn);
+                        if (conn.closing && conn.inflight.empty())
+                        {
+                            Reconnect(conn, false);
+                            return;
+                        }
+                    }
+                }
+            }
+        }
+
+        void OnResponse(Conn &conn)
+        {
+            uint64_t now = Metrics::Now();
+            Pending p = conn.inflight.front();
+            conn.inflight.pop_front();
+            int code = conn.parser.code;
+            if (conn.parser.close || !opt.keepAlive)
+            {
+                /* 关闭前发出的流水线请求不会有响应, 断开后重发 */
+                conn.closing = true;
+            }
+            conn.parser.Reset();
+            if (p.intended < measureStart)
+            {
+                return;
+            }
+            result.requests++;
+            result.latency.Record(now - p.intended);
+            result.latencyUncorrected.Record(now - p.sent);
+            result.status[code >= 100 && code < 600 ? code / 100 : 0]++;
+        }
+
+        const Options &opt;
+        const vector<RequestTemplate> &tpls;
+        sockaddr_in addr;
+        vector<Conn> conns;
+        deque<Pending> backlog;
+        double rate;
+        uint32_t rng;
+        int totalWeight;
+        int epfd;
+        uint64_t measureStart;
+    };
+
+    void Usage(const char *prog)
+    {
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -H, --host HOST          server address (127.0.0.1)\n"
+                "  -p, --port PORT          server port (1316)\n"
+                "  -t, --threads N          worker threads (2)\n"
+                "  -c, --connections N      total connections (50)\n"
+                "  -d, --duration SEC       measured duration (10)\n"
+                "  -w, --warmup SEC         warmup before measuring (2)\n"
+                "  -r, --rate RPS           open loop at RPS requests/s in total; 0 = closed loop (0)\n"
+                "  -P, --pipeline N         requests in flight per connection (1)\n"
+                "  -n, --no-keepalive       one request per connection\n"
+                "  -m, --mix SPEC           \"GET /=5,GET /images/profile-image.jpg=1,POST /login=1\"\n"
+                "  -R, --resources DIR      add a GET for every file under DIR, weight 1\n"
+                "  -l, --login USER:PWD     form body for POST /login and /register (bench:bench)\n"
+                "  -j, --json FILE          write the result as JSON (\"-\" for stdout)\n"
+                "  -L, --label NAME         label stored in the JSON\n"
+                "  -s, --seed N             seed of the request mix (1)\n",
+                prog);
+    }
+
+    bool ParseOptions(int argc, char **argv, Options &opt)
+    {
+        static const option LONG_OPTS[] = {
+            {"host", required_argument, nullptr, 'H'},
+            {"port", required_argument, nullptr, 'p'},
+            {"threads", required_argument, nullptr, 't'},
+            {"connections", required_argument, nullptr, 'c'},
+            {"duration", required_argument, nullptr, 'd'},
+            {"warmup", required_argument, nullptr, 'w'},
+            {"rate", required_argument, nullptr, 'r'},
+            {"pipeline", required_argument, nullptr, 'P'},
+            {"no-keepalive", no_argument, nullptr, 'n'},
+            {"mix", required_argument, nullptr, 'm'},
+            {"resources", required_argument, nullptr, 'R'},
+            {"login", required_argument, nullptr, 'l'},
+            {"json", required_argument, nullptr, 'j'},
+            {"label", required_argument, nullptr, 'L'},
+            {"seed", required_argument, nullptr, 's'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+        };
+        int c;
+        while ((c = getopt_long(argc, argv, "H:p:t:c:d:w:r:P:nm:R:l:j:L:s:h", LONG_OPTS, nullptr)) != -1)
+        {
+            switch (c)
+            {
+            case 'H': opt.host = optarg; break;
+            case 'p': opt.port = atoi(optarg); break;
+            case 't': opt.threads = atoi(optarg); break;
+            case 'c': opt.connections = atoi(optarg); break;
+            case 'd': opt.duration = atof(optarg); break;
+            case 'w': opt.warmup = atof(optarg); break;
+            case 'r': opt.rate = atof(optarg); break;
+            case 'P': opt.pipeline = atoi(optarg); break;
+            case 'n': opt.keepAlive = false; break;
+            case 'm': opt.mix = optarg; break;
+            case 'R': opt.resources = optarg; break;
+            case 'l': opt.login = optarg; break;
+            case 'j': opt.json = optarg; break;
+            case 'L': opt.label = optarg; break;
+            case 's': opt.seed = static_cast<unsigned>(strtoul(optarg, nullptr, 10)); break;
+            default: return false;
+            }
+        }
+        if (opt.threads < 1 || opt.connections < opt.threads || opt.pipeline < 1 || opt.duration <= 0 ||
+            opt.warmup < 0 || opt.rate < 0 || opt.login.find(':') == string::npos)
+        {
+            fprintf(stderr, "invalid options\n");
+            return false;
+        }
+        return true;
+    }
+
+    string BuildRequest(const Options &opt, const string &method, const string &path)
+    {
+        string req = method + " " + path + " HTTP/1.1\r\nHost: " + opt.host + ":" + to_string(opt.port) +
+                     "\r\nUser-Agent: tws-loadgen\r\nAccept: */*\r\n" +
+                     (opt.keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+        if (method == "POST")
+        {
+            size_t colon = opt.login.find(':');
+            string body = "username=" + opt.login.substr(0, colon) + "&password=" + opt.login.substr(colon + 1);
+            req += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " + to_string(body.size()) +
+                   "\r\n\r\n" + body;
+            return req;
+        }
+        return req + "\r\n";
+    }
+
+    void ListFiles(const string &root, const string &rel, vector<string> &files)
+    {
+        DIR *dir = opendir((root + rel).c_str());
+        if (!dir)
+        {
+            return;
+        }
+        while (dirent *ent = readdir(dir))
+        {
+            string name = ent->d_name;
+            if (name == "." || name == "..")
+            {
+                continue;
+            }
+            struct stat st;
+            string path = rel + "/" + name;
+            if (stat((root + path).c_str(), &st) != 0)
+            {
+                continue;
+            }
+            if (S_ISDIR(st.st_mode))
+            {
+                ListFiles(root, path, files);
+            }
+            else if (S_ISREG(st.st_mode))
+            {
+                files.push_back(path);
+            }
+        }
+        closedir(dir);
+    }
+
+    /* "METHOD PATH=WEIGHT,..." 与 --resources 目录下的文件 */
+    bool BuildMix(const Options &opt, vector<RequestTemplate> &tpls)
+    {
+        size_t pos = 0;
+        while (pos < opt.mix.size())
+        {
+            size_t comma = opt.mix.find(',', pos);
+            string item = opt.mix.substr(pos, comma == string::npos ? string::npos : comma - pos);
+            pos = comma == string::npos ? opt.mix.size() : comma + 1;
+            if (item.empty())
+            {
+                continue;
+            }
+            int weight = 1;
+            size_t eq = item.rfind('=');
+            if (eq != string::npos)
+            {
+                weight = atoi(item.c_str() + eq + 1);
+                item.resize(eq);
+            }
+            size_t space = item.find(' ');
+            if (space == string::npos || weight <= 0)
+            {
+                fprintf(stderr, "bad mix item: %s\n", item.c_str());
+                return false;
+            }
+            string method = item.substr(0, space), path = item.substr(space + 1);
+            tpls.push_back(RequestTemplate{item, BuildRequest(opt, method, path), weight});
+        }
+        if (!opt.resources.empty())
+        {
+            vector<string> files;
+            ListFiles(opt.resources, "", files);
+            sort(files.begin(), files.end());
+            for (const string &file : files)
+            {
+                tpls.push_back(RequestTemplate{"GET " + file, BuildRequest(opt, "GET", file), 1});
+            }
+        }
+        return !tpls.empty();
+    }
+
+    void AppendLatency(string &out, const char *name, const Histogram &hist)
+    {
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "  \"%s\": {\"count\": %llu, \"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+                 "\"p999\": %.1f, \"p9999\": %.1f, \"max\": %.1f},\n",
+                 name, static_cast<unsigned long long>(hist.Count()),
+                 hist.Count() ? hist.Sum() / 1e3 / hist.Count() : 0.0, hist.Percentile(0.5) / 1e3,
+                 hist.Percentile(0.9) / 1e3, hist.Percentile(0.99) / 1e3, hist.Percentile(0.999) / 1e3,
+                 hist.Percentile(0.9999) / 1e3, hist.Percentile(1.0) / 1e3);
+        out += buf;
+    }
+
+    string EscapeJson(const string &str)
+    {
+        string out;
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+            }
+            if (static_cast<unsigned char>(c) >= 0x20)
+            {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    string ToJson(const Options &opt, const vector<RequestTemplate> &tpls, const Result &res, double seconds)
+    {
+        char buf[512];
+        string out = "{\n";
+        out += "  \"label\": \"" + EscapeJson(opt.label) + "\",\n";
+        snprintf(buf, sizeof(buf),
+                 "  \"config\": {\"host\": \"%s\", \"port\": %d, \"threads\": %d, \"connections\": %d, "
+                 "\"duration\": %g, \"warmup\": %g, \"rate\": %g, \"pipeline\": %d, \"keepalive\": %s, \"seed\": %u},\n",
+                 EscapeJson(opt.host).c_str(), opt.port, opt.threads, opt.connections, opt.duration, opt.warmup,
+                 opt.rate, opt.pipeline, opt.keepAlive ? "true" : "false", opt.seed);
+        out += buf;
+        out += "  \"mix\": [";
+        for (size_t i = 0; i < tpls.size(); i++)
+        {
+            out += (i ? ", " : "") + string("{\"request\": \"") + EscapeJson(tpls[i].name) +
+                   "\", \"weight\": " + to_string(tpls[i].weight) + "}";
+        }
+        out += "],\n";
+        snprintf(buf, sizeof(buf),
+                 "  \"seconds\": %.3f,\n  \"requests\": %llu,\n  \"rps\": %.1f,\n"
+                 "  \"bytes_in\": %llu,\n  \"bytes_out\": %llu,\n  \"errors\": %llu,\n  \"reconnects\": %llu,\n"
+                 "  \"backlog_at_end\": %llu,\n",
+                 seconds, static_cast<unsigned long long>(res.requests), res.requests / seconds,
+                 static_cast<unsigned long long>(res.bytesIn), static_cast<unsigned long long>(res.bytesOut),
+                 static_cast<unsigned long long>(res.errors), static_cast<unsigned long long>(res.reconnects),
+                 static_cast<unsigned long long>(res.backlog));
+        out += buf;
+        snprintf(buf, sizeof(buf),
+                 "  \"status\": {\"1xx\": %llu, \"2xx\": %llu, \"3xx\": %llu, \"4xx\": %llu, \"5xx\": %llu, \"other\": %llu},\n",
+                 static_cast<unsigned long long>(res.status[1]), static_cast<unsigned long long>(res.status[2]),
+                 static_cast<unsigned long long>(res.status[3]), static_cast<unsigned long long>(res.status[4]),
+                 static_cast<unsigned long long>(res.status[5]), static_cast<unsigned long long>(res.status[0]));
+        out += buf;
+        /* 延迟单位微秒; 开环时 latency_us 含排队时间, uncorrected 为从实际写出算起 */
+        AppendLatency(out, "latency_us", res.latency);
+        AppendLatency(out, "latency_uncorrected_us", res.latencyUncorrected);
+        /* 非空桶: [桶上界(ns), 个数], 可在不同次运行之间合并或重新计算分位数 */
+        out += "  \"histogram_ns\": [";
+        bool first = true;
+        for (size_t i = 0; i < Histogram::BUCKETS; i++)
+        {
+            if (res.latency.Bucket(i) == 0)
+            {
+                continue;
+            }
+            snprintf(buf, sizeof(buf), "%s[%llu, %llu]", first ? "" : ", ",
+                     static_cast<unsigned long long>(Histogram::BucketUpper(i)),
+                     static_cast<unsigned long long>(res.latency.Bucket(i)));
+            out += buf;
+            first = false;
+        }
+        out += "]\n}\n";
+        return out;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+    vector<RequestTemplate> tpls;
+    if (!BuildMix(opt, tpls))
+    {
+        return 1;
+    }
+    sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if (inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1)
+    {
+        hostent *host = gethostbyname(opt.host.c_str());
+        if (!host || host->h_addrtype != AF_INET)
+        {
+            fprintf(stderr, "unknown host %s\n", opt.host.c_str());
+            return 1;
+        }
+        memcpy(&addr.sin_addr, host->h_addr_list[0], sizeof(addr.sin_addr));
+    }
+
+    uint64_t start = Metrics::Now();
+    uint64_t measureStart = start + static_cast<uint64_t>(opt.warmup * 1e9);
+    uint64_t end = measureStart + static_cast<uint64_t>(opt.duration * 1e9);
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    for (int i = 0; i < opt.threads; i++)
+    {
+        /* 连接与速率平均分给各线程 */
+        int conns = opt.connections / opt.threads + (i < opt.connections % opt.threads ? 1 : 0);
+        workers.emplace_back(new Worker(opt, tpls, addr, conns, opt.rate / opt.threads, opt.seed * 7919 + i));
+    }
+    for (auto &worker : workers)
+    {
+        Worker *w = worker.get();
+        threads.emplace_back([w, start, measureStart, end] { w->Run(start, measureStart, end); });
+    }
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+
+    Result total;
+    for (auto &worker : workers)
+    {
+        const Result &r = worker->result;
+        total.latency.Merge(r.latency);
+        total.latencyUncorrected.Merge(r.latencyUncorrected);
+        total.requests += r.requests;
+        for (int i = 0; i < 6; i++)
+        {
+            total.status[i] += r.status[i];
+        }
+        total.bytesIn += r.bytesIn;
+        total.bytesOut += r.bytesOut;
+        total.errors += r.errors;
+        total.reconnects += r.reconnects;
+        total.backlog += r.backlog;
+    }
+
+    string json = ToJson(opt, tpls, total, opt.duration);
+    if (opt.json == "-")
+    {
+        fputs(json.c_str(), stdout);
+    }
+    else
+    {
+        if (!opt.json.empty())
+        {
+            FILE *fp = fopen(opt.json.c_str(), "w");
+            if (!fp)
+            {
+                fprintf(stderr, "open %s: %s\n", opt.json.c_str(), strerror(errno));
+                return 1;
+            }
+            fputs(json.c_str(), fp);
+            fclose(fp);
+        }
+        printf("%s%s%.0f req/s, %llu requests, %llu errors, %llu reconnects, 2xx %llu, non-2xx %llu\n",
+               opt.label.c_str(), opt.label.empty() ? "" : ": ", total.requests / opt.duration,
+               static_cast<unsigned long long>(total.requests), static_cast<unsigned long long>(total.errors),
+               static_cast<unsigned long long>(total.reconnects), static_cast<unsigned long long>(total.status[2]),
+               static_cast<unsigned long long>(total.requests - total.status[2]));
+        printf("latency(us) p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f%s\n",
+               total.latency.Percentile(0.5) / 1e3, total.latency.Percentile(0.9) / 1e3,
+               total.latency.Percentile(0.99) / 1e3, total.latency.Percentile(0.999) / 1e3,
+               total.latency.Percentile(1.0) / 1e3, opt.rate > 0 ? "  (from intended send time)" : "");
+    }
+    return total.requests > 0 ? 0 : 2;
+}
@@ -0,0 +1,420 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include "../code/buffer/buffer.h"
+#include "../code/buffer/bufferchain.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/httpresponse.h"
+#include "../code/http/httptables.h"
+#include "../code/timer/heaptimer.h"
+#include "../code/log/blockqueue.h"
+#include "../code/pool/threadpool.h"
+
+/*
+ * 核心组件的微基准, 输入取自真实流量的形状: 浏览器请求头, 表单请求体, 大量连接的定时器.
+ * 保存结果: ./bin/microbench --benchmark_out=micro.json --benchmark_out_format=json
+ */
+namespace
+{
+    const char BROWSER_GET[] =
+        "GET /images/profile-image.jpg HTTP/1.1\r\n"
+        "Host: 127.0.0.1:1316\r\n"
+        "Connection: keep-alive\r\n"
+        "sec-ch-ua: \"Chromium\";v=\"120\", \"Not_A Brand\";v=\"8\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "sec-ch-ua-platform: \"Linux\"\r\n"
+        "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+        "Sec-Fetch-Site: same-origin\r\n"
+        "Sec-Fetch-Mode: no-cors\r\n"
+        "Sec-Fetch-Dest: image\r\n"
+        "Referer: http://127.0.0.1:1316/index.html\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Cookie: _ga=GA1.1.1234567890.1700000000; session=9f8e7d6c5b4a39281706f5e4d3c2b1a0\r\n"
+        "\r\n";
+
+    /* fields 个表单字段, 值含需要解码的字符 */
+    std::string UrlencodedPost(int fields)
+    {
+        std::string body = "username=%E5%BC%A0+san&password=p%40ss%21";
+        for (int i = 0; i < fields; i++)
+        {
+            body += "&field" + std::to_string(i) + "=value+" + std::to_string(i) + "%2C%20more";
+        }
+        return "POST /login HTTP/1.1\r\n"
+               "Host: 127.0.0.1:1316\r\n"
+               "Connection: keep-alive\r\n"
+               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+               "Cache-Control: max-age=0\r\n"
+               "Origin: http://127.0.0.1:1316\r\n"
+               "Content-Type: application/x-www-form-urlencoded\r\n"
+               "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+               "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+               "Referer: http://127.0.0.1:1316/login.html\r\n"
+               "Accept-Encoding: gzip, deflate, br\r\n"
+               "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+               "\r\n" + body;
+    }
+
+    uint32_t XorShift(uint32_t &state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    /* 静态文件目录, 进程内只创建一次 */
+    const char *ResDir()
+    {
+        static const char *dir = [] {
+            const char *d = "./microbench_res";
+            mkdir(d, 0755);
+            std::string page(3 * 1024, 'x');
+            FILE *fp = fopen("./microbench_res/index.html", "w");
+            fwrite(page.data(), 1, page.size(), fp);
+            fclose(fp);
+            std::string image(48 * 1024, 'y');
+            fp = fopen("./microbench_res/image.jpg", "w");
+            fwrite(image.data(), 1, image.size(), fp);
+            fclose(fp);
+            FileCache::Instance()->Init(64 << 20, 1000);
+            return d;
+        }();
+        return dir;
+    }
+}
+
+/* ---------- Buffer ---------- */
+
+static void BM_BufferAppendRetrieve(benchmark::State &state)
+{
+    Buffer buff;
+    std::string data(state.range(0), 'a');
+    for (auto _ : state)
+    {
+        buff.Append(data);
+        benchmark::DoNotOptimize(buff.Peek());
+        buff.RetrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_BufferAppendRetrieve)->Arg(64)->Arg(1024)->Arg(16 * 1024)->Arg(256 * 1024);
+
+/* 小片段追加后一次取走, 模拟请求分多次到达 */
+static void BM_BufferFragmentedAppend(benchmark::State &state)
+{
+    Buffer buff;
+    const std::string req = BROWSER_GET;
+    const size_t piece = state.range(0);
+    for (auto _ : state)
+    {
+        for (size_t pos = 0; pos < req.size(); pos += piece)
+        {
+            buff.Append(req.data() + pos, std::min(piece, req.size() - pos));
+        }
+        buff.RetrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * req.size());
+}
+BENCHMARK(BM_BufferFragmentedAppend)->Arg(16)->Arg(64)->Arg(512);
+
+static void BM_BufferReadFd(benchmark::State &state)
+{
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    int size = 1 << 20;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    std::string data(state.range(0), 'r');
+    Buffer buff;
+    int err = 0;
+    for (auto _ : state)
+    {
+        ssize_t n = write(sv[0], data.data(), data.size());
+        benchmark::DoNotOptimize(n);
+        size_t got = 0;
+        while (got < data.size())
+        {
+            got += buff.ReadFd(sv[1], &err, 256 * 1024);
+        }
+        buff.RetrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+    close(sv[0]);
+    close(sv[1]);
+}
+BENCHMARK(BM_BufferReadFd)->Arg(512)->Arg(16 * 1024)->Arg(128 * 1024);
+
+/* ---------- HttpRequest::parse ---------- */
+
+static void BM_ParseBrowserGet(benchmark::State &state)
+{
+    HttpRequest request;
+    Buffer buff;
+    const size_t len = sizeof(BROWSER_GET) - 1;
+    for (auto _ : state)
+    {
+        request.Init();
+        buff.Append(BROWSER_GET, len);
+        benchmark::DoNotOptimize(request.parse(buff));
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_ParseBrowserGet);
+
+static void BM_ParseUrlencodedPost(benchmark::State &state)
+{
+    HttpRequest request;
+    Buffer buff;
+    const std::string req = UrlencodedPost(state.range(0));
+    for (auto _ : state)
+    {
+        request.Init();
+        buff.Append(req);
+        benchmark::DoNotOptimize(request.parse(buff));
+        benchmark::DoNotOptimize(request.GetPost("password"));
+    }
+    state.SetBytesProcessed(state.iterations() * req.size());
+}
+BENCHMARK(BM_ParseUrlencodedPost)->Arg(0)->Arg(16)->Arg(128);
+
+/* 请求头按 range(0) 字节的片段到达, 每到一片解析一次 */
+static void BM_ParseFragmented(benchmark::State &state)
+{
+    HttpRequest request;
+    Buffer buff;
+    const std::string req = BROWSER_GET;
+    const size_t piece = state.range(0);
+    for (auto _ : state)
+    {
+        request.Init();
+        for (size_t pos = 0; pos < req.size(); pos += piece)
+        {
+            buff.Append(req.data() + pos, std::min(piece, req.size() - pos));
+            benchmark::DoNotOptimize(request.parse(buff));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * req.size());
+}
+BENCHMARK(BM_ParseFragmented)->Arg(32)->Arg(128)->Arg(512);
+
+/* 一次读入 16 个流水线请求 */
+static void BM_ParsePipelined(benchmark::State &state)
+{
+    HttpRequest request;
+    Buffer buff;
+    std::string batch;
+    for (int i = 0; i < 16; i++)
+    {
+        batch += BROWSER_GET;
+    }
+    for (auto _ : state)
+    {
+        buff.Append(batch);
+        while (buff.ReadableBytes() > 0)
+        {
+            request.Init();
+            benchmark::DoNotOptimize(request.parse(buff));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 16);
+}
+BENCHMARK(BM_ParsePipelined);
+
+/* ---------- HttpResponse::MakeResponse ---------- */
+
+static void BM_MakeResponseStatic(benchmark::State &state)
+{
+    const char *dir = ResDir();
+    std::string path = state.range(0) ? "/image.jpg" : "/index.html";
+    HttpResponse response;
+    BufferChain chain;
+    for (auto _ : state)
+    {
+        response.Init(dir, path, true, 200);
+        response.MakeResponse(chain);
+        chain.RetrieveAll();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeResponseStatic)->Arg(0)->Arg(1);
+
+static void BM_MakeResponseNotFound(benchmark::State &state)
+{
+    const char *dir = ResDir();
+    std::string path = "/missing.html";
+    HttpResponse response;
+    BufferChain chain;
+    for (auto _ : state)
+    {
+        response.Init(dir, path, true, 200);
+        response.MakeResponse(chain);
+        chain.RetrieveAll();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeResponseNotFound);
+
+static void BM_MakeResponseContent(benchmark::State &state)
+{
+    const char *dir = ResDir();
+    std::string path = "/api";
+    const std::string body(state.range(0), 'j');
+    HttpResponse response;
+    BufferChain chain;
+    for (auto _ : state)
+    {
+        response.Init(dir, path, true, 200);
+        response.SetContent(FindMimeType(".json", 5), body);
+        response.MakeResponse(chain);
+        chain.RetrieveAll();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeResponseContent)->Arg(128)->Arg(4096);
+
+/* ---------- HeapTimer ---------- */
+
+static void BM_TimerAdd(benchmark::State &state)
+{
+    const int n = state.range(0);
+    for (auto _ : state)
+    {
+        HeapTimer timer;
+        for (int i = 0; i < n; i++)
+        {
+            timer.add(i, 60000 + (i * 7919) % 1000, [] {});
+        }
+        benchmark::DoNotOptimize(timer.GetNextTick());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_TimerAdd)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+/* 每个活跃连接的读写事件都会延长超时: 随机连接反复 adjust */
+static void BM_TimerAdjustStorm(benchmark::State &state)
+{
+    const int n = state.range(0);
+    HeapTimer timer;
+    for (int i = 0; i < n; i++)
+    {
+        timer.add(i, 60000 + (i * 7919) % 1000, [] {});
+    }
+    uint32_t rng = 2463534242u;
+    for (auto _ : state)
+    {
+        timer.adjust(XorShift(rng) % n, 60000 + rng % 1000);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimerAdjustStorm)->Arg(10000)->Arg(100000)->Arg(1000000);
+
+/* 连接建立与超时/关闭交替: 新增一个, 删除一个 */
+static void BM_TimerChurn(benchmark::State &state)
+{
+    const int n = state.range(0);
+    HeapTimer timer;
+    for (int i = 0; i < n; i++)
+    {
+        timer.add(i, 60000 + (i * 7919) % 1000, [] {});
+    }
+    uint32_t rng = 88172645u;
+    for (auto _ : state)
+    {
+        int id = XorShift(rng) % n;
+        timer.doWork(id);
+        timer.add(id, 60000 + rng % 1000, [] {});
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimerChurn)->Arg(10000)->Arg(100000)->Arg(1000000);
+
+/* ---------- BlockDeque ---------- */
+
+static void BM_BlockDequePushPop(benchmark::State &state)
+{
+    BlockDeque<std::string> deque(1024);
+    const std::string line(120, 'l');
+    std::string item;
+    for (auto _ : state)
+    {
+        deque.push_back(line);
+        deque.pop(item);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BlockDequePushPop);
+
+/* 多个线程写日志, 一个线程消费, 与异步日志的用法相同 */
+static void BM_BlockDequeProducers(benchmark::State &state)
+{
+    const int producers = state.range(0);
+    const int perProducer = 20000;
+    const std::string line(120, 'l');
+    for (auto _ : state)
+    {
+        BlockDeque<std::string> deque(1024);
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&deque, &line] {
+                for (int i = 0; i < perProducer; i++)
+                {
+                    deque.push_back(line);
+                }
+            });
+        }
+        std::string item;
+        for (int i = 0; i < producers * perProducer; i++)
+        {
+            deque.pop(item);
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * producers * perProducer);
+}
+BENCHMARK(BM_BlockDequeProducers)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/* ---------- ThreadPool ---------- */
+
+/* 每轮提交 1000 个小任务并等它们全部完成 */
+static void BM_ThreadPoolAddTask(benchmark::State &state)
+{
+    ThreadPool pool(state.range(0));
+    const int tasks = 1000;
+    std::atomic<int> done(0);
+    for (auto _ : state)
+    {
+        done.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < tasks; i++)
+        {
+            pool.AddTask([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while (done.load(std::memory_order_relaxed) < tasks)
+        {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * tasks);
+}
+BENCHMARK(BM_ThreadPoolAddTask)->Arg(1)->Arg(4)->Arg(8)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,31 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include <signal.h>
+#include <unistd.h>
+
+/*
+ * 只链接进 PGO 插桩构建的服务器: 服务器被 SIGTERM/SIGINT 结束时不会正常退出,
+ * 在信号处理中写出 profile. 不改动 main.cpp, 两次构建的控制流保持一致
+ */
+extern "C" void __gcov_dump(void);
+
+namespace
+{
+    void DumpProfile(int)
+    {
+        __gcov_dump();
+        _exit(0);
+    }
+
+    struct InstallHandler
+    {
+        InstallHandler()
+        {
+            signal(SIGTERM, DumpProfile);
+            signal(SIGINT, DumpProfile);
+        }
+    } installHandler;
+}
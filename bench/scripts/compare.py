@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# 对比两个结果目录中同名场景的吞吐与延迟分位数, 以及微基准(micro.json)各项的中位数耗时
+# 用法: compare.py 结果目录A 结果目录B
+import json
+import os
+import sys
+
+
+def load(path):
+    results = {}
+    for name in sorted(os.listdir(path)):
+        if name.endswith(".json"):
+            with open(os.path.join(path, name)) as f:
+                results[name[:-5]] = json.load(f)
+    return results
+
+
+def delta(a, b, lower_is_better):
+    if not a:
+        return ""
+    change = (b - a) / a * 100
+    better = change < 0 if lower_is_better else change > 0
+    return "%+.1f%%%s" % (change, "" if abs(change) < 3 else (" +" if better else " -"))
+
+
+def micro_times(result):
+    # 有重复时取中位数, 否则取唯一一次
+    times = {}
+    for bm in result["benchmarks"]:
+        if bm.get("run_type") == "aggregate" and bm.get("aggregate_name") != "median":
+            continue
+        times[bm.get("run_name", bm["name"])] = bm["real_time"], bm["time_unit"]
+    return times
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: compare.py RESULTS_A RESULTS_B")
+    a, b = load(sys.argv[1]), load(sys.argv[2])
+    rows = [("scenario", "metric", "A", "B", "change")]
+    for name in sorted(set(a) & set(b)):
+        if "benchmarks" in a[name]:
+            ta, tb = micro_times(a[name]), micro_times(b[name])
+            for bm in [n for n in ta if n in tb]:
+                (va, unit), (vb, _) = ta[bm], tb[bm]
+                rows.append((bm, "time " + unit, "%.1f" % va, "%.1f" % vb, delta(va, vb, True)))
+            continue
+        ra, rb = a[name], b[name]
+        rows.append((name, "rps", "%.0f" % ra["rps"], "%.0f" % rb["rps"], delta(ra["rps"], rb["rps"], False)))
+        for q in ("p50", "p99", "p999"):
+            va, vb = ra["latency_us"][q], rb["latency_us"][q]
+            rows.append(("", q + " us", "%.1f" % va, "%.1f" % vb, delta(va, vb, True)))
+        if ra["errors"] or rb["errors"]:
+            rows.append(("", "errors", str(ra["errors"]), str(rb["errors"]), ""))
+    widths = [max(len(r[i]) for r in rows) for i in range(5)]
+    for r in rows:
+        print("  ".join(c.ljust(w) for c, w in zip(r, widths)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,13 @@
+#!/bin/bash
+# 用同样的场景压测两个构建并对比
+# 用法: bench/scripts/compare.sh 旧服务器 新服务器 [场景名...]
+set -e
+cd "$(dirname "$0")/../.."
+[ $# -ge 2 ] || { echo "usage: $0 SERVER_A SERVER_B [scenario...]" >&2; exit 1; }
+A=$1
+B=$2
+shift 2
+STAMP=$(date +%Y%m%d-%H%M%S)
+SERVER=$A bench/scripts/scenarios.sh bench/results/$STAMP/a "$@"
+SERVER=$B bench/scripts/scenarios.sh bench/results/$STAMP/b "$@"
+python3 bench/scripts/compare.py bench/results/$STAMP/a bench/results/$STAMP/b
@@ -0,0 +1,23 @@
+#!/bin/bash
+# 运行核心组件微基准, 结果写入 micro.json, 可与 compare.py 一起使用
+# 用法: bench/scripts/microbench.sh [结果目录] [--benchmark_filter=...]
+#   REPS   重复次数, 默认 5; 输出均值/中位数/标准差
+#   MICRO  微基准可执行文件, 默认 ./bin/microbench
+set -e
+cd "$(dirname "$0")/../.."
+
+REPS=${REPS:-5}
+MICRO=${MICRO:-./bin/microbench}
+OUT=${1:-bench/results/$(git rev-parse --short HEAD 2>/dev/null || date +%s)}
+shift || true
+
+[ -x "$MICRO" ] || make -C bench micro
+mkdir -p "$OUT"
+# 静态文件基准在当前目录创建临时资源目录
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+MICRO=$(realpath "$MICRO")
+OUT=$(realpath "$OUT")
+(cd "$WORK" && "$MICRO" --benchmark_repetitions="$REPS" --benchmark_report_aggregates_only=true \
+    --benchmark_out="$OUT/micro.json" --benchmark_out_format=json "$@")
+echo "results in $OUT/micro.json"
@@ -0,0 +1,28 @@
+#!/bin/bash
+# PGO: 构建插桩版本, 用微基准与压测场景训练, 再用得到的 profile 构建最终版本
+# 用法: bench/scripts/pgo.sh [构建目录]
+#   CMAKE_ARGS  额外的 cmake 参数, 如 "-DWEBSERVER_LTO=ON -DWEBSERVER_NATIVE=ON"
+#   DURATION    每个训练场景的时长(秒), 默认 5
+set -e
+cd "$(dirname "$0")/../.."
+
+BUILD=${1:-build-pgo}
+PROFILE=$(realpath -m "$BUILD/profile")
+DURATION=${DURATION:-5}
+
+# 两次构建使用同一目录, 目标文件路径一致, profile 才能对应上
+rm -rf "$PROFILE"
+cmake -S . -B "$BUILD" -DCMAKE_BUILD_TYPE=Release -DWEBSERVER_PGO=GEN -DWEBSERVER_PGO_DIR="$PROFILE" $CMAKE_ARGS
+cmake --build "$BUILD" -j"$(nproc)"
+
+# 训练负载: 微基准覆盖解析/响应/定时器, 压测场景覆盖完整的请求路径
+if [ -x "$BUILD/bin/microbench" ]; then
+    REPS=1 MICRO="$BUILD/bin/microbench" bench/scripts/microbench.sh "$BUILD/train" --benchmark_min_time=0.2
+fi
+mkdir -p bin
+SERVER="$BUILD/bin/server" LOADGEN="$BUILD/bin/loadgen" DURATION=$DURATION \
+    bench/scripts/scenarios.sh "$BUILD/train"
+
+cmake -S . -B "$BUILD" -DCMAKE_BUILD_TYPE=Release -DWEBSERVER_PGO=USE -DWEBSERVER_PGO_DIR="$PROFILE" $CMAKE_ARGS
+cmake --build "$BUILD" -j"$(nproc)"
+echo "optimized binaries in $BUILD/bin"
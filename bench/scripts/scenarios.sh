@@ -0,0 +1,55 @@
+#!/bin/bash
+# 启动本地服务器, 依次运行固定的压测场景, 每个场景输出一个 JSON
+# 用法: bench/scripts/scenarios.sh [结果目录] [场景名...]
+#   SERVER    服务器可执行文件, 默认 ./bin/server (需按 readme 配好数据库, 或用 SERVER_ARGS 指定本地用户库)
+#   SERVER_ARGS 服务器的额外参数, 如 "-c conf/server.conf --user_db ./bin/user.db"
+#   PORT      服务器端口, 默认 1316
+#   DURATION  每个场景的测量时长(秒), 默认 10
+#   RATE      开环场景的总速率, 默认 5000
+#   LOADGEN   压测工具, 默认 ./bin/loadgen
+set -e
+cd "$(dirname "$0")/../.."
+
+SERVER=${SERVER:-./bin/server}
+PORT=${PORT:-1316}
+DURATION=${DURATION:-10}
+RATE=${RATE:-5000}
+LOADGEN=${LOADGEN:-./bin/loadgen}
+OUT=${1:-bench/results/$(git rev-parse --short HEAD 2>/dev/null || date +%s)}
+shift || true
+
+# 名称|参数; 请求序列由 --seed 固定, 同一场景在不同构建间可比
+SCENARIOS=(
+    "index_keepalive|-c 50 -m GET\ /=1"
+    "index_close|-c 50 -n -m GET\ /=1"
+    "pipeline16|-c 50 -P 16 -m GET\ /=1"
+    "resources_mix|-c 100 -R resources -m GET\ /=10"
+    "login_mix|-c 50 -m GET\ /=8,POST\ /login=2"
+    "open_loop|-c 100 -r $RATE -m GET\ /=5,GET\ /images/profile-image.jpg=1"
+)
+
+[ -x "$LOADGEN" ] || make -C bench
+[ -x "$SERVER" ] || { echo "server binary $SERVER not found" >&2; exit 1; }
+mkdir -p "$OUT"
+
+"$SERVER" --port "$PORT" $SERVER_ARGS > "$OUT/server.out" 2>&1 &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null; wait $SERVER_PID 2>/dev/null' EXIT
+for i in $(seq 50); do
+    (echo > /dev/tcp/127.0.0.1/$PORT) 2>/dev/null && break
+    sleep 0.1
+done
+
+# 登录场景用的账号, 已存在时注册失败也无妨
+printf 'POST /register HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: 29\r\n\r\nusername=bench&password=bench' \
+    > /dev/tcp/127.0.0.1/$PORT 2>/dev/null || true
+
+for item in "${SCENARIOS[@]}"; do
+    name=${item%%|*}
+    args=${item#*|}
+    if [ $# -gt 0 ] && [[ ! " $* " =~ " $name " ]]; then
+        continue
+    fi
+    eval "$LOADGEN -p $PORT -d $DURATION -w 2 -s 1 -L $name -j $OUT/$name.json $args"
+done
+echo "results in $OUT"
@@ -0,0 +1,22 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef AUTH_BACKEND_H
+#define AUTH_BACKEND_H
+
+#include <string>
+
+/* 用户校验后端: MySQL 连接池 或 本地嵌入式用户库 */
+class AuthBackend
+{
+public:
+    virtual ~AuthBackend() = default;
+
+    virtual bool Login(const std::string &name, const std::string &pwd) = 0;
+    virtual bool Register(const std::string &name, const std::string &pwd) = 0;
+    virtual const char *Name() const = 0;
+};
+
+#endif // AUTH_BACKEND_H
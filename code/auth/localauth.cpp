@@ -0,0 +1,186 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "localauth.h"
+#include <string.h>
+#include <assert.h>
+
+using namespace std;
+
+const char LocalAuth::MAGIC[8] = {'W', 'S', 'U', 'S', 'E', 'R', '1', '\0'};
+
+LocalAuth::LocalAuth(const char *path) : mFd(-1), mData(nullptr), mCapacity(0)
+{
+    assert(path);
+    if (!Open(path))
+    {
+        LOG_ERROR("LocalAuth open %s error!", path);
+        if (mData)
+        {
+            munmap(mData, mCapacity);
+            mData = nullptr;
+        }
+        return;
+    }
+    LOG_INFO("LocalAuth %s users:%d", path, (int)mIndex.size());
+}
+
+LocalAuth::~LocalAuth()
+{
+    if (mData)
+    {
+        msync(mData, GetHeader()->used, MS_SYNC);
+        munmap(mData, mCapacity);
+    }
+    if (mFd >= 0)
+    {
+        close(mFd);
+    }
+}
+
+bool LocalAuth::Open(const char *path)
+{
+    mFd = open(path, O_RDWR | O_CREAT, 0600);
+    if (mFd < 0)
+    {
+        return false;
+    }
+    struct stat st = {0};
+    if (fstat(mFd, &st) < 0)
+    {
+        return false;
+    }
+    bool isNew = (st.st_size == 0);
+    mCapacity = isNew ? INIT_SIZE : st.st_size;
+    if (isNew && ftruncate(mFd, mCapacity) < 0)
+    {
+        return false;
+    }
+    void *ret = mmap(nullptr, mCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (ret == MAP_FAILED)
+    {
+        return false;
+    }
+    mData = static_cast<char *>(ret);
+    if (isNew)
+    {
+        memcpy(GetHeader()->magic, MAGIC, sizeof(MAGIC));
+        GetHeader()->used = sizeof(Header);
+    }
+    return Load();
+}
+
+bool LocalAuth::Load()
+{
+    if (mCapacity < sizeof(Header) || memcmp(GetHeader()->magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        return false;
+    }
+    size_t used = GetHeader()->used;
+    if (used > mCapacity)
+    {
+        return false;
+    }
+    size_t pos = sizeof(Header);
+    while (pos + 2 <= used)
+    {
+        uint8_t nameLen = mData[pos];
+        uint8_t pwdLen = mData[pos + 1];
+        if (pos + 2 + nameLen + pwdLen > used)
+        {
+            break;
+        }
+        mIndex[string(mData + pos + 2, nameLen)] = pos;
+        pos += 2 + nameLen + pwdLen;
+    }
+    /* 截掉写了一半的记录 */
+    GetHeader()->used = pos;
+    return true;
+}
+
+bool LocalAuth::Reserve(size_t len)
+{
+    size_t need = GetHeader()->used + len;
+    if (need <= mCapacity)
+    {
+        return true;
+    }
+    size_t newCapacity = mCapacity * 2;
+    while (newCapacity < need)
+    {
+        newCapacity *= 2;
+    }
+    if (ftruncate(mFd, newCapacity) < 0)
+    {
+        return false;
+    }
+    void *ret = mremap(mData, mCapacity, newCapacity, MREMAP_MAYMOVE);
+    if (ret == MAP_FAILED)
+    {
+        return false;
+    }
+    mData = static_cast<char *>(ret);
+    mCapacity = newCapacity;
+    return true;
+}
+
+bool LocalAuth::Login(const string &name, const string &pwd)
+{
+    shared_lock<shared_timed_mutex> locker(mtx);
+    if (!mData)
+    {
+        return false;
+    }
+    auto it = mIndex.find(name);
+    if (it == mIndex.end())
+    {
+        return false;
+    }
+    const char *rec = mData + it->second;
+    uint8_t nameLen = rec[0];
+    uint8_t pwdLen = rec[1];
+    if (pwdLen != pwd.size() || memcmp(rec + 2 + nameLen, pwd.data(), pwdLen) != 0)
+    {
+        LOG_DEBUG("pwd error!");
+        return false;
+    }
+    return true;
+}
+
+bool LocalAuth::Register(const string &name, const string &pwd)
+{
+    if (name.size() > MAX_FIELD || pwd.size() > MAX_FIELD)
+    {
+        return false;
+    }
+    lock_guard<shared_timed_mutex> locker(mtx);
+    if (!mData || mIndex.count(name))
+    {
+        LOG_DEBUG("user used!");
+        return false;
+    }
+    size_t len = 2 + name.size() + pwd.size();
+    if (!Reserve(len))
+    {
+        LOG_ERROR("LocalAuth grow error!");
+        return false;
+    }
+    size_t pos = GetHeader()->used;
+    char *rec = mData + pos;
+    rec[0] = static_cast<char>(name.size());
+    rec[1] = static_cast<char>(pwd.size());
+    memcpy(rec + 2, name.data(), name.size());
+    memcpy(rec + 2 + name.size(), pwd.data(), pwd.size());
+    /* 记录写完后再提交长度 */
+    GetHeader()->used = pos + len;
+    mIndex.emplace(name, pos);
+    return true;
+}
+
+size_t LocalAuth::UserCount()
+{
+    shared_lock<shared_timed_mutex> locker(mtx);
+    return mIndex.size();
+}
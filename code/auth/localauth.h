@@ -0,0 +1,63 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef LOCAL_AUTH_H
+#define LOCAL_AUTH_H
+
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
+#include <stdint.h>
+#include <fcntl.h>    // open
+#include <unistd.h>   // ftruncate
+#include <sys/stat.h> // fstat
+#include <sys/mman.h> // mmap, mremap
+#include "authbackend.h"
+#include "../log/log.h"
+
+/*
+ * 嵌入式本地用户库, 无需 MySQL
+ * 文件 = Header + 追加写入的记录 [nameLen][pwdLen][name][pwd]
+ * 启动时 mmap 扫描一遍建立 用户名 -> 记录偏移 的内存索引
+ */
+class LocalAuth : public AuthBackend
+{
+public:
+    explicit LocalAuth(const char *path);
+    ~LocalAuth();
+
+    bool IsOpen() const { return mData != nullptr; }
+
+    bool Login(const std::string &name, const std::string &pwd) override;
+    bool Register(const std::string &name, const std::string &pwd) override;
+    const char *Name() const override { return "local"; }
+
+    size_t UserCount();
+
+private:
+    struct Header
+    {
+        char magic[8];
+        uint64_t used;
+    };
+
+    bool Open(const char *path);
+    bool Load();
+    bool Reserve(size_t len);
+    Header *GetHeader() { return reinterpret_cast<Header *>(mData); }
+
+    static const char MAGIC[8];
+    static const size_t INIT_SIZE = 64 * 1024;
+    static const size_t MAX_FIELD = 255;
+
+    int mFd;
+    char *mData;
+    size_t mCapacity;
+
+    std::unordered_map<std::string, size_t> mIndex;
+    std::shared_timed_mutex mtx;
+};
+
+#endif // LOCAL_AUTH_H
@@ -0,0 +1,73 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "sqlauth.h"
+
+using namespace std;
+
+SqlAuth::SqlAuth(const char *host, int port, const char *user, const char *pwd,
+                 const char *dbName, int connSize)
+{
+    SqlConnPool::Instance()->Init(host, port, user, pwd, dbName, connSize);
+    RegisterBatch::Instance()->Init(SqlConnPool::Instance(), 1, 64);
+}
+
+SqlAuth::~SqlAuth()
+{
+    RegisterBatch::Instance()->Close();
+    SqlConnPool::Instance()->ClosePool();
+}
+
+bool SqlAuth::Login(const string &name, const string &pwd)
+{
+    MYSQL *sql;
+    SqlConnRAII conn(&sql, SqlConnPool::Instance());
+    if (!sql)
+    {
+        return false;
+    }
+
+    bool flag = false;
+    MYSQL_RES *res = nullptr;
+
+    /* 查询用户及密码, 用户名需转义防注入 */
+    string order = "SELECT username, password FROM user WHERE username='" +
+                   SqlConnPool::Escape(sql, name) + "' LIMIT 1";
+    LOG_DEBUG("%s", order.c_str());
+
+    if (mysql_query(sql, order.c_str()))
+    {
+        LOG_ERROR("MySQL-ERROR: %s", mysql_error(sql));
+        return false;
+    }
+    res = mysql_store_result(sql);
+    if (!res)
+    {
+        return false;
+    }
+
+    while (MYSQL_ROW row = mysql_fetch_row(res))
+    {
+        LOG_DEBUG("MYSQL ROW: %s", row[0]);
+        string password(row[1] ? row[1] : "");
+        if (pwd == password)
+        {
+            flag = true;
+        }
+        else
+        {
+            flag = false;
+            LOG_DEBUG("pwd error!");
+        }
+    }
+    mysql_free_result(res);
+    return flag;
+}
+
+bool SqlAuth::Register(const string &name, const string &pwd)
+{
+    /* 交给批量提交, 与并发注册合并为一次 INSERT */
+    return RegisterBatch::Instance()->Register(name, pwd);
+}
@@ -0,0 +1,28 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef SQL_AUTH_H
+#define SQL_AUTH_H
+
+#include <mysql/mysql.h>
+#include "authbackend.h"
+#include "../log/log.h"
+#include "../pool/sqlconnpool.h"
+#include "../pool/sqlconnRAII.h"
+#include "../pool/registerbatch.h"
+
+class SqlAuth : public AuthBackend
+{
+public:
+    SqlAuth(const char *host, int port, const char *user, const char *pwd,
+            const char *dbName, int connSize);
+    ~SqlAuth();
+
+    bool Login(const std::string &name, const std::string &pwd) override;
+    bool Register(const std::string &name, const std::string &pwd) override;
+    const char *Name() const override { return "mysql"; }
+};
+
+#endif // SQL_AUTH_H
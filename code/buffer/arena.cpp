@@ -0,0 +1,113 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "arena.h"
+#include <stdlib.h>
+#include <new>
+
+namespace
+{
+    /* 每个线程缓存一块标准大小的块, 连接空闲时还回来, 下个请求直接复用 */
+    struct BlockCache
+    {
+        void *block = nullptr;
+        ~BlockCache() { free(block); }
+    };
+    thread_local BlockCache blockCache;
+}
+
+Arena::Block *Arena::NewBlock(size_t size)
+{
+    if (size == BLOCK_SIZE && blockCache.block)
+    {
+        Block *block = static_cast<Block *>(blockCache.block);
+        blockCache.block = nullptr;
+        block->next = nullptr;
+        return block;
+    }
+    Block *block = static_cast<Block *>(malloc(sizeof(Block) + size));
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    block->next = nullptr;
+    block->size = size;
+    return block;
+}
+
+void Arena::FreeBlock(Block *block)
+{
+    if (block->size == BLOCK_SIZE && !blockCache.block)
+    {
+        blockCache.block = block;
+        return;
+    }
+    free(block);
+}
+
+void Arena::Grow(size_t len)
+{
+    size_t size = BLOCK_SIZE;
+    while (size < len + alignof(std::max_align_t))
+    {
+        size *= 2;
+    }
+    Block *block = NewBlock(size);
+    block->next = head;
+    head = block;
+    ptr = reinterpret_cast<char *>(block + 1);
+    end = ptr + size;
+}
+
+void *Arena::Alloc(size_t len, size_t align)
+{
+    assert(align && (align & (align - 1)) == 0);
+    uintptr_t cur = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t aligned = (cur + align - 1) & ~(uintptr_t)(align - 1);
+    if (!head || aligned + len > reinterpret_cast<uintptr_t>(end))
+    {
+        Grow(len);
+        cur = reinterpret_cast<uintptr_t>(ptr);
+        aligned = (cur + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    ptr = reinterpret_cast<char *>(aligned + len);
+    return reinterpret_cast<void *>(aligned);
+}
+
+char *Arena::Dup(const char *str, size_t len)
+{
+    char *dst = static_cast<char *>(Alloc(len + 1, 1));
+    memcpy(dst, str, len);
+    dst[len] = '\0';
+    return dst;
+}
+
+void Arena::Reset()
+{
+    if (!head)
+    {
+        return;
+    }
+    /* 通常只有一块, O(1) 回到起点; 超出首块时只保留最早的一块 */
+    while (head->next)
+    {
+        Block *next = head->next;
+        FreeBlock(head);
+        head = next;
+    }
+    ptr = reinterpret_cast<char *>(head + 1);
+    end = ptr + head->size;
+}
+
+void Arena::Release()
+{
+    while (head)
+    {
+        Block *next = head->next;
+        FreeBlock(head);
+        head = next;
+    }
+    ptr = end = nullptr;
+}
@@ -0,0 +1,76 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+#include <cstring>
+#include <cstddef>
+#include <string>
+#include <assert.h>
+
+/* 指向 Arena 或缓冲区内存的只读字符串片段, 不持有内存 */
+struct StrRef
+{
+    const char *data;
+    size_t len;
+
+    StrRef() : data(""), len(0) {}
+    StrRef(const char *str, size_t n) : data(str), len(n) {}
+
+    bool empty() const { return len == 0; }
+    std::string str() const { return std::string(data, len); }
+
+    bool operator==(const char *str) const
+    {
+        return strlen(str) == len && memcmp(data, str, len) == 0;
+    }
+    bool operator!=(const char *str) const { return !(*this == str); }
+    bool operator==(const StrRef &other) const
+    {
+        return len == other.len && memcmp(data, other.data, len) == 0;
+    }
+};
+
+/*
+ * 单次请求用的线性分配器: 只分配不单独释放, 请求结束 Reset 一次性回收
+ * 首块在 Reset 时保留复用, Release 时还给线程本地缓存, 稳态下每个请求零次 malloc
+ */
+class Arena
+{
+public:
+    Arena() : head(nullptr), ptr(nullptr), end(nullptr) {}
+    ~Arena() { Release(); }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *Alloc(size_t len, size_t align = alignof(std::max_align_t));
+
+    /* 拷贝一段字符串并以 '\0' 结尾, 便于直接用于日志与 C 接口 */
+    char *Dup(const char *str, size_t len);
+
+    void Reset();
+    void Release();
+
+private:
+    struct Block
+    {
+        Block *next;
+        size_t size;
+    };
+
+    void Grow(size_t len);
+    static Block *NewBlock(size_t size);
+    static void FreeBlock(Block *block);
+
+    static const size_t BLOCK_SIZE = 4096;
+
+    Block *head;
+    char *ptr;
+    char *end;
+};
+
+#endif // ARENA_H
@@ -5,7 +5,7 @@
  */
 #include "buffer.h"
 
-Buffer::Buffer(int initBuffSize) : buffer(initBuffSize), readPos(0), writePos(0) {}
+Buffer::Buffer(int initBuffSize) : buffer(initBuffSize), readPos(0), writePos(0), initSize(initBuffSize) {}
 
 size_t Buffer::ReadableBytes() const
 {
@@ -41,7 +41,6 @@ void Buffer::RetrieveUntil(const char *end)
 
 void Buffer::RetrieveAll()
 {
-    bzero(&buffer[0], buffer.size());
     readPos = 0;
     writePos = 0;
 }
@@ -53,6 +52,24 @@ std::string Buffer::RetrieveAllToStr()
     return str;
 }
 
+void Buffer::ShrinkToFit()
+{
+    if (buffer.size() <= initSize || ReadableBytes() > initSize)
+    {
+        return;
+    }
+    std::vector<char> newBuffer(initSize);
+    std::copy(Peek(), BeginWriteConst(), newBuffer.begin());
+    writePos = ReadableBytes();
+    readPos = 0;
+    buffer.swap(newBuffer);
+}
+
+size_t Buffer::Capacity() const
+{
+    return buffer.size();
+}
+
 const char *Buffer::BeginWriteConst() const
 {
     return BeginPtr() + writePos;
@@ -101,16 +118,29 @@ void Buffer::EnsureWriteable(size_t len)
     assert(WritableBytes() >= len);
 }
 
-ssize_t Buffer::ReadFd(int fd, int *saveErrno)
+char *Buffer::ExtraBuf()
 {
-    char buff[65535];
+    /* 每个线程一块共享的接收 slab, 代替栈上 64KB 临时数组 */
+    static thread_local std::vector<char> slab(EXTRA_BUF_SIZE);
+    return slab.data();
+}
+
+ssize_t Buffer::ReadFd(int fd, int *saveErrno, size_t sizeHint)
+{
+    /* 按内核中待读字节数预留空间, 数据直接读进缓冲区, 大请求体不再二次拷贝 */
+    int pending = 0;
+    if (sizeHint && ioctl(fd, FIONREAD, &pending) == 0 && pending > 0)
+    {
+        EnsureWriteable(std::min(static_cast<size_t>(pending), sizeHint));
+    }
+    char *buff = ExtraBuf();
     struct iovec iov[2];
     const size_t writable = WritableBytes();
     /* 分散读， 保证数据全部读完 */
     iov[0].iov_base = BeginPtr() + writePos;
     iov[0].iov_len = writable;
     iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
+    iov[1].iov_len = EXTRA_BUF_SIZE;
 
     const ssize_t len = readv(fd, iov, 2);
     if (len < 0)
@@ -154,16 +184,14 @@ const char *Buffer::BeginPtr() const
 
 void Buffer::MakeSpace(size_t len)
 {
-    if (WritableBytes() + PrependableBytes() < len)
-    {
-        buffer.resize(writePos + len + 1);
-    }
-    else
+    /* 先把可读数据挪到头部, 空间仍不够再按倍数扩容 */
+    size_t readable = ReadableBytes();
+    std::copy(BeginPtr() + readPos, BeginPtr() + writePos, BeginPtr());
+    readPos = 0;
+    writePos = readable;
+    if (WritableBytes() < len)
     {
-        size_t readable = ReadableBytes();
-        std::copy(BeginPtr() + readPos, BeginPtr() + writePos, BeginPtr());
-        readPos = 0;
-        writePos = readPos + readable;
-        assert(readable == ReadableBytes());
+        buffer.resize(std::max(buffer.size() * 2, readable + len));
     }
+    assert(readable == ReadableBytes());
 }
\ No newline at end of file
@@ -10,8 +10,9 @@
 #include <iostream>
 #include <unistd.h>  // write
 #include <sys/uio.h> //readv
+#include <sys/ioctl.h> //FIONREAD
 #include <vector>    //readv
-#include <atomic>
+#include <algorithm> //max
 #include <assert.h>
 
 class Buffer
@@ -34,6 +35,10 @@ public:
     void RetrieveAll();
     std::string RetrieveAllToStr();
 
+    /* 空闲时把超出初始大小的内存还给系统 */
+    void ShrinkToFit();
+    size_t Capacity() const;
+
     const char *BeginWriteConst() const;
     char *BeginWrite();
 
@@ -42,17 +47,23 @@ public:
     void Append(const void *data, size_t len);
     void Append(const Buffer &buff);
 
-    ssize_t ReadFd(int fd, int *Errno);
+    /* sizeHint 非 0 时先按 FIONREAD 预留空间, 最多 sizeHint 字节 */
+    ssize_t ReadFd(int fd, int *Errno, size_t sizeHint = 0);
     ssize_t WriteFd(int fd, int *Errno);
 
 private:
     char *BeginPtr();
     const char *BeginPtr() const;
     void MakeSpace(size_t len);
+    static char *ExtraBuf();
+
+    static const size_t EXTRA_BUF_SIZE = 65536;
 
+    /* 每个缓冲区只属于一个连接, 下标无需原子操作 */
     std::vector<char> buffer;
-    std::atomic<std::size_t> readPos;
-    std::atomic<std::size_t> writePos;
+    std::size_t readPos;
+    std::size_t writePos;
+    std::size_t initSize;
 };
 
 #endif // BUFFER_H
\ No newline at end of file
@@ -0,0 +1,256 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "bufferchain.h"
+
+BufferChain::BufferChain() : head(0), bytes(0), blockIdx(0), lastSmallEnd(nullptr) {}
+
+size_t BufferChain::ReadableBytes() const
+{
+    return bytes;
+}
+
+size_t BufferChain::SegmentCount() const
+{
+    return segs.size() - head;
+}
+
+bool BufferChain::Empty() const
+{
+    return bytes == 0;
+}
+
+void BufferChain::AppendStatic(const char *str, size_t len)
+{
+    assert(str);
+    if (len == 0)
+    {
+        return;
+    }
+    segs.push_back({str, len, nullptr});
+    bytes += len;
+    lastSmallEnd = nullptr;
+}
+
+void BufferChain::AppendStatic(const char *str)
+{
+    AppendStatic(str, strlen(str));
+}
+
+void BufferChain::Append(const std::string &str)
+{
+    Append(str.data(), str.size());
+}
+
+void BufferChain::Append(const char *str, size_t len)
+{
+    assert(str);
+    if (len == 0)
+    {
+        return;
+    }
+    if (len > SMALL_BLOCK_SIZE)
+    {
+        /* 大块内容单独持有 */
+        auto owner = std::make_shared<std::string>(str, len);
+        AppendShared(owner, owner->data(), len);
+        return;
+    }
+    char *dst = AllocSmall(len);
+    memcpy(dst, str, len);
+    if (lastSmallEnd == dst && SegmentCount() > 0)
+    {
+        segs.back().len += len;
+    }
+    else
+    {
+        segs.push_back({dst, len, nullptr});
+    }
+    bytes += len;
+    lastSmallEnd = dst + len;
+}
+
+void BufferChain::AppendShared(const std::shared_ptr<const void> &owner, const char *data, size_t len)
+{
+    assert(data);
+    if (len == 0)
+    {
+        return;
+    }
+    segs.push_back({data, len, owner});
+    bytes += len;
+    lastSmallEnd = nullptr;
+}
+
+char *BufferChain::AllocSmall(size_t len)
+{
+    assert(len <= SMALL_BLOCK_SIZE);
+    if (blockIdx < blocks.size() && blocks[blockIdx].used + len > SMALL_BLOCK_SIZE)
+    {
+        /* 换块后不与上一段合并 */
+        blockIdx++;
+        lastSmallEnd = nullptr;
+    }
+    if (blockIdx == blocks.size())
+    {
+        blocks.push_back({std::unique_ptr<char[]>(new char[SMALL_BLOCK_SIZE]), 0, 0});
+    }
+    Block &block = blocks[blockIdx];
+    char *ptr = block.mem.get() + block.used;
+    block.used += len;
+    return ptr;
+}
+
+void BufferChain::ReleaseSmall(const char *data, size_t len)
+{
+    /* 静态片段不在任何块内; 块数很少, 直接按地址查找 */
+    for (size_t i = 0; i <= blockIdx && i < blocks.size(); i++)
+    {
+        const char *mem = blocks[i].mem.get();
+        if (data >= mem && data < mem + SMALL_BLOCK_SIZE)
+        {
+            blocks[i].freed += len;
+            break;
+        }
+    }
+    while (blockIdx > 0 && blocks[0].freed == blocks[0].used)
+    {
+        Block block = std::move(blocks[0]);
+        blocks.erase(blocks.begin());
+        blockIdx--;
+        /* 最多留一块备用, 其余释放 */
+        if (blocks.size() == blockIdx + 1)
+        {
+            block.used = 0;
+            block.freed = 0;
+            blocks.push_back(std::move(block));
+        }
+    }
+}
+
+void BufferChain::Retrieve(size_t len)
+{
+    assert(len <= bytes);
+    bytes -= len;
+    while (len > 0)
+    {
+        Segment &seg = segs[head];
+        size_t n = std::min(len, seg.len);
+        if (!seg.owner)
+        {
+            ReleaseSmall(seg.data, n);
+        }
+        if (len < seg.len)
+        {
+            seg.data += len;
+            seg.len -= len;
+            break;
+        }
+        len -= seg.len;
+        seg.owner.reset();
+        head++;
+    }
+    if (bytes == 0)
+    {
+        RetrieveAll();
+    }
+    else if (head >= COMPACT_SEGS && head * 2 >= segs.size())
+    {
+        /* 链一直不清空时(HTTP/2, 长时间的流式响应)丢掉已取出的片段, 移动的元素不超过丢掉的 */
+        segs.erase(segs.begin(), segs.begin() + head);
+        head = 0;
+    }
+}
+
+void BufferChain::MoveTo(BufferChain &dst, size_t len)
+{
+    assert(len <= bytes);
+    size_t left = len;
+    for (size_t i = head; left > 0; i++)
+    {
+        const Segment &seg = segs[i];
+        size_t n = std::min(left, seg.len);
+        if (seg.owner)
+        {
+            dst.AppendShared(seg.owner, seg.data, n);
+        }
+        else
+        {
+            dst.Append(seg.data, n);
+        }
+        left -= n;
+    }
+    Retrieve(len);
+}
+
+size_t BufferChain::Gather(char *dst, size_t len) const
+{
+    size_t copied = 0;
+    for (size_t i = head; i < segs.size() && copied < len; i++)
+    {
+        size_t n = std::min(len - copied, segs[i].len);
+        memcpy(dst + copied, segs[i].data, n);
+        copied += n;
+    }
+    return copied;
+}
+
+void BufferChain::RetrieveAll()
+{
+    segs.clear();
+    head = 0;
+    bytes = 0;
+    /* 保留第一块小块内存, 其余释放 */
+    if (blocks.size() > 1)
+    {
+        blocks.resize(1);
+    }
+    if (!blocks.empty())
+    {
+        blocks[0].used = 0;
+        blocks[0].freed = 0;
+    }
+    blockIdx = 0;
+    lastSmallEnd = nullptr;
+}
+
+void BufferChain::ShrinkToFit()
+{
+    if (!Empty())
+    {
+        return;
+    }
+    RetrieveAll();
+    std::vector<Segment>().swap(segs);
+    std::vector<Block>().swap(blocks);
+}
+
+ssize_t BufferChain::WriteFd(int fd, int *saveErrno)
+{
+    size_t cnt = std::min(SegmentCount(), static_cast<size_t>(IOV_MAX));
+    if (cnt == 0)
+    {
+        return 0;
+    }
+    /* iovec 数组每个线程共用一份, 不占连接内存 */
+    static thread_local std::vector<struct iovec> iov;
+    if (iov.size() < cnt)
+    {
+        iov.resize(cnt);
+    }
+    for (size_t i = 0; i < cnt; i++)
+    {
+        iov[i].iov_base = const_cast<char *>(segs[head + i].data);
+        iov[i].iov_len = segs[head + i].len;
+    }
+    ssize_t len = writev(fd, iov.data(), static_cast<int>(cnt));
+    if (len < 0)
+    {
+        *saveErrno = errno;
+        return len;
+    }
+    Retrieve(len);
+    return len;
+}
@@ -0,0 +1,94 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+
+#ifndef BUFFER_CHAIN_H
+#define BUFFER_CHAIN_H
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <limits.h>  // IOV_MAX
+#include <unistd.h>
+#include <sys/uio.h> // writev
+#include <assert.h>
+#include <errno.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/*
+ * 由多个只读片段组成的发送链, 一次 writev 发出
+ * 片段可以是: 静态字符串(不拷贝), 小段格式化内容(拷入内部小块), 文件映射/缓存体(引用计数持有)
+ */
+class BufferChain
+{
+public:
+    BufferChain();
+    ~BufferChain() = default;
+
+    size_t ReadableBytes() const;
+    size_t SegmentCount() const;
+    bool Empty() const;
+
+    /* 静态存储的字符串, 生命周期长于本链 */
+    void AppendStatic(const char *str, size_t len);
+    void AppendStatic(const char *str);
+
+    /* 拷贝一小段内容, 与前一个拷贝片段相邻时合并为一个 iovec */
+    void Append(const char *str, size_t len);
+    void Append(const std::string &str);
+
+    /* 引用计数持有的内存, 如文件映射或缓存的响应体 */
+    void AppendShared(const std::shared_ptr<const void> &owner, const char *data, size_t len);
+
+    void Retrieve(size_t len);
+    void RetrieveAll();
+
+    /* 把开头 len 字节移到 dst 末尾: 引用计数片段只转移引用, 其余拷贝 */
+    void MoveTo(BufferChain &dst, size_t len);
+
+    /* 把开头至多 len 字节拷到 dst, 不取出; 用于需要连续缓冲区的写入(如 SSL_write) */
+    size_t Gather(char *dst, size_t len) const;
+
+    /* 连接空闲时释放全部内部存储 */
+    void ShrinkToFit();
+
+    ssize_t WriteFd(int fd, int *Errno);
+
+private:
+    struct Segment
+    {
+        const char *data;
+        size_t len;
+        std::shared_ptr<const void> owner;
+    };
+
+    struct Block
+    {
+        std::unique_ptr<char[]> mem;
+        size_t used;  /* 已分配出去的字节 */
+        size_t freed; /* 其中已被取出的字节, 与 used 相等时整块可回收 */
+    };
+
+    char *AllocSmall(size_t len);
+    void ReleaseSmall(const char *data, size_t len);
+
+    static const size_t SMALL_BLOCK_SIZE = 4096;
+    static const size_t COMPACT_SEGS = 64; /* 已取出的片段超过这个数且占一半以上时前移 */
+
+    std::vector<Segment> segs;
+    size_t head;
+    size_t bytes;
+
+    /* 小段拷贝内容的存储, 按分配顺序使用; 开头的块取完后移到末尾复用, 链一直不清空时也不增长 */
+    std::vector<Block> blocks;
+    size_t blockIdx;
+    const char *lastSmallEnd;
+};
+
+#endif // BUFFER_CHAIN_H
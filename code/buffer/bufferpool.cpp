@@ -0,0 +1,58 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "bufferpool.h"
+
+BufferPool::BufferPool() : maxCached(1024), buffSize(1024) {}
+
+BufferPool *BufferPool::Instance()
+{
+    static BufferPool pool;
+    return &pool;
+}
+
+void BufferPool::Init(size_t maxCached, int buffSize)
+{
+    assert(buffSize > 0);
+    std::lock_guard<std::mutex> locker(mtx);
+    this->maxCached = maxCached;
+    this->buffSize = buffSize;
+    freeList.clear();
+}
+
+std::unique_ptr<Buffer> BufferPool::Acquire()
+{
+    {
+        std::lock_guard<std::mutex> locker(mtx);
+        if (!freeList.empty())
+        {
+            std::unique_ptr<Buffer> buff = std::move(freeList.back());
+            freeList.pop_back();
+            return buff;
+        }
+    }
+    return std::unique_ptr<Buffer>(new Buffer(buffSize));
+}
+
+void BufferPool::Release(std::unique_ptr<Buffer> buff)
+{
+    if (!buff)
+    {
+        return;
+    }
+    buff->RetrieveAll();
+    buff->ShrinkToFit();
+    std::lock_guard<std::mutex> locker(mtx);
+    if (freeList.size() < maxCached)
+    {
+        freeList.push_back(std::move(buff));
+    }
+}
+
+size_t BufferPool::CachedCount()
+{
+    std::lock_guard<std::mutex> locker(mtx);
+    return freeList.size();
+}
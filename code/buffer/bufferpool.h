@@ -0,0 +1,37 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+#include <vector>
+#include <memory>
+#include <mutex>
+#include "buffer.h"
+
+/* 空闲连接不持有缓冲区, 有数据收发时才从池中借出 */
+class BufferPool
+{
+public:
+    static BufferPool *Instance();
+
+    void Init(size_t maxCached, int buffSize);
+
+    std::unique_ptr<Buffer> Acquire();
+    void Release(std::unique_ptr<Buffer> buff);
+
+    size_t CachedCount();
+
+private:
+    BufferPool();
+    ~BufferPool() = default;
+
+    size_t maxCached;
+    int buffSize;
+    std::vector<std::unique_ptr<Buffer>> freeList;
+    std::mutex mtx;
+};
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,420 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-28
+ * @copyleft Apache 2.0
+ */
+#include "config.h"
+#include "../server/affinity.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fstream>
+
+using namespace std;
+
+namespace
+{
+    enum VALUE_TYPE
+    {
+        VT_INT = 0,
+        VT_SIZE,   /* 字节数, 可带 K/M/G 后缀 */
+        VT_DOUBLE,
+        VT_BOOL,
+        VT_STRING,
+        VT_CPU_LIST, /* 字符串, 按 "0-3,8" 格式检查 */
+    };
+
+    struct Item
+    {
+        const char *key;
+        VALUE_TYPE type;
+        void *(*field)(ServerConfig &);
+        double min;
+        double max;
+        bool reloadable;
+        const char *help;
+        bool secret; /* 不写入日志 */
+    };
+
+#define CONFIG_FIELD(member) [](ServerConfig &c) -> void * { return &c.member; }
+
+    const double INF = 1e18;
+
+    /* 顺序即 --help 与 Dump 的输出顺序 */
+    const Item ITEMS[] = {
+        {"port", VT_INT, CONFIG_FIELD(port), 1024, 65535, false, "listening port"},
+        {"trig_mode", VT_INT, CONFIG_FIELD(trigMode), 0, 3, false, "0 LT, 1 ET connections, 2 ET listen, 3 ET both"},
+        {"threads", VT_INT, CONFIG_FIELD(threadNum), 1, 1024, false, "worker threads"},
+        {"cpu.reactor", VT_INT, CONFIG_FIELD(cpuReactor), -1, 1023, false, "pin the event loop thread to this CPU, -1 floats"},
+        {"cpu.workers", VT_CPU_LIST, CONFIG_FIELD(cpuWorkers), 0, 0, false, "pin worker i to the i-th CPU of this list, e.g. 2-7"},
+        {"cpu.numa_node", VT_INT, CONFIG_FIELD(numaNode), -1, 63, false,
+         "allocate memory on this node and keep unpinned threads there, -1 follows cpu.reactor"},
+        {"cpu.incoming", VT_BOOL, CONFIG_FIELD(cpuIncoming), 0, 1, true, "count connections received on a remote NUMA node"},
+        {"linger", VT_BOOL, CONFIG_FIELD(optLinger), 0, 1, false, "SO_LINGER 1s on close"},
+        {"idle_timeout_ms", VT_INT, CONFIG_FIELD(timeoutMs), 0, INF, false, "keep-alive idle timeout, 0 disables all timeouts"},
+        {"log", VT_BOOL, CONFIG_FIELD(openLog), 0, 1, false, "write ./bin/*.log"},
+        {"log_level", VT_INT, CONFIG_FIELD(logLevel), 0, 3, true, "0 debug, 1 info, 2 warn, 3 error"},
+        {"log_queue", VT_INT, CONFIG_FIELD(logQueSize), 0, INF, false, "async log queue capacity, 0 writes synchronously"},
+        {"user_db", VT_STRING, CONFIG_FIELD(localUserDb), 0, 0, false, "local user database file; empty uses MySQL (./bin/user.db without MySQL)"},
+        {"sql.port", VT_INT, CONFIG_FIELD(sqlPort), 1, 65535, false, "MySQL port on localhost"},
+        {"sql.user", VT_STRING, CONFIG_FIELD(sqlUser), 0, 0, false, "MySQL user"},
+        {"sql.password", VT_STRING, CONFIG_FIELD(sqlPwd), 0, 0, false, "MySQL password", true},
+        {"sql.database", VT_STRING, CONFIG_FIELD(dbName), 0, 0, false, "MySQL database"},
+        {"sql.pool", VT_INT, CONFIG_FIELD(connPoolNum), 1, 1024, false, "MySQL connections"},
+        {"tls.cert", VT_STRING, CONFIG_FIELD(tlsCert), 0, 0, false, "certificate (PEM); with tls.key enables HTTPS"},
+        {"tls.key", VT_STRING, CONFIG_FIELD(tlsKey), 0, 0, false, "private key (PEM)"},
+        {"trace_sample", VT_INT, CONFIG_FIELD(traceSample), 0, INF, true, "trace 1 of N requests, 0 disables"},
+        {"cache.max_bytes", VT_SIZE, CONFIG_FIELD(cacheBytes), 0, INF, true, "static file cache capacity"},
+        {"cache.ttl_ms", VT_INT, CONFIG_FIELD(cacheTtlMs), 0, INF, true, "re-stat cached files after this long"},
+        {"buffer.size", VT_INT, CONFIG_FIELD(bufferSize), 64, 1 << 30, false, "initial read buffer size"},
+        {"buffer.pool_max", VT_SIZE, CONFIG_FIELD(bufferPoolMax), 0, INF, false, "idle buffers kept for reuse"},
+        {"buffer.fionread", VT_BOOL, CONFIG_FIELD(fionRead), 0, 1, false, "size each read with FIONREAD (one extra ioctl)"},
+        {"admission.max_conns", VT_INT, CONFIG_FIELD(admission.maxConns), 1, INF, true, "total connection cap"},
+        {"admission.per_ip_conns", VT_INT, CONFIG_FIELD(admission.perIpConns), 0, INF, true, "connections per IP, 0 unlimited"},
+        {"admission.conn_rate", VT_DOUBLE, CONFIG_FIELD(admission.connRate), 0, INF, true, "new connections/s per IP, 0 unlimited"},
+        {"admission.req_rate", VT_DOUBLE, CONFIG_FIELD(admission.reqRate), 0, INF, true, "requests/s per IP, 0 unlimited"},
+        {"admission.burst_sec", VT_DOUBLE, CONFIG_FIELD(admission.burstSec), 0, INF, true, "token bucket size in seconds of rate"},
+        {"admission.accept_batch", VT_INT, CONFIG_FIELD(admission.acceptBatch), 1, INF, true, "accepts per listen event"},
+        {"admission.backlog", VT_INT, CONFIG_FIELD(admission.backlog), 0, INF, false, "listen backlog, 0 uses SOMAXCONN"},
+        {"admission.max_queue_delay_ms", VT_INT, CONFIG_FIELD(admission.maxQueueDelayMs), 0, INF, true,
+         "answer 503 to new connections above this worker queue delay, 0 disables"},
+        {"timeout.header_ms", VT_INT, CONFIG_FIELD(timeouts.headerMs), 1, INF, true, "deadline for a complete request header"},
+        {"timeout.body_grace_ms", VT_INT, CONFIG_FIELD(timeouts.bodyGraceMs), 0, INF, true, "body time before the rate check"},
+        {"timeout.body_min_rate", VT_INT, CONFIG_FIELD(timeouts.bodyMinRate), 0, INF, true, "minimum body bytes/s, 0 disables"},
+        {"timeout.write_stall_ms", VT_INT, CONFIG_FIELD(timeouts.writeStallMs), 1, INF, true, "close when a response makes no progress"},
+        {"timeout.drain_ms", VT_INT, CONFIG_FIELD(timeouts.drainMs), 0, INF, true, "graceful shutdown limit"},
+    };
+
+#undef CONFIG_FIELD
+
+    const Item *FindItem(const string &key)
+    {
+        for (const Item &item : ITEMS)
+        {
+            if (key == item.key)
+            {
+                return &item;
+            }
+        }
+        return nullptr;
+    }
+
+    string Trim(const string &s)
+    {
+        size_t begin = s.find_first_not_of(" \t\r\n");
+        if (begin == string::npos)
+        {
+            return "";
+        }
+        size_t end = s.find_last_not_of(" \t\r\n");
+        return s.substr(begin, end - begin + 1);
+    }
+
+    bool ParseNumber(const Item &item, const string &value, double *out)
+    {
+        if (value.empty())
+        {
+            return false;
+        }
+        char *end = nullptr;
+        errno = 0;
+        double v = strtod(value.c_str(), &end);
+        if (item.type == VT_SIZE && *end)
+        {
+            switch (*end++)
+            {
+            case 'k': case 'K': v *= 1024.0; break;
+            case 'm': case 'M': v *= 1024.0 * 1024; break;
+            case 'g': case 'G': v *= 1024.0 * 1024 * 1024; break;
+            default: return false;
+            }
+        }
+        /* 表中的上限多为 INF, int 字段另受 INT_MAX 限制, 否则转换溢出成负数 */
+        if (errno || *end || v < item.min || v > item.max || (item.type == VT_INT && v > INT_MAX))
+        {
+            return false;
+        }
+        if (item.type != VT_DOUBLE && v != static_cast<double>(static_cast<long long>(v)))
+        {
+            return false;
+        }
+        *out = v;
+        return true;
+    }
+
+    bool ParseBool(const string &value, bool *out)
+    {
+        for (const char *s : {"1", "true", "on", "yes"})
+        {
+            if (strcasecmp(value.c_str(), s) == 0)
+            {
+                *out = true;
+                return true;
+            }
+        }
+        for (const char *s : {"0", "false", "off", "no"})
+        {
+            if (strcasecmp(value.c_str(), s) == 0)
+            {
+                *out = false;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool Config::Set(ServerConfig &config, const string &key, const string &value, string *err)
+{
+    const Item *item = FindItem(key);
+    if (!item)
+    {
+        *err = "unknown setting '" + key + "'";
+        return false;
+    }
+    void *field = item->field(config);
+    double number = 0;
+    bool ok = true;
+    switch (item->type)
+    {
+    case VT_INT:
+        if ((ok = ParseNumber(*item, value, &number)))
+        {
+            *static_cast<int *>(field) = static_cast<int>(number);
+        }
+        break;
+    case VT_SIZE:
+        if ((ok = ParseNumber(*item, value, &number)))
+        {
+            *static_cast<size_t *>(field) = static_cast<size_t>(number);
+        }
+        break;
+    case VT_DOUBLE:
+        if ((ok = ParseNumber(*item, value, &number)))
+        {
+            *static_cast<double *>(field) = number;
+        }
+        break;
+    case VT_BOOL:
+        ok = ParseBool(value, static_cast<bool *>(field));
+        break;
+    case VT_STRING:
+        *static_cast<string *>(field) = value;
+        break;
+    case VT_CPU_LIST:
+    {
+        vector<int> cpus;
+        if ((ok = ParseCpuList(value, &cpus)))
+        {
+            *static_cast<string *>(field) = value;
+        }
+        break;
+    }
+    }
+    if (!ok)
+    {
+        *err = "invalid value '" + value + "' for " + key;
+    }
+    return ok;
+}
+
+string Config::Get(const ServerConfig &config, const string &key)
+{
+    const Item *item = FindItem(key);
+    if (!item)
+    {
+        return "";
+    }
+    /* 表中只有取地址的函数, 读取不会修改 */
+    void *field = item->field(const_cast<ServerConfig &>(config));
+    char buf[64];
+    switch (item->type)
+    {
+    case VT_INT:
+        return to_string(*static_cast<int *>(field));
+    case VT_SIZE:
+        return to_string(*static_cast<size_t *>(field));
+    case VT_DOUBLE:
+        snprintf(buf, sizeof(buf), "%g", *static_cast<double *>(field));
+        return buf;
+    case VT_BOOL:
+        return *static_cast<bool *>(field) ? "true" : "false";
+    default:
+        return *static_cast<string *>(field);
+    }
+}
+
+bool Config::Reloadable(const string &key)
+{
+    const Item *item = FindItem(key);
+    return item && item->reloadable;
+}
+
+bool Config::Secret(const string &key)
+{
+    const Item *item = FindItem(key);
+    return item && item->secret;
+}
+
+vector<string> Config::Diff(const ServerConfig &a, const ServerConfig &b)
+{
+    vector<string> keys;
+    for (const Item &item : ITEMS)
+    {
+        if (Get(a, item.key) != Get(b, item.key))
+        {
+            keys.push_back(item.key);
+        }
+    }
+    return keys;
+}
+
+bool Config::LoadFile(const string &path, ServerConfig &config, string *err)
+{
+    ifstream in(path);
+    if (!in)
+    {
+        *err = "cannot open " + path;
+        return false;
+    }
+    string line;
+    int lineNo = 0;
+    while (getline(in, line))
+    {
+        lineNo++;
+        line = Trim(line);
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == string::npos)
+        {
+            *err = path + ":" + to_string(lineNo) + ": expected key = value";
+            return false;
+        }
+        if (!Set(config, Trim(line.substr(0, eq)), Trim(line.substr(eq + 1)), err))
+        {
+            *err = path + ":" + to_string(lineNo) + ": " + *err;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Config::Load(ServerConfig &config, string *err)
+{
+    ServerConfig next;
+    next.configFile = config.configFile;
+    next.overrides = config.overrides;
+    if (!next.configFile.empty() && !LoadFile(next.configFile, next, err))
+    {
+        return false;
+    }
+    for (const auto &kv : next.overrides)
+    {
+        if (!Set(next, kv.first, kv.second, err))
+        {
+            return false;
+        }
+    }
+    config = std::move(next);
+    return true;
+}
+
+bool Config::Parse(int argc, char *argv[], ServerConfig &config, string *err)
+{
+    bool print = false;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+        {
+            Usage(stdout, argv[0]);
+            exit(0);
+        }
+        if (arg == "--print-config")
+        {
+            print = true;
+            continue;
+        }
+        if (arg.compare(0, 2, "--") != 0 && arg != "-c")
+        {
+            *err = "unexpected argument '" + arg + "'";
+            return false;
+        }
+        string key = arg == "-c" ? "config" : arg.substr(2);
+        string value;
+        size_t eq = key.find('=');
+        if (eq != string::npos)
+        {
+            value = key.substr(eq + 1);
+            key.resize(eq);
+        }
+        else if (i + 1 < argc)
+        {
+            value = argv[++i];
+        }
+        else
+        {
+            *err = "missing value for " + arg;
+            return false;
+        }
+        if (key == "config")
+        {
+            config.configFile = value;
+            continue;
+        }
+        /* 先检查一遍, 出错时指出命令行参数而不是在加载之后 */
+        ServerConfig probe;
+        if (!Set(probe, key, value, err))
+        {
+            return false;
+        }
+        config.overrides.emplace_back(key, value);
+    }
+    if (!Load(config, err))
+    {
+        return false;
+    }
+    if (print)
+    {
+        fputs(Dump(config).c_str(), stdout);
+        exit(0);
+    }
+    return true;
+}
+
+string Config::Dump(const ServerConfig &config)
+{
+    string out;
+    for (const Item &item : ITEMS)
+    {
+        out += "# ";
+        out += item.help;
+        out += item.reloadable ? " (SIGHUP)\n" : "\n";
+        out += item.key;
+        out += " = " + Get(config, item.key) + "\n";
+    }
+    return out;
+}
+
+void Config::Usage(FILE *out, const char *prog)
+{
+    fprintf(out,
+            "usage: %s [-c FILE] [--key=value ...]\n"
+            "  -c, --config FILE              read settings from FILE, one \"key = value\" per line\n"
+            "  --print-config                 print the effective settings in file format and exit\n"
+            "  -h, --help                     show this help\n"
+            "settings, * = reloaded on SIGHUP:\n",
+            prog);
+    ServerConfig defaults;
+    for (const Item &item : ITEMS)
+    {
+        string value = Get(defaults, item.key);
+        fprintf(out, "  %c %-30s %-10s %s\n", item.reloadable ? '*' : ' ', item.key,
+                value.empty() ? "\"\"" : value.c_str(), item.help);
+    }
+}
@@ -2,4 +2,103 @@
  * @Author       : mark
  * @Date         : 2020-06-28
  * @copyleft Apache 2.0
- */ 
+ */
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "../server/admission.h"
+
+/* 按连接阶段的超时, 空闲超时仍由 timeoutMs 给出; timeoutMs 为 0 时全部关闭 */
+struct TimeoutConfig
+{
+    int headerMs = 10000;     /* 从建立连接或请求首字节起, 请求头必须在此时间内收完 */
+    int bodyGraceMs = 5000;   /* 请求头收完后的宽限时间 */
+    int bodyMinRate = 1024;   /* 宽限之后请求体平均速率下限(字节/秒), 0 不检查, 只受空闲超时限制 */
+    int writeStallMs = 20000; /* 响应发送无进展的最长时间 */
+    int drainMs = 30000;      /* 退出时等待进行中请求完成的最长时间, 到期强制关闭 */
+};
+
+/* 服务器的全部可调参数, 默认值即不带配置文件启动时的行为 */
+struct ServerConfig
+{
+    /* 服务器默认开启过载保护: 线程池平均排队超过 100ms 时新连接直接返回 503 */
+    ServerConfig() { admission.maxQueueDelayMs = 100; }
+
+    int port = 1316;
+    int trigMode = 3;           /* 0 都用 LT, 1 连接 ET, 2 监听 ET, 3 都用 ET */
+    int timeoutMs = 60000;      /* 长连接空闲超时, 0 关闭所有超时 */
+    bool optLinger = false;     /* 关闭连接时等待剩余数据发完 */
+    int threadNum = 6;
+
+    int cpuReactor = -1;        /* 事件循环线程绑定的 CPU, -1 不绑定 */
+    std::string cpuWorkers;     /* 工作线程依次绑定的 CPU 列表, 如 "2-7", 空为不绑定 */
+    int numaNode = -1;          /* 内存所在节点, 未指定 CPU 的线程也限制在该节点; -1 时跟随 cpuReactor */
+    bool cpuIncoming = false;   /* 统计收包 CPU 与内存不在同一节点的连接 */
+
+    bool openLog = true;
+    int logLevel = 1;
+    int logQueSize = 1024;      /* 异步日志队列容量, 0 为同步写 */
+
+#ifdef WEBSERVER_NO_MYSQL
+    std::string localUserDb = "./bin/user.db"; /* 未链接 MySQL 的构建只能使用本地用户库 */
+#else
+    std::string localUserDb;    /* 非空时使用本地用户库, 不连接 MySQL */
+#endif
+    int sqlPort = 3306;
+    std::string sqlUser = "root";
+    std::string sqlPwd = "SK.2022a";
+    std::string dbName = "webserver";
+    int connPoolNum = 12;
+
+    std::string tlsCert;        /* 证书与私钥(PEM)都给出时启用 HTTPS */
+    std::string tlsKey;
+    int traceSample = 0;        /* 每 N 个请求记录一个 trace, 0 关闭 */
+
+    size_t cacheBytes = 64 * 1024 * 1024; /* 静态文件缓存容量 */
+    int cacheTtlMs = 1000;                /* 缓存项重新 stat 校验的间隔 */
+    int bufferSize = 1024;                /* 读写缓冲区初始大小 */
+    size_t bufferPoolMax = 1024;          /* 缓冲池最多保留的空闲缓冲区 */
+    bool fionRead = false;                /* 读之前按 FIONREAD 预留缓冲区, 每次读多一次 ioctl */
+
+    AdmissionConfig admission;
+    TimeoutConfig timeouts;
+
+    std::string configFile;     /* 为空时只使用默认值与命令行 */
+    std::vector<std::pair<std::string, std::string>> overrides; /* 命令行给出的键值, 重新加载时再次应用 */
+};
+
+/*
+ * 配置项按表驱动: 文件中每行 "key = value", # 开头为注释;
+ * 命令行 --key=value 或 --key value 覆盖文件中的值.
+ * 标记为可重载的项在 SIGHUP 时重新读取文件后立即生效, 其余的需要重启(或 SIGUSR2 升级)
+ */
+class Config
+{
+public:
+    /* -c/--config FILE 指定配置文件, -h/--help 打印所有配置项后退出, --print-config 打印生效的配置后退出 */
+    static bool Parse(int argc, char *argv[], ServerConfig &config, std::string *err);
+
+    /* 从默认值开始, 依次应用 configFile 与 overrides */
+    static bool Load(ServerConfig &config, std::string *err);
+    static bool LoadFile(const std::string &path, ServerConfig &config, std::string *err);
+
+    static bool Set(ServerConfig &config, const std::string &key, const std::string &value, std::string *err);
+    static std::string Get(const ServerConfig &config, const std::string &key);
+    static bool Reloadable(const std::string &key);
+    /* 值不能出现在日志中, 如密码 */
+    static bool Secret(const std::string &key);
+
+    /* 值不同的配置项, 按表中顺序 */
+    static std::vector<std::string> Diff(const ServerConfig &a, const ServerConfig &b);
+
+    /* 以配置文件格式输出, 可直接作为配置文件使用 */
+    static std::string Dump(const ServerConfig &config);
+    static void Usage(FILE *out, const char *prog);
+};
+
+#endif // CONFIG_H
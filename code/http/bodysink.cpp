@@ -0,0 +1,58 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "bodysink.h"
+#include <stdlib.h> // mkstemp
+#include <errno.h>
+#include <string.h>
+
+#include "../log/log.h"
+
+using namespace std;
+
+FileSink::FileSink(const char *dir) : fd(-1), size(0)
+{
+    string path = string(dir) + "/webserver-body-XXXXXX";
+    fd = mkstemp(&path[0]);
+    if (fd < 0)
+    {
+        LOG_ERROR("Create body file in %s error: %s", dir, strerror(errno));
+        return;
+    }
+    unlink(path.c_str());
+}
+
+FileSink::~FileSink()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+bool FileSink::Write(const char *data, size_t len)
+{
+    if (fd < 0)
+    {
+        return false;
+    }
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR("Write body file error: %s", strerror(errno));
+            return false;
+        }
+        data += n;
+        len -= n;
+        size += n;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef BODY_SINK_H
+#define BODY_SINK_H
+
+#include <functional>
+#include <string>
+#include <unistd.h>
+
+/* 请求体的接收端, 请求体按到达的分块交给它, 不在内存中攒成整体 */
+class BodySink
+{
+public:
+    virtual ~BodySink() = default;
+
+    /* 返回 false 中止请求 */
+    virtual bool Write(const char *data, size_t len) = 0;
+    virtual bool Finish() { return true; }
+};
+
+/* 写入临时文件, 文件创建后立即 unlink, 随对象析构自动回收 */
+class FileSink : public BodySink
+{
+public:
+    explicit FileSink(const char *dir);
+    ~FileSink() override;
+
+    bool IsOpen() const { return fd >= 0; }
+    int Fd() const { return fd; }
+    size_t Size() const { return size; }
+
+    bool Write(const char *data, size_t len) override;
+
+private:
+    int fd;
+    size_t size;
+};
+
+/* 交给回调处理, 如边收边解析或转发 */
+class CallbackSink : public BodySink
+{
+public:
+    typedef std::function<bool(const char *data, size_t len)> Callback;
+
+    explicit CallbackSink(Callback onData, std::function<bool()> onFinish = nullptr)
+        : onData(std::move(onData)), onFinish(std::move(onFinish)) {}
+
+    bool Write(const char *data, size_t len) override { return onData(data, len); }
+    bool Finish() override { return onFinish ? onFinish() : true; }
+
+private:
+    Callback onData;
+    std::function<bool()> onFinish;
+};
+
+#endif // BODY_SINK_H
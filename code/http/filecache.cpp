@@ -0,0 +1,230 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "filecache.h"
+#include <fcntl.h>    // open
+#include <unistd.h>   // close
+#include <time.h>     // clock_gettime, gmtime_r
+#include <sys/stat.h> // stat
+#include <sys/mman.h> // mmap, munmap
+#include <assert.h>
+
+#include "../log/log.h"
+
+using namespace std;
+
+FileCache::FileCache()
+{
+    maxBytes = 64 * 1024 * 1024;
+    ttlMs = 1000;
+    bytes = 0;
+}
+
+FileCache *FileCache::Instance()
+{
+    static FileCache cache;
+    return &cache;
+}
+
+void FileCache::Init(size_t maxBytes, int ttlMs)
+{
+    assert(ttlMs >= 0);
+    lock_guard<mutex> locker(mtx);
+    this->maxBytes = maxBytes;
+    this->ttlMs = ttlMs;
+    files.clear();
+    bytes = 0;
+}
+
+int64_t FileCache::NowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int FileCache::Get(const char *srcDir, const string &path, int tplCode, shared_ptr<const CachedFile> &file)
+{
+    /* 拼接用的 key 每个线程复用一份, 命中时不分配内存 */
+    static thread_local string fullPath;
+    fullPath.assign(srcDir);
+    fullPath.append(path);
+
+    int64_t now = NowMs();
+    shared_ptr<const CachedFile> cached;
+    {
+        lock_guard<mutex> locker(mtx);
+        auto it = files.find(fullPath);
+        if (it != files.end())
+        {
+            cached = it->second;
+        }
+    }
+    if (cached && now - cached->checkedAt.load(memory_order_relaxed) < ttlMs)
+    {
+        file = std::move(cached);
+        return 200;
+    }
+
+    /* 未命中或超过 TTL, 重新 stat 校验 */
+    struct stat st = {0};
+    int code = 200;
+    if (stat(fullPath.data(), &st) < 0 || S_ISDIR(st.st_mode))
+    {
+        code = 404;
+    }
+    else if (!(st.st_mode & S_IROTH))
+    {
+        code = 403;
+    }
+    if (code != 200)
+    {
+        if (cached)
+        {
+            lock_guard<mutex> locker(mtx);
+            auto it = files.find(fullPath);
+            if (it != files.end() && it->second == cached)
+            {
+                bytes -= cached->len;
+                files.erase(it);
+            }
+        }
+        file.reset();
+        return code;
+    }
+    if (cached && cached->mtime == st.st_mtime && cached->ino == st.st_ino &&
+        cached->len == static_cast<size_t>(st.st_size))
+    {
+        cached->checkedAt.store(now, memory_order_relaxed);
+        file = std::move(cached);
+        return 200;
+    }
+
+    file = Load(fullPath, st, tplCode);
+    if (!file)
+    {
+        return 404;
+    }
+    Insert(fullPath, file);
+    return 200;
+}
+
+shared_ptr<const CachedFile> FileCache::Load(const string &fullPath, const struct stat &st, int tplCode)
+{
+    auto file = make_shared<CachedFile>();
+    file->len = st.st_size;
+    file->mtime = st.st_mtime;
+    file->ino = st.st_ino;
+    file->type = FindMimeTypeByPath(fullPath.data(), fullPath.size());
+    file->code = tplCode;
+    file->checkedAt.store(NowMs(), memory_order_relaxed);
+
+    if (file->len > 0)
+    {
+        int srcFd = open(fullPath.data(), O_RDONLY);
+        if (srcFd < 0)
+        {
+            return nullptr;
+        }
+        /* 将文件映射到内存提高文件的访问速度
+            MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
+        LOG_DEBUG("file path %s", fullPath.data());
+        size_t len = file->len;
+        void *mmRet = mmap(0, len, PROT_READ, MAP_PRIVATE, srcFd, 0);
+        close(srcFd);
+        if (mmRet == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        file->data.reset(static_cast<char *>(mmRet), [len](char *ptr) { munmap(ptr, len); });
+    }
+    file->header[0] = RenderHeader(tplCode, false, file->type, file->len);
+    file->header[1] = RenderHeader(tplCode, true, file->type, file->len);
+    return file;
+}
+
+void FileCache::Insert(const string &fullPath, const shared_ptr<const CachedFile> &file)
+{
+    /* 过大的文件不进缓存, 本次请求单独持有映射 */
+    if (file->len > maxBytes / 8)
+    {
+        return;
+    }
+    lock_guard<mutex> locker(mtx);
+    auto it = files.find(fullPath);
+    if (it != files.end())
+    {
+        bytes -= it->second->len;
+        files.erase(it);
+    }
+    /* 超出容量时随意淘汰, 正在发送的映射由发送链继续持有 */
+    while (bytes + file->len > maxBytes && !files.empty())
+    {
+        bytes -= files.begin()->second->len;
+        files.erase(files.begin());
+    }
+    files.emplace(fullPath, file);
+    bytes += file->len;
+}
+
+void FileCache::Clear()
+{
+    lock_guard<mutex> locker(mtx);
+    files.clear();
+    bytes = 0;
+}
+
+size_t FileCache::Count()
+{
+    lock_guard<mutex> locker(mtx);
+    return files.size();
+}
+
+size_t FileCache::Bytes()
+{
+    lock_guard<mutex> locker(mtx);
+    return bytes;
+}
+
+string FileCache::RenderHeader(int code, bool isKeepAlive, const MimeType *type, size_t len)
+{
+    const HttpStatus *status = FindStatus(code);
+    if (!status)
+    {
+        status = FindStatus(400);
+    }
+    size_t connLen;
+    const char *conn = ConnectionHeader(isKeepAlive, &connLen);
+    char line[64];
+    int n = snprintf(line, sizeof(line), "Content-length: %zu\r\n", len);
+
+    string header;
+    header.reserve(status->lineLen + connLen + type->headerLen + n);
+    header.append(status->line, status->lineLen);
+    header.append(conn, connLen);
+    header.append(type->header, type->headerLen);
+    header.append(line, n);
+    return header;
+}
+
+shared_ptr<const string> FileCache::DateLine()
+{
+    /* 每个线程各持有一份, 秒数变化时换新对象, 旧对象由仍在发送的链持有 */
+    static thread_local time_t sec = 0;
+    static thread_local shared_ptr<const string> line;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    if (!line || ts.tv_sec != sec)
+    {
+        struct tm tm;
+        gmtime_r(&ts.tv_sec, &tm);
+        char buf[64];
+        size_t n = strftime(buf, sizeof(buf), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        line = make_shared<const string>(buf, n);
+        sec = ts.tv_sec;
+    }
+    return line;
+}
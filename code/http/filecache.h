@@ -0,0 +1,71 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <sys/types.h>
+
+#include "httptables.h"
+
+/* 缓存的静态文件: 整个文件映射 + 预渲染好的响应头 */
+struct CachedFile
+{
+    std::shared_ptr<char> data; /* 文件映射, 空文件为 nullptr */
+    size_t len;
+    time_t mtime;
+    ino_t ino;
+    const MimeType *type;
+
+    /* 模板对应的状态码, 头部为 状态行 + Connection + Content-type + Content-length,
+       不含 Date 与结尾空行. 下标 0 为 close, 1 为 keep-alive */
+    int code;
+    std::string header[2];
+
+    mutable std::atomic<int64_t> checkedAt; /* 上次 stat 校验的时间(毫秒) */
+};
+
+class FileCache
+{
+public:
+    static FileCache *Instance();
+
+    void Init(size_t maxBytes, int ttlMs);
+
+    /* 返回 200/403/404, 200 时 file 指向缓存项; tplCode 为新建缓存项时头部模板使用的状态码 */
+    int Get(const char *srcDir, const std::string &path, int tplCode, std::shared_ptr<const CachedFile> &file);
+
+    void Clear();
+    size_t Count();
+    size_t Bytes();
+
+    /* "Date: ...\r\n", 每个线程每秒最多格式化一次 */
+    static std::shared_ptr<const std::string> DateLine();
+
+    static std::string RenderHeader(int code, bool isKeepAlive, const MimeType *type, size_t len);
+
+private:
+    FileCache();
+    ~FileCache() = default;
+
+    std::shared_ptr<const CachedFile> Load(const std::string &fullPath, const struct stat &st, int tplCode);
+    void Insert(const std::string &fullPath, const std::shared_ptr<const CachedFile> &file);
+
+    static int64_t NowMs();
+
+    size_t maxBytes;
+    int ttlMs;
+    size_t bytes;
+
+    std::unordered_map<std::string, std::shared_ptr<const CachedFile>> files;
+    std::mutex mtx;
+};
+
+#endif // FILE_CACHE_H
@@ -7,14 +7,25 @@
 using namespace std;
 
 const char *HttpConn::srcDir;
+const Router *HttpConn::router = nullptr;
+const TlsContext *HttpConn::tlsCtx = nullptr;
 std::atomic<int> HttpConn::userCount;
+std::atomic<bool> HttpConn::draining(false);
 bool HttpConn::isET;
+bool HttpConn::fionRead = false;
 
 HttpConn::HttpConn()
 {
     mFd = -1;
     mAddr = {0};
     isClose = true;
+    keepAlive = false;
+    requestCount = 0;
+    reportedCount = 0;
+    busy = false;
+    starved = false;
+    phase = CP_HEADER;
+    phaseStart = 0;
 };
 
 HttpConn::~HttpConn()
@@ -28,21 +39,73 @@ void HttpConn::init(int fd, const sockaddr_in &addr)
     userCount++;
     mAddr = addr;
     mFd = fd;
-    writeBuff.RetrieveAll();
-    readBuff.RetrieveAll();
+    ReleaseBuffers(true);
+    request.Init();
+    h2.reset();
+    tls.reset(tlsCtx ? tlsCtx->NewConn(fd) : nullptr);
+    keepAlive = true;
+    requestCount = 0;
+    reportedCount = 0;
+    busy = false;
+    /* 建立后迟迟不发请求的连接按请求头超时处理 */
+    phase = CP_HEADER;
+    phaseStart = Metrics::Now();
+    trace.reset();
+    marks.reset();
     isClose = false;
+    /* 旧连接的数据源可能还持有上一个, 每个连接新建 */
+    wake = std::make_shared<StreamWake>(fd);
+    starved = false;
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd, GetIP(), GetPort(), (int)userCount);
 }
 
-void HttpConn::Close()
+bool HttpConn::Close()
 {
     response.UnmapFile();
+    response.StopStream();
+    h2.reset();
+    ReleaseBuffers(true);
+    trace.reset();
+    marks.reset();
+    if (wake)
+    {
+        wake->state.store(StreamWake::CLOSED);
+    }
     if (isClose == false)
     {
         isClose = true;
         userCount--;
+        Metrics::Add(MC_CLOSED);
+        if (tls)
+        {
+            tls->Shutdown();
+        }
         close(mFd);
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", mFd, GetIP(), GetPort(), (int)userCount);
+        tls.reset();
+        return true;
+    }
+    tls.reset();
+    return false;
+}
+
+void HttpConn::ReleaseBuffers(bool force)
+{
+    if (force)
+    {
+        writeChain.RetrieveAll();
+    }
+    if (writeChain.Empty())
+    {
+        writeChain.ShrinkToFit();
+    }
+    if (force || request.IsIdle())
+    {
+        request.Release();
+    }
+    if (readBuff && (force || readBuff->ReadableBytes() == 0))
+    {
+        BufferPool::Instance()->Release(std::move(readBuff));
     }
 }
 
@@ -69,82 +132,313 @@ int HttpConn::GetPort() const
 ssize_t HttpConn::read(int *saveErrno)
 {
     ssize_t len = -1;
+    if (!readBuff)
+    {
+        readBuff = BufferPool::Instance()->Acquire();
+    }
+    if (tls)
+    {
+        /* SSL 内部已解密的数据不会再触发 epoll, 必须读完 */
+        do
+        {
+            len = tls->Read(*readBuff, saveErrno);
+            if (len <= 0)
+            {
+                break;
+            }
+            Metrics::Add(MC_BYTES_IN, len);
+        } while ((isET && readBuff->ReadableBytes() < MAX_READ_BYTES) || tls->Pending());
+        return len;
+    }
     do
     {
-        len = readBuff.ReadFd(mFd, saveErrno);
+        len = readBuff->ReadFd(mFd, saveErrno, fionRead ? MAX_READ_BYTES : 0);
         if (len <= 0)
         {
             break;
         }
-    } while (isET);
+        Metrics::Add(MC_BYTES_IN, len);
+        /* 剩余数据留在内核中, 重新注册 EPOLLONESHOT 后会再次触发 */
+    } while (isET && readBuff->ReadableBytes() < MAX_READ_BYTES);
     return len;
 }
 
 ssize_t HttpConn::write(int *saveErrno)
 {
     ssize_t len = -1;
+    uint64_t start = Metrics::Now();
+    bool progress = false;
     do
     {
-        len = writev(mFd, iov, iovCnt);
+        if (h2)
+        {
+            h2->Pump(writeChain);
+        }
+        else if (response.IsStreaming())
+        {
+            /* 写出多少再向数据源要多少, 发送链不超过水位 */
+            response.Pump(writeChain, wake);
+        }
+        starved = writeChain.Empty() && IsStreaming();
+        len = tls ? tls->Write(writeChain, saveErrno) : writeChain.WriteFd(mFd, saveErrno);
         if (len <= 0)
         {
-            *saveErrno = errno;
             break;
         }
-        if (iov[0].iov_len + iov[1].iov_len == 0)
+        Metrics::Add(MC_BYTES_OUT, len);
+        progress = true;
+        if (trace)
+        {
+            if (trace->ts[TP_FIRST_BYTE] == 0)
+            {
+                trace->ts[TP_FIRST_BYTE] = Metrics::Now();
+            }
+            trace->bytes += len;
+        }
+    } while ((ToWriteBytes() > 0 || IsStreaming()) && (isET || ToWriteBytes() > 10240)); /* 传输结束 */
+    uint64_t end = Metrics::Now();
+    Metrics::Observe(MH_WRITE, end - start);
+    if (phase == CP_WRITE && progress)
+    {
+        /* 有进展就重新计算发送停滞 */
+        phaseStart = end;
+    }
+    if (trace && ToWriteBytes() == 0 && !IsStreaming())
+    {
+        /* 同一批排入的后续响应也算在内, 结束点是整个发送链写空 */
+        trace->ts[TP_LAST_BYTE] = end;
+        Tracer::Record(*trace);
+        trace.reset();
+    }
+    return len;
+}
+
+bool HttpConn::Park()
+{
+    if (!wake)
+    {
+        return false;
+    }
+    int expected = StreamWake::RUNNING;
+    if (wake->state.compare_exchange_strong(expected, StreamWake::PARKED))
+    {
+        return true;
+    }
+    /* 挂起之前数据源已经唤醒, 由调用者直接注册可写事件 */
+    return !(expected == StreamWake::WOKEN && wake->state.compare_exchange_strong(expected, StreamWake::RUNNING));
+}
+
+void HttpConn::EndTask()
+{
+    CONN_PHASE next;
+    if (ToWriteBytes() > 0 || IsStreaming())
+    {
+        next = CP_WRITE;
+    }
+    else if (h2 || (request.IsIdle() && (!readBuff || readBuff->ReadableBytes() == 0)))
+    {
+        next = CP_IDLE;
+    }
+    else
+    {
+        next = request.HeadersDone() ? CP_BODY : CP_HEADER;
+    }
+    /* 阶段不变时保留起点: 请求头与请求体的期限从开始接收算起, 不因零星到达的字节延长 */
+    if (next != phase)
+    {
+        phase = next;
+        phaseStart = Metrics::Now();
+    }
+    busy.store(false, std::memory_order_release);
+}
+
+bool HttpConn::process()
+{
+    if (!h2 && tls && tls->IsH2())
+    {
+        /* ALPN 已协商 h2, 不再检查序言 */
+        h2.reset(new Http2Session(srcDir, router));
+        h2->SetWake(wake);
+    }
+    else if (!h2 && requestCount == 0 && readBuff && request.IsIdle())
+    {
+        /* 明文 HTTP/2 以连接序言开头, 序言不完整时等待更多数据 */
+        size_t n = min(readBuff->ReadableBytes(), H2_PREFACE_LEN);
+        if (n > 0 && memcmp(readBuff->Peek(), H2_PREFACE, n) == 0)
+        {
+            if (n < H2_PREFACE_LEN)
+            {
+                return false;
+            }
+            h2.reset(new Http2Session(srcDir, router));
+            h2->SetWake(wake);
+        }
+    }
+    if (h2)
+    {
+        return ProcessH2();
+    }
+
+    /* 读缓冲区中所有完整的请求依次解析, 响应按顺序排入发送链, 一次 writev 发出 */
+    int queued = 0;
+    while (keepAlive && queued < MAX_PIPELINE && readBuff && readBuff->ReadableBytes() > 0)
+    {
+        uint64_t start = Metrics::Now();
+        HttpRequest::HTTP_CODE ret = request.parse(*readBuff);
+        if (ret == HttpRequest::NO_REQUEST)
         {
             break;
-        } /* 传输结束 */
-        else if (static_cast<size_t>(len) > iov[0].iov_len)
+        }
+        uint64_t parsed = Metrics::Now();
+        Metrics::Observe(MH_PARSE, parsed - start);
+        if (!trace && Tracer::Sample())
+        {
+            BeginTrace(parsed);
+        }
+        requestCount++;
+        if (ret == HttpRequest::GET_REQUEST)
         {
-            iov[1].iov_base = (uint8_t *)iov[1].iov_base + (len - iov[0].iov_len);
-            iov[1].iov_len -= (len - iov[0].iov_len);
-            if (iov[0].iov_len)
+            LOG_DEBUG("%s", request.GetPath().c_str());
+            keepAlive = request.IsKeepAlive() && requestCount < HTTP_KEEP_ALIVE_MAX &&
+                        !draining.load(std::memory_order_relaxed);
+            if (UpgradeH2())
+            {
+                /* HTTP/2 的流不单独跟踪 */
+                trace.reset();
+                request.Init();
+                return ProcessH2();
+            }
+            response.Init(srcDir, request.GetPath(), keepAlive, 200, request.GetMethodId());
+            /* 路由处理函数设置响应, 未匹配时按静态文件处理 */
+            if (router)
+            {
+                router->Dispatch(request, response);
+            }
+            else
+            {
+                Router::ServeStatic(request, response);
+            }
+            if (response.IsStreaming() && request.GetVersion() != "1.1")
             {
-                writeBuff.RetrieveAll();
-                iov[0].iov_len = 0;
+                /* HTTP/1.0 没有 chunked 编码, 流式内容以关闭连接结束 */
+                keepAlive = false;
+                response.SetKeepAlive(false);
             }
         }
         else
         {
-            iov[0].iov_base = (uint8_t *)iov[0].iov_base + len;
-            iov[0].iov_len -= len;
-            writeBuff.Retrieve(len);
+            /* 出错后无法确定下一个请求的边界, 回复错误后关闭 */
+            keepAlive = false;
+            int code = ret == HttpRequest::ENTITY_TOO_LARGE ? 413 : ret == HttpRequest::INTERNAL_ERROR ? 500 : 400;
+            response.Init(srcDir, request.GetPath(), false, code, request.GetMethodId());
         }
-    } while (isET || ToWriteBytes() > 10240);
-    return len;
+        /* 响应头与文件都挂到发送链上, 不拷贝文件内容 */
+        response.MakeResponse(writeChain);
+        uint64_t built = Metrics::Now();
+        Metrics::Observe(MH_HANDLE, built - parsed);
+        Metrics::Status(response.Code());
+        if (trace && trace->ts[TP_BUILT] == 0)
+        {
+            trace->ts[TP_BUILT] = built;
+            trace->code = response.Code();
+        }
+        request.Init();
+        queued++;
+        if (response.IsStreaming())
+        {
+            /* 流式响应结束前不排入后续响应 */
+            break;
+        }
+    }
+    if (!keepAlive && readBuff)
+    {
+        /* 最后一个响应之后的数据直接丢弃 */
+        readBuff->RetrieveAll();
+    }
+    else if (keepAlive && request.ExpectContinue())
+    {
+        /* 头部已收完, 通知客户端继续发送请求体 */
+        const HttpStatus *status = FindStatus(100);
+        writeChain.AppendStatic(status->line, status->lineLen);
+        writeChain.AppendStatic("\r\n", 2);
+    }
+    if (writeChain.Empty())
+    {
+        /* 长连接空闲等待下一个请求, 缓冲区归还给池 */
+        ReleaseBuffers();
+        return false;
+    }
+    LOG_DEBUG("pipeline %d, filesize:%d, %d  to %d", queued, response.FileLen(), (int)writeChain.SegmentCount(), ToWriteBytes());
+    return true;
 }
 
-bool HttpConn::process()
+bool HttpConn::Drain()
 {
-    request.Init();
-    if (readBuff.ReadableBytes() <= 0)
+    if (!h2)
     {
         return false;
     }
-    else if (request.parse(readBuff))
+    h2->Drain(writeChain);
+    keepAlive = !h2->IsClosing();
+    /* 还有流在等窗口时保持连接, 流结束后 Pump 写出 GOAWAY */
+    return !writeChain.Empty() || h2->StreamCount() > 0;
+}
+
+void HttpConn::BeginTrace(uint64_t parsed)
+{
+    trace.reset(new TraceSpan());
+    if (marks)
     {
-        LOG_DEBUG("%s", request.GetPath().c_str());
-        response.Init(srcDir, request.GetPath(), request.IsKeepAlive(), 200);
+        /* 同一次任务解析出的后续请求没有自己的分发时间点 */
+        memcpy(trace->ts, marks.get(), TP_PARSED * sizeof(uint64_t));
+        memset(marks.get(), 0, TP_PARSED * sizeof(uint64_t));
     }
-    else
+    trace->ts[TP_PARSED] = parsed;
+    trace->fd = mFd;
+    trace->method = MethodName(request.GetMethodId());
+    snprintf(trace->path, sizeof(trace->path), "%s", request.GetPath().c_str());
+}
+
+bool HttpConn::UpgradeH2()
+{
+    StrRef upgrade = request.GetHeader(HDR_UPGRADE);
+    StrRef settings = request.GetHeader(HDR_HTTP2_SETTINGS);
+    if (upgrade.len != 3 || strncasecmp(upgrade.data, "h2c", 3) != 0 || settings.empty())
     {
-        response.Init(srcDir, request.GetPath(), false, 400);
+        return false;
     }
+    unique_ptr<Http2Session> session(new Http2Session(srcDir, router));
+    session->SetWake(wake);
+    if (!session->Upgrade(settings))
+    {
+        /* 设置无法解析时按 HTTP/1.1 回复 */
+        return false;
+    }
+    LOG_DEBUG("Client[%d] upgrade to h2c", mFd);
+    writeChain.AppendStatic("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    h2 = std::move(session);
+    h2->UpgradeResponse(request, writeChain);
+    keepAlive = true;
+    return true;
+}
 
-    response.MakeResponse(writeBuff);
-    /* 响应头 */
-    iov[0].iov_base = const_cast<char *>(writeBuff.Peek());
-    iov[0].iov_len = writeBuff.ReadableBytes();
-    iovCnt = 1;
-
-    /* 文件 */
-    if (response.FileLen() > 0 && response.File())
+bool HttpConn::ProcessH2()
+{
+    /* 不完整的帧留在读缓冲区, 各流的 DATA 帧按窗口交错排入发送链 */
+    if (readBuff && readBuff->ReadableBytes() > 0)
+    {
+        h2->Process(*readBuff, writeChain);
+    }
+    if (draining.load(std::memory_order_relaxed))
     {
-        iov[1].iov_base = response.File();
-        iov[1].iov_len = response.FileLen();
-        iovCnt = 2;
+        h2->Drain(writeChain);
+    }
+    h2->Pump(writeChain);
+    keepAlive = !h2->IsClosing();
+    if (writeChain.Empty())
+    {
+        ReleaseBuffers();
+        return false;
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", response.FileLen(), iovCnt, ToWriteBytes());
     return true;
 }
@@ -12,12 +12,29 @@
 #include <arpa/inet.h> // sockaddr_in
 #include <stdlib.h>    // atoi()
 #include <errno.h>
+#include <atomic>
 
 #include "../log/log.h"
-#include "../pool/sqlconnRAII.h"
 #include "../buffer/buffer.h"
+#include "../buffer/bufferchain.h"
+#include "../buffer/bufferpool.h"
 #include "httprequest.h"
 #include "httpresponse.h"
+#include "router.h"
+#include "../http2/http2session.h"
+#include "../tls/tlscontext.h"
+#include "../metrics/metrics.h"
+#include "../metrics/tracer.h"
+
+/* 连接当前在等什么, 决定适用哪个超时; 顺序与 MC_TIMEOUT_* 计数器一致 */
+enum CONN_PHASE
+{
+    CP_HEADER = 0, /* 新连接或请求头未收完 */
+    CP_BODY,       /* 请求头已收完, 请求体未收完 */
+    CP_IDLE,       /* 长连接等待下一个请求 */
+    CP_WRITE,      /* 响应未发完, 等待套接字可写 */
+    CONN_PHASE_COUNT
+};
 
 class HttpConn
 {
@@ -32,7 +49,8 @@ public:
 
     ssize_t write(int *saveErrno);
 
-    void Close();
+    /* 返回本次调用是否真正关闭了连接 */
+    bool Close();
 
     int GetFd() const;
 
@@ -46,32 +64,114 @@ public:
 
     int ToWriteBytes()
     {
-        return iov[0].iov_len + iov[1].iov_len;
+        return writeChain.ReadableBytes();
+    }
+
+    /* 流式响应尚未结束, 发送链写空也不能开始下一个请求; HTTP/2 下为还有可发送的 DATA */
+    bool IsStreaming() const
+    {
+        return h2 ? h2->WantWrite() : response.IsStreaming();
+    }
+
+    /* 上次 write 时流式数据源没有给出内容, 发送链已写空 */
+    bool Starved() const { return starved; }
+    /*
+     * 工作线程在 EndTask 之后调用: 挂起连接, 等数据源唤醒; 返回 false 表示挂起前已被唤醒, 应注册可写事件.
+     * 已挂起或已关闭时返回 true
+     */
+    bool Park();
+    const StreamWakeRef &Wake() const { return wake; }
+    /* 已挂起或已唤醒但主线程还未重新注册 */
+    bool Parked() const
+    {
+        int state = wake ? wake->state.load() : StreamWake::RUNNING;
+        return state == StreamWake::PARKED || state == StreamWake::WOKEN;
+    }
+    bool IsH2() const { return h2 != nullptr; }
+
+    /* 主线程分发与任务开始的时间点, 采样到的请求从这里取前三个阶段 */
+    void Mark(TRACE_PHASE phase, uint64_t ts)
+    {
+        assert(phase < TP_PARSED);
+        if (!marks)
+        {
+            marks.reset(new uint64_t[TP_PARSED]());
+        }
+        marks[phase] = ts;
+    }
+
+    /* 上次调用以来新处理的请求数, 主线程按此扣除单 IP 请求配额 */
+    int TakeNewRequests()
+    {
+        int n = requestCount - reportedCount;
+        reportedCount = requestCount;
+        return n;
     }
 
+    /* 优雅退出时对空闲连接调用, 返回 false 表示可以直接关闭; HTTP/2 写出 GOAWAY 或还有未结束的流时返回 true */
+    bool Drain();
+
+    /* 主线程分发任务前置位, 工作线程在 EndTask 中清除; 置位期间阶段信息不可读 */
+    void SetBusy() { busy.store(true, std::memory_order_relaxed); }
+    bool IsBusy() const { return busy.load(std::memory_order_acquire); }
+    /* 工作线程重新注册事件之前调用: 按读写缓冲区与解析状态确定阶段 */
+    void EndTask();
+
+    bool IsClosed() const { return isClose; }
+    CONN_PHASE Phase() const { return phase; }
+    /* 进入当前阶段的时间; 发送阶段为最近一次写出数据的时间 */
+    uint64_t PhaseStart() const { return phaseStart; }
+    size_t BodyReceived() const { return request.BodyLen(); }
+
+    /* 已排入发送链的响应发完后是否继续保持连接 */
     bool IsKeepAlive() const
     {
-        return request.IsKeepAlive();
+        return keepAlive;
     }
 
     static bool isET;
+    static bool fionRead;
     static const char *srcDir;
+    static const Router *router;
+    static const TlsContext *tlsCtx; /* 非空时所有连接走 TLS */
     static std::atomic<int> userCount;
+    static std::atomic<bool> draining; /* 服务器正在退出, 之后的响应都带 Connection: close */
 
 private:
     int mFd;
     struct sockaddr_in mAddr;
 
+    void ReleaseBuffers(bool force = false);
+    bool UpgradeH2();
+    bool ProcessH2();
+    void BeginTrace(uint64_t parsed);
+
     bool isClose;
+    bool keepAlive;
+    int requestCount; /* 本连接已处理的请求数, 达到 HTTP_KEEP_ALIVE_MAX 后关闭 */
+    int reportedCount; /* TakeNewRequests 已取走的部分 */
 
-    int iovCnt;
-    struct iovec iov[2];
+    static const int MAX_PIPELINE = 32; /* 一次 process 最多排入的响应数 */
+    static const size_t MAX_READ_BYTES = 256 * 1024; /* 一次 read 最多攒下的字节数, 大请求体分批处理 */
 
-    Buffer readBuff;  // 读缓冲区
-    Buffer writeBuff; // 写缓冲区
+    std::unique_ptr<Buffer> readBuff; // 读缓冲区, 有数据时才从 BufferPool 借出
+    BufferChain writeChain;           // 写链: 响应头片段 + 文件映射, 一次 writev 发出
 
     HttpRequest request;
     HttpResponse response;
+    std::unique_ptr<Http2Session> h2; // 收到连接序言, Upgrade: h2c 或 ALPN 协商为 h2 后创建
+    std::unique_ptr<TlsConn> tls;
+    StreamWakeRef wake;   /* 只在 init 中替换, 主线程可直接读取 */
+    bool starved;
+
+    std::atomic<bool> busy;
+    CONN_PHASE phase;
+    uint64_t phaseStart; /* Metrics::Now() */
+
+    /* 采样到请求时才分配, 发送链写空时提交; 一次只跟踪一个请求 */
+    std::unique_ptr<TraceSpan> trace;
+    /* 最近一次任务的 wake/enqueue/start, 开启采样后第一次 Mark 时分配 */
+    std::unique_ptr<uint64_t[]> marks;
 };
 
 #endif // HTTP_CONN_H
\ No newline at end of file
@@ -6,108 +6,209 @@
 #include "httprequest.h"
 using namespace std;
 
-const unordered_set<string> HttpRequest::DEFAULT_HTML{
-    "/index",
-    "/register",
-    "/login",
-    "/welcome",
-    "/video",
-    "/picture",
-};
-
-const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG{
-    {"/register.html", 0},
-    {"/login.html", 1},
-};
+size_t HttpRequest::maxBodySize = 8 * 1024 * 1024;
+size_t HttpRequest::memBodySize = 64 * 1024;
+const char *HttpRequest::spoolDir = "/tmp";
 
 void HttpRequest::Init()
 {
-    method = path = version = body = "";
+    /* 上一个请求的所有解析结果都在 Arena 上, O(1) 整体回收 */
+    arena.Reset();
+    path.clear();
+    method = version = body = StrRef();
+    methodId = METHOD_UNKNOWN;
+    bodyMode = BODY_NONE;
+    chunkState = CHUNK_SIZE;
+    continueSent = false;
+    contentLen = bodyLen = bodyCap = 0;
+    lineScanned = 0;
+    bodyBuf = nullptr;
+    sink.reset();
+    knownHeader = nullptr;
+    header = post = params = {nullptr, 0, 0};
     state = REQUEST_LINE;
-    header.clear();
-    post.clear();
 }
 
-bool HttpRequest::IsKeepAlive() const
+void HttpRequest::Release()
+{
+    Init();
+    arena.Release();
+}
+
+bool HttpRequest::HasToken(StrRef value, const char *token)
 {
-    if (header.count("Connection") == 1)
+    /* 逗号分隔的 token 列表, 不区分大小写 */
+    size_t len = strlen(token);
+    const char *p = value.data, *end = value.data + value.len;
+    while (p < end)
     {
-        return header.find("Connection")->second == "keep-alive" && version == "1.1";
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+        {
+            p++;
+        }
+        const char *q = p;
+        while (q < end && *q != ',')
+        {
+            q++;
+        }
+        const char *e = q;
+        while (e > p && (e[-1] == ' ' || e[-1] == '\t'))
+        {
+            e--;
+        }
+        if (static_cast<size_t>(e - p) == len && strncasecmp(p, token, len) == 0)
+        {
+            return true;
+        }
+        p = q;
     }
     return false;
 }
 
-bool HttpRequest::parse(Buffer &buff)
+bool HttpRequest::IsKeepAlive() const
 {
-    const char CRLF[] = "\r\n";
-    if (buff.ReadableBytes() <= 0)
+    /* HTTP/1.1 默认长连接, 除非 Connection: close; HTTP/1.0 需显式 keep-alive */
+    StrRef conn = GetHeader(HDR_CONNECTION);
+    if (version == "1.1")
     {
-        return false;
+        return !HasToken(conn, "close");
     }
-    while (buff.ReadableBytes() && state != FINISH)
+    return HasToken(conn, "keep-alive");
+}
+
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer &buff)
+{
+    const char CRLF[] = "\r\n";
+    while (state != FINISH)
     {
-        const char *lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        std::string line(buff.Peek(), lineEnd);
+        if (state == BODY)
+        {
+            HTTP_CODE ret = ParseBody(buff);
+            if (ret != GET_REQUEST)
+            {
+                return ret;
+            }
+            break;
+        }
+        /* 不完整的行下次从上次查找的位置继续, 逐字节到达的请求头不会被反复扫描 */
+        size_t scanned = min(lineScanned, buff.ReadableBytes());
+        const char *lineEnd = search(buff.Peek() + scanned, buff.BeginWriteConst(), CRLF, CRLF + 2);
+        if (lineEnd == buff.BeginWriteConst())
+        {
+            /* 行不完整, 等待更多数据; 末尾的 \r 可能与下一个 \n 组成行尾 */
+            if (buff.ReadableBytes() > MAX_LINE)
+            {
+                LOG_ERROR("Line too long!");
+                return BAD_REQUEST;
+            }
+            lineScanned = buff.ReadableBytes() > 0 ? buff.ReadableBytes() - 1 : 0;
+            return NO_REQUEST;
+        }
+        lineScanned = 0;
         switch (state)
         {
         case REQUEST_LINE:
-            if (!ParseRequestLine(line))
+            /* 请求之间多余的空行忽略 */
+            if (lineEnd != buff.Peek())
             {
-                return false;
+                if (!ParseRequestLine(buff.Peek(), lineEnd))
+                {
+                    return BAD_REQUEST;
+                }
             }
-            ParsePath();
             break;
         case HEADERS:
-            ParseHeader(line);
-            if (buff.ReadableBytes() <= 2)
+            if (!ParseHeader(buff.Peek(), lineEnd))
             {
-                state = FINISH;
+                return BAD_REQUEST;
+            }
+            if (state != HEADERS)
+            {
+                HTTP_CODE ret = ParseHeaderEnd();
+                if (ret != GET_REQUEST)
+                {
+                    return ret;
+                }
             }
-            break;
-        case BODY:
-            ParseBody(line);
             break;
         default:
             break;
         }
-        if (lineEnd == buff.BeginWrite())
-        {
-            break;
-        }
         buff.RetrieveUntil(lineEnd + 2);
     }
-    LOG_DEBUG("[%s], [%s], [%s]", method.c_str(), path.c_str(), version.c_str());
-    return true;
+    LOG_DEBUG("[%s], [%s], [%s]", method.data, path.c_str(), version.data);
+    return GET_REQUEST;
 }
 
-void HttpRequest::ParsePath()
+HttpRequest::HTTP_CODE HttpRequest::ParseHeaderEnd()
 {
-    if (path == "/")
+    /* 头部结束, 按 Transfer-Encoding / Content-Length 决定请求体边界 */
+    StrRef te = GetHeader(HDR_TRANSFER_ENCODING);
+    StrRef len = GetHeader(HDR_CONTENT_LENGTH);
+    if (!te.empty())
     {
-        path = "/index.html";
+        /* 两者同时出现可被用来走私请求, 直接拒绝 */
+        if (!HasToken(te, "chunked") || !len.empty())
+        {
+            LOG_ERROR("Transfer-Encoding Error: %s", te.data);
+            return BAD_REQUEST;
+        }
+        bodyMode = BODY_CHUNKED;
     }
-    else
+    else if (!len.empty())
     {
-        for (auto &item : DEFAULT_HTML)
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long n = strtoull(len.data, &end, 10);
+        if (errno || end != len.data + len.len || !isdigit(static_cast<unsigned char>(len.data[0])))
         {
-            if (item == path)
-            {
-                path += ".html";
-                break;
-            }
+            LOG_ERROR("Content-Length Error: %s", len.data);
+            return BAD_REQUEST;
+        }
+        if (n > maxBodySize)
+        {
+            LOG_WARN("Body too large: %llu", n);
+            return ENTITY_TOO_LARGE;
         }
+        contentLen = n;
+        bodyMode = n > 0 ? BODY_LENGTH : BODY_NONE;
+    }
+    if (bodyMode == BODY_NONE)
+    {
+        return FinishBody();
+    }
+    state = BODY;
+    return GET_REQUEST;
+}
+
+bool HttpRequest::ExpectContinue()
+{
+    if (state != BODY || continueSent || bodyLen > 0)
+    {
+        return false;
     }
+    continueSent = HasToken(GetHeader(HDR_EXPECT), "100-continue");
+    return continueSent;
+}
+
+void HttpRequest::SetBodySink(unique_ptr<BodySink> sink)
+{
+    assert(HeadersDone() && bodyLen == 0);
+    this->sink = std::move(sink);
 }
 
-bool HttpRequest::ParseRequestLine(const string &line)
+bool HttpRequest::ParseRequestLine(const char *begin, const char *end)
 {
-    regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, patten))
+    /* METHOD SP PATH SP HTTP/VERSION, 各部分不含空格 */
+    const char *sp1 = find(begin, end, ' ');
+    const char *sp2 = sp1 == end ? end : find(sp1 + 1, end, ' ');
+    if (sp2 != end && find(sp2 + 1, end, ' ') == end &&
+        end - sp2 > 5 && memcmp(sp2 + 1, "HTTP/", 5) == 0)
     {
-        method = subMatch[1];
-        path = subMatch[2];
-        version = subMatch[3];
+        method = StrRef(arena.Dup(begin, sp1 - begin), sp1 - begin);
+        methodId = FindMethod(method.data, method.len);
+        path.assign(sp1 + 1, sp2);
+        version = StrRef(arena.Dup(sp2 + 6, end - sp2 - 6), end - sp2 - 6);
         state = HEADERS;
         return true;
     }
@@ -115,185 +216,346 @@ bool HttpRequest::ParseRequestLine(const string &line)
     return false;
 }
 
-void HttpRequest::ParseHeader(const string &line)
+bool HttpRequest::ParseHeader(const char *begin, const char *end)
 {
-    regex patten("^([^:]*): ?(.*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, patten))
+    if (begin == end)
     {
-        header[subMatch[1]] = subMatch[2];
+        /* 空行结束头部 */
+        state = BODY;
+        return true;
     }
-    else
+    const char *colon = find(begin, end, ':');
+    if (colon == end)
     {
-        state = BODY;
+        LOG_ERROR("Header without colon");
+        return false;
+    }
+    const char *value = colon + 1;
+    if (value < end && *value == ' ')
+    {
+        value++;
+    }
+    StrRef val(arena.Dup(value, end - value), end - value);
+    HEADER_ID id = FindHeaderId(begin, colon - begin);
+    if (id == HDR_UNKNOWN)
+    {
+        AddField(header, StrRef(arena.Dup(begin, colon - begin), colon - begin), val);
+        return true;
+    }
+    if (!knownHeader)
+    {
+        knownHeader = static_cast<StrRef *>(arena.Alloc(sizeof(StrRef) * HDR_COUNT, alignof(StrRef)));
+        fill(knownHeader, knownHeader + HDR_COUNT, StrRef());
+    }
+    if (!CheckDuplicate(id, knownHeader[id], val))
+    {
+        return false;
     }
+    knownHeader[id] = val;
+    return true;
 }
 
-void HttpRequest::ParseBody(const string &line)
+bool HttpRequest::CheckDuplicate(HEADER_ID id, const StrRef &old, const StrRef &val)
 {
-    body = line;
-    ParsePost();
-    state = FINISH;
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    /* 决定请求边界与目标主机的头部不能有歧义, 否则前后两级代理可能各取一个值(请求走私); 其余头部后者覆盖前者 */
+    switch (id)
+    {
+    case HDR_CONTENT_LENGTH:
+    case HDR_TRANSFER_ENCODING:
+        if (val.empty())
+        {
+            LOG_ERROR("Empty %s", id == HDR_CONTENT_LENGTH ? "Content-Length" : "Transfer-Encoding");
+            return false;
+        }
+        /* 相同的 Content-Length 重复出现是允许的 */
+        if (!old.empty() && (id == HDR_TRANSFER_ENCODING || !(old == val)))
+        {
+            LOG_ERROR("Conflicting %s", id == HDR_CONTENT_LENGTH ? "Content-Length" : "Transfer-Encoding");
+            return false;
+        }
+        return true;
+    case HDR_HOST:
+        if (!old.empty())
+        {
+            LOG_ERROR("Duplicate Host");
+            return false;
+        }
+        return true;
+    default:
+        return true;
+    }
 }
 
-int HttpRequest::ConverHex(char ch)
+HttpRequest::HTTP_CODE HttpRequest::ParseBody(Buffer &buff)
 {
-    if (ch >= 'A' && ch <= 'F')
-        return ch - 'A' + 10;
-    if (ch >= 'a' && ch <= 'f')
-        return ch - 'a' + 10;
-    return ch;
+    if (bodyMode == BODY_CHUNKED)
+    {
+        return ParseChunked(buff);
+    }
+    /* 请求体到多少消费多少, 读缓冲区不必攒下整个请求体 */
+    size_t n = min(buff.ReadableBytes(), contentLen - bodyLen);
+    if (!AppendBody(buff.Peek(), n))
+    {
+        return INTERNAL_ERROR;
+    }
+    buff.Retrieve(n);
+    return bodyLen < contentLen ? NO_REQUEST : FinishBody();
 }
 
-void HttpRequest::ParsePost()
+HttpRequest::HTTP_CODE HttpRequest::ParseChunked(Buffer &buff)
 {
-    if (method == "POST" && header["Content-Type"] == "application/x-www-form-urlencoded")
+    const char CRLF[] = "\r\n";
+    while (true)
     {
-        ParseFromUrlencoded();
-        if (DEFAULT_HTML_TAG.count(path))
+        const char *lineEnd = nullptr;
+        if (chunkState == CHUNK_SIZE || chunkState == CHUNK_TRAILER)
         {
-            int tag = DEFAULT_HTML_TAG.find(path)->second;
-            LOG_DEBUG("Tag:%d", tag);
-            if (tag == 0 || tag == 1)
+            lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+            if (lineEnd == buff.BeginWriteConst())
             {
-                bool isLogin = (tag == 1);
-                if (UserVerify(post["username"], post["password"], isLogin))
-                {
-                    path = "/welcome.html";
-                }
-                else
+                return buff.ReadableBytes() > MAX_LINE ? BAD_REQUEST : NO_REQUEST;
+            }
+        }
+        switch (chunkState)
+        {
+        case CHUNK_SIZE:
+        {
+            /* 十六进制长度, 忽略 ;ext */
+            const char *p = buff.Peek();
+            size_t size = 0;
+            int digits = 0;
+            for (; p < lineEnd && isxdigit(static_cast<unsigned char>(*p)); p++, digits++)
+            {
+                size = size * 16 + ConverHex(*p);
+                if (digits >= 15)
                 {
-                    path = "/error.html";
+                    return BAD_REQUEST;
                 }
             }
+            if (digits == 0 || (p < lineEnd && *p != ';' && *p != ' ' && *p != '\t'))
+            {
+                LOG_ERROR("Chunk size Error");
+                return BAD_REQUEST;
+            }
+            if (bodyLen + size > maxBodySize)
+            {
+                LOG_WARN("Body too large: %zu", bodyLen + size);
+                return ENTITY_TOO_LARGE;
+            }
+            buff.RetrieveUntil(lineEnd + 2);
+            contentLen = size;
+            chunkState = size ? CHUNK_DATA : CHUNK_TRAILER;
+            break;
+        }
+        case CHUNK_DATA:
+        {
+            size_t n = min(buff.ReadableBytes(), contentLen);
+            if (!AppendBody(buff.Peek(), n))
+            {
+                return INTERNAL_ERROR;
+            }
+            buff.Retrieve(n);
+            contentLen -= n;
+            if (contentLen > 0)
+            {
+                return NO_REQUEST;
+            }
+            chunkState = CHUNK_DATA_CRLF;
+            break;
+        }
+        case CHUNK_DATA_CRLF:
+            if (buff.ReadableBytes() < 2)
+            {
+                return NO_REQUEST;
+            }
+            if (memcmp(buff.Peek(), CRLF, 2) != 0)
+            {
+                LOG_ERROR("Chunk data Error");
+                return BAD_REQUEST;
+            }
+            buff.Retrieve(2);
+            chunkState = CHUNK_SIZE;
+            break;
+        case CHUNK_TRAILER:
+        {
+            /* 尾部字段直接丢弃, 空行结束 */
+            bool last = (lineEnd == buff.Peek());
+            buff.RetrieveUntil(lineEnd + 2);
+            if (last)
+            {
+                return FinishBody();
+            }
+            break;
+        }
         }
     }
 }
 
-void HttpRequest::ParseFromUrlencoded()
+bool HttpRequest::AppendBody(const char *data, size_t len)
 {
-    if (body.size() == 0)
+    if (len == 0)
     {
-        return;
+        return true;
     }
+    /* 声明的长度已超过内存上限时从第一个字节起就写文件, 不按声明长度分配内存 */
+    if (!sink && (bodyLen + len > memBodySize || (bodyMode == BODY_LENGTH && contentLen > memBodySize)))
+    {
+        /* 超过内存上限, 已收到的部分一起转存到临时文件 */
+        unique_ptr<FileSink> file(new FileSink(spoolDir));
+        if (!file->IsOpen() || !file->Write(bodyBuf, bodyLen))
+        {
+            return false;
+        }
+        sink = std::move(file);
+    }
+    if (sink)
+    {
+        bodyLen += len;
+        return sink->Write(data, len);
+    }
+    if (bodyLen + len + 1 > bodyCap)
+    {
+        /* 已知长度一次分配到位, chunked 按倍数增长 */
+        size_t cap = bodyMode == BODY_LENGTH ? contentLen + 1 : max(bodyCap * 2, static_cast<size_t>(1024));
+        cap = max(cap, bodyLen + len + 1);
+        char *buf = static_cast<char *>(arena.Alloc(cap, 1));
+        if (bodyLen)
+        {
+            memcpy(buf, bodyBuf, bodyLen);
+        }
+        bodyBuf = buf;
+        bodyCap = cap;
+    }
+    memcpy(bodyBuf + bodyLen, data, len);
+    bodyLen += len;
+    bodyBuf[bodyLen] = '\0';
+    return true;
+}
 
-    string key, value;
-    int num = 0;
-    int n = body.size();
-    int i = 0, j = 0;
-
-    for (; i < n; i++)
+HttpRequest::HTTP_CODE HttpRequest::FinishBody()
+{
+    if (sink)
     {
-        char ch = body[i];
-        switch (ch)
+        if (!sink->Finish())
         {
-        case '=':
-            key = body.substr(j, i - j);
-            j = i + 1;
-            break;
-        case '+':
-            body[i] = ' ';
-            break;
-        case '%':
-            num = ConverHex(body[i + 1]) * 16 + ConverHex(body[i + 2]);
-            body[i + 2] = num % 10 + '0';
-            body[i + 1] = num / 10 + '0';
-            i += 2;
-            break;
-        case '&':
-            value = body.substr(j, i - j);
-            j = i + 1;
-            post[key] = value;
-            LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
-            break;
-        default:
-            break;
+            return INTERNAL_ERROR;
         }
+        LOG_DEBUG("Body to sink, len:%zu", bodyLen);
     }
-    assert(j <= i);
-    if (post.count(key) == 0 && j < i)
+    else
     {
-        value = body.substr(j, i - j);
-        post[key] = value;
+        body = bodyBuf ? StrRef(bodyBuf, bodyLen) : StrRef();
+        ParsePost();
+        LOG_DEBUG("Body len:%zu", body.len);
     }
+    state = FINISH;
+    return GET_REQUEST;
 }
 
-bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin)
+void HttpRequest::AddField(FieldList &list, StrRef key, StrRef value)
 {
-    if (name == "" || pwd == "")
+    if (list.cnt == list.cap)
     {
-        return false;
+        size_t cap = list.cap ? list.cap * 2 : 16;
+        Field *items = static_cast<Field *>(arena.Alloc(cap * sizeof(Field), alignof(Field)));
+        copy(list.items, list.items + list.cnt, items);
+        list.items = items;
+        list.cap = cap;
+    }
+    /* 同名字段后者覆盖前者 */
+    for (size_t i = 0; i < list.cnt; i++)
+    {
+        if (list.items[i].key == key)
+        {
+            list.items[i].value = value;
+            return;
+        }
     }
-    LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-    MYSQL *sql;
-    SqlConnRAII(&sql, SqlConnPool::Instance());
-    assert(sql);
+    list.items[list.cnt++] = {key, value};
+}
 
-    bool flag = false;
-    char order[256] = {0};
-    MYSQL_RES *res = nullptr;
+const HttpRequest::Field *HttpRequest::FindField(const FieldList &list, const char *key, size_t len)
+{
+    for (size_t i = 0; i < list.cnt; i++)
+    {
+        if (list.items[i].key == StrRef(key, len))
+        {
+            return &list.items[i];
+        }
+    }
+    return nullptr;
+}
+
+int HttpRequest::ConverHex(char ch)
+{
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    return 0;
+}
 
-    if (!isLogin)
+void HttpRequest::ParsePost()
+{
+    /* 表单在解析阶段解码, 登录注册等业务由路由处理 */
+    if (methodId == METHOD_POST && GetHeader(HDR_CONTENT_TYPE) == "application/x-www-form-urlencoded")
     {
-        flag = true;
+        ParseFromUrlencoded();
     }
-    /* 查询用户及密码 */
-    snprintf(order, 256, "SELECT username, passwd FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    LOG_DEBUG("%s", order);
+}
 
-    if (mysql_query(sql, order))
+void HttpRequest::ParseFromUrlencoded()
+{
+    if (body.len == 0)
     {
-        LOG_ERROR("MySQL-ERROR: %s", mysql_error(sql));
-        mysql_free_result(res);
-        return false;
+        return;
     }
-    res = mysql_store_result(sql);
-    // unsigned int j = mysql_num_fields(res);
-    // MYSQL_FIELD *fields = mysql_fetch_fields(res);
 
-    while (MYSQL_ROW row = mysql_fetch_row(res))
+    /* 在 Arena 中的 body 副本上原地解码, key/value 直接指向解码结果 */
+    char *str = const_cast<char *>(body.data);
+    size_t n = body.len;
+    size_t i = 0, j = 0, out = 0;
+    StrRef key;
+
+    for (; i < n; i++)
     {
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        string password(row[1]);
-        /* 注册行为 且 用户名未被使用*/
-        if (isLogin)
+        char ch = str[i];
+        switch (ch)
         {
-            if (pwd == password)
-            {
-                flag = true;
-            }
-            else
+        case '=':
+            key = StrRef(str + j, out - j);
+            str[out++] = '\0';
+            j = out;
+            break;
+        case '+':
+            str[out++] = ' ';
+            break;
+        case '%':
+            if (i + 2 < n)
             {
-                flag = false;
-                LOG_DEBUG("pwd error!");
+                str[out++] = static_cast<char>(ConverHex(str[i + 1]) * 16 + ConverHex(str[i + 2]));
+                i += 2;
             }
-        }
-        else
-        {
-            flag = false;
-            LOG_DEBUG("user used!");
+            break;
+        case '&':
+            AddField(post, key, StrRef(str + j, out - j));
+            str[out++] = '\0';
+            j = out;
+            LOG_DEBUG("%s = %s", key.data, post.items[post.cnt - 1].value.data);
+            break;
+        default:
+            str[out++] = ch;
+            break;
         }
     }
-    mysql_free_result(res);
-
-    /* 注册行为 且 用户名未被使用*/
-    if (!isLogin && flag == true)
+    assert(j <= out);
+    if (!FindField(post, key.data, key.len) && j < out)
     {
-        LOG_DEBUG("regirster!");
-        bzero(order, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG("%s", order);
-        if (mysql_query(sql, order))
-        {
-            LOG_DEBUG("Insert error!");
-            flag = false;
-        }
-        flag = true;
+        AddField(post, key, StrRef(str + j, out - j));
+        str[out] = '\0';
     }
-    SqlConnPool::Instance()->FreeConn(sql);
-    LOG_DEBUG("UserVerify success!!");
-    return flag;
 }
 
 std::string HttpRequest::GetPath() const
@@ -307,30 +569,57 @@ std::string &HttpRequest::GetPath()
 }
 std::string HttpRequest::GetMethod() const
 {
-    return method;
+    return method.str();
 }
 
 std::string HttpRequest::GetVersion() const
 {
-    return version;
+    return version.str();
 }
 
 std::string HttpRequest::GetPost(const std::string &key) const
 {
     assert(key != "");
-    if (post.count(key) == 1)
-    {
-        return post.find(key)->second;
-    }
-    return "";
+    const Field *field = FindField(post, key.data(), key.size());
+    return field ? field->value.str() : "";
 }
 
 std::string HttpRequest::GetPost(const char *key) const
 {
     assert(key != nullptr);
-    if (post.count(key) == 1)
+    const Field *field = FindField(post, key, strlen(key));
+    return field ? field->value.str() : "";
+}
+
+StrRef HttpRequest::GetHeader(HEADER_ID id) const
+{
+    if (!knownHeader || id >= HDR_COUNT)
     {
-        return post.find(key)->second;
+        return StrRef();
     }
-    return "";
-}
\ No newline at end of file
+    return knownHeader[id];
+}
+
+StrRef HttpRequest::GetHeader(const char *key) const
+{
+    size_t len = strlen(key);
+    HEADER_ID id = FindHeaderId(key, len);
+    if (id != HDR_UNKNOWN)
+    {
+        return GetHeader(id);
+    }
+    const Field *field = FindField(header, key, len);
+    return field ? field->value : StrRef();
+}
+
+void HttpRequest::SetParam(StrRef key, StrRef value)
+{
+    /* 值拷贝到 Arena, 处理函数修改 path 后仍然有效 */
+    AddField(params, key, StrRef(arena.Dup(value.data, value.len), value.len));
+}
+
+StrRef HttpRequest::GetParam(const char *key) const
+{
+    const Field *field = FindField(params, key, strlen(key));
+    return field ? field->value : StrRef();
+}
@@ -6,17 +6,18 @@
 #ifndef HTTP_REQUEST_H
 #define HTTP_REQUEST_H
 
-#include <unordered_map>
-#include <unordered_set>
 #include <string>
-#include <regex>
+#include <algorithm>
+#include <memory>
 #include <errno.h>
-#include <mysql/mysql.h> //mysql
+#include <ctype.h>   // isdigit
+#include <strings.h> // strncasecmp
 
 #include "../buffer/buffer.h"
+#include "../buffer/arena.h"
+#include "httptables.h"
 #include "../log/log.h"
-#include "../pool/sqlconnpool.h"
-#include "../pool/sqlconnRAII.h"
+#include "bodysink.h"
 
 class HttpRequest
 {
@@ -39,23 +40,53 @@ public:
         FILE_REQUEST,
         INTERNAL_ERROR,
         CLOSED_CONNECTION,
+        ENTITY_TOO_LARGE,
     };
 
     HttpRequest() { Init(); }
     ~HttpRequest() = default;
 
     void Init();
-    bool parse(Buffer &buff);
+
+    /* 增量解析: 完整请求返回 GET_REQUEST, 数据不足返回 NO_REQUEST, 格式错误返回 BAD_REQUEST */
+    HTTP_CODE parse(Buffer &buff);
+
+    /* 尚未开始解析下一个请求 */
+    bool IsIdle() const { return state == REQUEST_LINE; }
+    bool HeadersDone() const { return state == BODY || state == FINISH; }
+
+    /* 头部已收完, 客户端在等 100 Continue; 每个请求只返回一次 true */
+    bool ExpectContinue();
+
+    /* 头部收完后可指定请求体的接收端, 否则小请求体留在内存, 超过 memBodySize 转存临时文件 */
+    void SetBodySink(std::unique_ptr<BodySink> sink);
+    BodySink *GetBodySink() const { return sink.get(); }
+    StrRef GetBody() const { return body; }
+    size_t BodyLen() const { return bodyLen; }
+
+    /* 连接空闲时归还 Arena 内存 */
+    void Release();
 
     std::string GetPath() const;
     std::string &GetPath();
     std::string GetMethod() const;
+    HTTP_METHOD GetMethodId() const { return methodId; }
     std::string GetVersion() const;
     std::string GetPost(const std::string &key) const;
     std::string GetPost(const char *key) const;
+    StrRef GetHeader(HEADER_ID id) const;
+    StrRef GetHeader(const char *key) const;
+
+    /* 路由参数, 由 Router 匹配后填入 */
+    void SetParam(StrRef key, StrRef value);
+    StrRef GetParam(const char *key) const;
 
     bool IsKeepAlive() const;
 
+    static size_t maxBodySize; /* 超过返回 413 */
+    static size_t memBodySize; /* 超过转存到 spoolDir 下的临时文件 */
+    static const char *spoolDir;
+
     /*
     todo
     void HttpConn::ParseFormData() {}
@@ -63,24 +94,74 @@ public:
     */
 
 private:
-    bool ParseRequestLine(const std::string &line);
-    void ParseHeader(const std::string &line);
-    void ParseBody(const std::string &line);
+    struct Field
+    {
+        StrRef key;
+        StrRef value;
+    };
+
+    /* Arena 上的键值数组, 请求结束整体丢弃 */
+    struct FieldList
+    {
+        Field *items;
+        size_t cnt;
+        size_t cap;
+    };
+
+    bool ParseRequestLine(const char *begin, const char *end);
+    bool ParseHeader(const char *begin, const char *end);
+    static bool CheckDuplicate(HEADER_ID id, const StrRef &old, const StrRef &val);
+    HTTP_CODE ParseHeaderEnd();
+    HTTP_CODE ParseBody(Buffer &buff);
+    HTTP_CODE ParseChunked(Buffer &buff);
+    HTTP_CODE FinishBody();
+    bool AppendBody(const char *data, size_t len);
 
-    void ParsePath();
     void ParsePost();
     void ParseFromUrlencoded();
 
-    static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
+    void AddField(FieldList &list, StrRef key, StrRef value);
+    static const Field *FindField(const FieldList &list, const char *key, size_t len);
 
     PARSE_STATE state;
-    std::string method, path, version, body;
-    std::unordered_map<std::string, std::string> header;
-    std::unordered_map<std::string, std::string> post;
+    size_t lineScanned; /* 当前不完整的行已查找过的字节数 */
+    std::string path;
+    StrRef method, version, body;
+    HTTP_METHOD methodId;
+
+    enum BODY_MODE
+    {
+        BODY_NONE,
+        BODY_LENGTH,
+        BODY_CHUNKED,
+    };
+
+    enum CHUNK_STATE
+    {
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_CRLF,
+        CHUNK_TRAILER,
+    };
+
+    BODY_MODE bodyMode;
+    CHUNK_STATE chunkState;
+    bool continueSent;
+    size_t contentLen; /* Content-Length, 或当前分块剩余字节数 */
+    size_t bodyLen;    /* 已收到的请求体字节数 */
+    char *bodyBuf;     /* 内存中的请求体, 在 Arena 上 */
+    size_t bodyCap;
+    std::unique_ptr<BodySink> sink;
+    StrRef *knownHeader; /* 常用头按 HEADER_ID 落槽, 数组在 Arena 上 */
+    FieldList header;    /* 其余头部 */
+    FieldList post;
+    FieldList params;
+    Arena arena;
 
-    static const std::unordered_set<std::string> DEFAULT_HTML;
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
     static int ConverHex(char ch);
+    static bool HasToken(StrRef value, const char *token);
+
+    static const size_t MAX_LINE = 8192;
 };
 
 #endif // HTTP_REQUEST_H
\ No newline at end of file
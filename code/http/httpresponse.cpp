@@ -7,48 +7,14 @@
 
 using namespace std;
 
-const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
-    {".html", "text/html"},
-    {".xml", "text/xml"},
-    {".xhtml", "application/xhtml+xml"},
-    {".txt", "text/plain"},
-    {".rtf", "application/rtf"},
-    {".pdf", "application/pdf"},
-    {".word", "application/nsword"},
-    {".png", "image/png"},
-    {".gif", "image/gif"},
-    {".jpg", "image/jpeg"},
-    {".jpeg", "image/jpeg"},
-    {".au", "audio/basic"},
-    {".mpeg", "video/mpeg"},
-    {".mpg", "video/mpeg"},
-    {".avi", "video/x-msvideo"},
-    {".gz", "application/x-gzip"},
-    {".tar", "application/x-tar"},
-    {".css", "text/css "},
-    {".js", "text/javascript "},
-};
-
-const unordered_map<int, string> HttpResponse::CODE_STATUS = {
-    {200, "OK"},
-    {400, "Bad Request"},
-    {403, "Forbidden"},
-    {404, "Not Found"},
-};
-
-const unordered_map<int, string> HttpResponse::CODE_PATH = {
-    {400, "/400.html"},
-    {403, "/403.html"},
-    {404, "/404.html"},
-};
-
 HttpResponse::HttpResponse()
 {
     mCode = -1;
-    mPath = mSrcDir = "";
+    mPath = "";
+    mSrcDir = "";
     isKeepAlive = false;
-    mmFile = nullptr;
-    mmFileStat = {0};
+    isHead = false;
+    streamType = nullptr;
 };
 
 HttpResponse::~HttpResponse()
@@ -56,157 +22,262 @@ HttpResponse::~HttpResponse()
     UnmapFile();
 }
 
-void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, int code)
+void HttpResponse::Init(const char *srcDir, string &path, bool isKeepAlive, int code, HTTP_METHOD method)
 {
-    assert(srcDir != "");
-    if (mmFile)
-    {
-        UnmapFile();
-    }
+    assert(srcDir && *srcDir);
+    UnmapFile();
+    StopStream();
+    content.reset();
+    allow.clear();
     mCode = code;
-    isKeepAlive = isKeepAlive;
+    this->isKeepAlive = isKeepAlive;
+    isHead = method == METHOD_HEAD;
     mPath = path;
     mSrcDir = srcDir;
-    mmFile = nullptr;
-    mmFileStat = {0};
 }
 
-void HttpResponse::MakeResponse(Buffer &buff)
+void HttpResponse::Resolve()
 {
-    /* 判断请求的资源文件 */
-    if (stat((mSrcDir + mPath).data(), &mmFileStat) < 0 || S_ISDIR(mmFileStat.st_mode))
+    /* 确定状态码与内容来源: 流式数据源 / 给定内容 / 文件 / 错误页 */
+    if (producer || content)
     {
-        mCode = 404;
+        return;
     }
-    else if (!(mmFileStat.st_mode & S_IROTH))
+    if (mCode == -1 || mCode == 200)
     {
-        mCode = 403;
+        /* 判断请求的资源文件, 文件状态由 FileCache 按 TTL 重新校验 */
+        mCode = FileCache::Instance()->Get(mSrcDir, mPath, 200, mFile);
     }
-    else if (mCode == -1)
+    ErrorHtml();
+    if (!mFile && HasBody())
     {
-        mCode = 200;
+        const HttpStatus *status = FindStatus(mCode);
+        ErrorContent(mCode >= 400 && status && !status->errorPage ? status->reason : "File NotFound!");
+    }
+}
+
+void HttpResponse::MakeResponse(BufferChain &chain)
+{
+    Resolve();
+    if (mFile && mFile->code == mCode)
+    {
+        AddCached(chain);
+        return;
+    }
+    AddStateLine(chain);
+    AddHeader(chain);
+    if (!HasBody())
+    {
+        /* 1xx, 204, 304 不带内容, 也不发 Content-length */
+        StopStream();
+        content.reset();
+        chain.AppendStatic("\r\n", 2);
+        return;
+    }
+    if (producer)
+    {
+        if (isKeepAlive)
+        {
+            chain.AppendStatic("Transfer-Encoding: chunked\r\n");
+        }
+        chain.AppendStatic("\r\n", 2);
+        if (isHead)
+        {
+            /* 头部与 GET 相同, 不调用数据源 */
+            StopStream();
+            return;
+        }
+        /* 头部与第一段内容一起发出 */
+        Pump(chain);
+        return;
+    }
+    char line[64];
+    int n = snprintf(line, sizeof(line), "Content-length: %zu\r\n\r\n", BodyLen());
+    chain.Append(line, n);
+    if (!isHead)
+    {
+        AppendBody(chain);
+    }
+}
+
+size_t HttpResponse::BodyLen() const
+{
+    return content ? content->size() : mFile ? mFile->len : 0;
+}
+
+const MimeType *HttpResponse::ContentType()
+{
+    return (producer || content) ? streamType : GetFileType();
+}
+
+void HttpResponse::AppendBody(BufferChain &chain)
+{
+    if (content)
+    {
+        chain.AppendShared(content, content->data(), content->size());
+    }
+    else if (mFile && mFile->data)
+    {
+        chain.AppendShared(mFile, mFile->data.get(), mFile->len);
     }
-    ErrorHtml();
-    AddStateLine(buff);
-    AddHeader(buff);
-    AddContent(buff);
 }
 
 char *HttpResponse::File()
 {
-    return mmFile;
+    return mFile ? mFile->data.get() : nullptr;
 }
 
 size_t HttpResponse::FileLen() const
 {
-    return mmFileStat.st_size;
+    return mFile ? mFile->len : 0;
 }
 
 void HttpResponse::ErrorHtml()
 {
-    if (CODE_PATH.count(mCode) == 1)
+    const HttpStatus *status = FindStatus(mCode);
+    if (status && status->errorPage)
     {
-        mPath = CODE_PATH.find(mCode)->second;
-        stat((mSrcDir + mPath).data(), &mmFileStat);
+        mPath = status->errorPage;
+        if (FileCache::Instance()->Get(mSrcDir, mPath, mCode, mFile) != 200)
+        {
+            mFile.reset();
+        }
+    }
+    else if (mCode >= 400)
+    {
+        /* 没有错误页的状态, 由 ErrorContent 生成内容 */
+        mFile.reset();
     }
 }
 
-void HttpResponse::AddStateLine(Buffer &buff)
+void HttpResponse::AddCached(BufferChain &chain)
 {
-    string status;
-    if (CODE_STATUS.count(mCode) == 1)
+    /* 预渲染的头部 + 本秒的 Date + 文件映射, 全部按引用挂到发送链上 */
+    const string &header = mFile->header[isKeepAlive ? 1 : 0];
+    chain.AppendShared(mFile, header.data(), header.size());
+    AddAllow(chain);
+    shared_ptr<const string> date = FileCache::DateLine();
+    chain.AppendShared(date, date->data(), date->size());
+    chain.AppendStatic("\r\n", 2);
+    if (mFile->data && !isHead)
     {
-        status = CODE_STATUS.find(mCode)->second;
+        chain.AppendShared(mFile, mFile->data.get(), mFile->len);
     }
-    else
+}
+
+void HttpResponse::SetStream(const MimeType *type, StreamProducer producer)
+{
+    assert(producer);
+    streamType = type ? type : DefaultMimeType();
+    this->producer = std::move(producer);
+    if (mCode == -1)
     {
-        mCode = 400;
-        status = CODE_STATUS.find(400)->second;
+        mCode = 200;
     }
-    buff.Append("HTTP/1.1 " + to_string(mCode) + " " + status + "\r\n");
 }
 
-void HttpResponse::AddHeader(Buffer &buff)
+void HttpResponse::SetContent(const MimeType *type, string content)
 {
-    buff.Append("Connection: ");
-    if (isKeepAlive)
+    streamType = type ? type : DefaultMimeType();
+    this->content = make_shared<const string>(std::move(content));
+    if (mCode == -1)
     {
-        buff.Append("keep-alive\r\n");
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
+        mCode = 200;
     }
-    else
+}
+
+void HttpResponse::StopStream()
+{
+    producer = nullptr;
+    streamType = nullptr;
+}
+
+void HttpResponse::Pump(BufferChain &chain, const StreamWakeRef &wake)
+{
+    StreamWriter writer(chain, isKeepAlive, wake);
+    while (producer && chain.ReadableBytes() < STREAM_LOW_WATER)
     {
-        buff.Append("close\r\n");
+        size_t before = chain.ReadableBytes();
+        if (!producer(writer))
+        {
+            if (isKeepAlive)
+            {
+                chain.AppendStatic("0\r\n\r\n");
+            }
+            StopStream();
+            break;
+        }
+        if (chain.ReadableBytes() == before)
+        {
+            /* 数据源暂时没有内容, 发送链写空后连接挂起, 由数据源唤醒 */
+            break;
+        }
     }
-    buff.Append("Content-type: " + GetFileType() + "\r\n");
 }
 
-void HttpResponse::AddContent(Buffer &buff)
+void HttpResponse::AddStateLine(BufferChain &chain)
 {
-    int srcFd = open((mSrcDir + mPath).data(), O_RDONLY);
-    if (srcFd < 0)
+    /* 完整状态行在编译期生成 */
+    const HttpStatus *status = FindStatus(mCode);
+    if (status)
     {
-        ErrorContent(buff, "File NotFound!");
+        chain.AppendStatic(status->line, status->lineLen);
         return;
     }
-
-    /* 将文件映射到内存提高文件的访问速度
-        MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
-    LOG_DEBUG("file path %s", (mSrcDir + mPath).data());
-    int *mmRet = (int *)mmap(0, mmFileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1)
+    /* 表中没有的状态码照原样发出, 原因短语可以为空 */
+    LOG_ERROR("No reason phrase for status %d", mCode);
+    if (mCode < 100 || mCode > 599)
     {
-        ErrorContent(buff, "File NotFound!");
+        mCode = 500;
+        status = FindStatus(mCode);
+        chain.AppendStatic(status->line, status->lineLen);
         return;
     }
-    mmFile = (char *)mmRet;
-    close(srcFd);
-    buff.Append("Content-length: " + to_string(mmFileStat.st_size) + "\r\n\r\n");
+    char line[32];
+    int n = snprintf(line, sizeof(line), "HTTP/1.1 %d \r\n", mCode);
+    chain.Append(line, n);
 }
 
-void HttpResponse::UnmapFile()
+void HttpResponse::AddHeader(BufferChain &chain)
 {
-    if (mmFile)
+    size_t len;
+    const char *conn = ConnectionHeader(isKeepAlive, &len);
+    chain.AppendStatic(conn, len);
+    const MimeType *type = ContentType();
+    chain.AppendStatic(type->header, type->headerLen);
+    AddAllow(chain);
+    shared_ptr<const string> date = FileCache::DateLine();
+    chain.AppendShared(date, date->data(), date->size());
+}
+
+void HttpResponse::AddAllow(BufferChain &chain)
+{
+    if (!allow.empty())
     {
-        munmap(mmFile, mmFileStat.st_size);
-        mmFile = nullptr;
+        chain.Append("Allow: " + allow + "\r\n");
     }
 }
 
-string HttpResponse::GetFileType()
+void HttpResponse::UnmapFile()
+{
+    mFile.reset();
+}
+
+const MimeType *HttpResponse::GetFileType()
 {
     /* 判断文件类型 */
-    string::size_type idx = mPath.find_last_of('.');
-    if (idx == string::npos)
-    {
-        return "text/plain";
-    }
-    string suffix = mPath.substr(idx);
-    if (SUFFIX_TYPE.count(suffix) == 1)
-    {
-        return SUFFIX_TYPE.find(suffix)->second;
-    }
-    return "text/plain";
+    return mFile ? mFile->type : FindMimeTypeByPath(mPath.data(), mPath.size());
 }
 
-void HttpResponse::ErrorContent(Buffer &buff, string message)
+void HttpResponse::ErrorContent(string message)
 {
     string body;
-    string status;
+    const HttpStatus *info = FindStatus(mCode);
+    string status = info ? info->reason : "Bad Request";
     body += "<html><title>Error</title>";
     body += "<body bgcolor=\"ffffff\">";
-    if (CODE_STATUS.count(mCode) == 1)
-    {
-        status = CODE_STATUS.find(mCode)->second;
-    }
-    else
-    {
-        status = "Bad Request";
-    }
     body += to_string(mCode) + " : " + status + "\n";
     body += "<p>" + message + "</p>";
     body += "<hr><em>TinyWebServer</em></body></html>";
-
-    buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
-    buff.Append(body);
+    SetContent(FindMimeType(".html", 5), std::move(body));
 }
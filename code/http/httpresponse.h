@@ -6,14 +6,16 @@
 #ifndef HTTP_RESPONSE_H
 #define HTTP_RESPONSE_H
 
-#include <unordered_map>
 #include <fcntl.h>    // open
 #include <unistd.h>   // close
 #include <sys/stat.h> // stat
 #include <sys/mman.h> // mmap, munmap
 
-#include "../buffer/buffer.h"
+#include "../buffer/bufferchain.h"
 #include "../log/log.h"
+#include "httptables.h"
+#include "filecache.h"
+#include "streamwriter.h"
 
 class HttpResponse
 {
@@ -21,34 +23,70 @@ public:
     HttpResponse();
     ~HttpResponse();
 
-    void Init(const std::string &srcDir, std::string &path, bool isKeepAlive = false, int code = -1);
-    void MakeResponse(Buffer &buff);
+    /* HEAD 请求的响应保留 Content-length 等头部, 不带内容 */
+    void Init(const char *srcDir, std::string &path, bool isKeepAlive = false, int code = -1,
+              HTTP_METHOD method = METHOD_GET);
+    void MakeResponse(BufferChain &chain);
+
+    /* 确定状态码与内容来源, MakeResponse 会先调用; HTTP/2 用下面几个接口自行组帧 */
+    void Resolve();
+    size_t BodyLen() const;
+    const MimeType *ContentType();
+    void AppendBody(BufferChain &chain);
     void UnmapFile();
     char *File();
     size_t FileLen() const;
-    void ErrorContent(Buffer &buff, std::string message);
+    void ErrorContent(std::string message);
     int Code() const { return mCode; }
+    /* 1xx, 204, 304 的响应没有内容 */
+    bool HasBody() const { return mCode >= 200 && mCode != 204 && mCode != 304; }
+
+    /* 以下由路由处理函数在 MakeResponse 之前调用 */
+    void SetCode(int code) { mCode = code; }
+    void SetPath(const std::string &path) { mPath = path; }
+    const std::string &GetPath() const { return mPath; }
+    /* 405 响应的 Allow 头部, 如 "GET, HEAD" */
+    void SetAllow(std::string methods) { allow = std::move(methods); }
+    const std::string &Allow() const { return allow; }
+    std::string &GetPath() { return mPath; }
+    /* 直接给出响应内容, 不读文件 */
+    void SetContent(const MimeType *type, std::string content);
+
+    /* MakeResponse 之前改为短连接, 如 HTTP/1.0 的流式响应 */
+    void SetKeepAlive(bool on) { isKeepAlive = on; }
+
+    /* 改为流式响应: 由 producer 逐段生成内容, 长连接用 chunked 编码, 否则写完即关闭连接 */
+    void SetStream(const MimeType *type, StreamProducer producer);
+    bool IsStreaming() const { return static_cast<bool>(producer); }
+    /* 发送链低于水位时继续向数据源要内容; wake 为连接的唤醒状态, 传给数据源的 StreamWriter */
+    void Pump(BufferChain &chain, const StreamWakeRef &wake = nullptr);
+    void StopStream();
+
+    static const size_t STREAM_LOW_WATER = 64 * 1024;
 
 private:
-    void AddStateLine(Buffer &buff);
-    void AddHeader(Buffer &buff);
-    void AddContent(Buffer &buff);
+    void AddStateLine(BufferChain &chain);
+    void AddHeader(BufferChain &chain);
+    void AddCached(BufferChain &chain);
+    void AddAllow(BufferChain &chain);
 
     void ErrorHtml();
-    std::string GetFileType();
+    const MimeType *GetFileType();
 
     int mCode;
     bool isKeepAlive;
+    bool isHead;
 
     std::string mPath;
-    std::string mSrcDir;
+    std::string allow;
+    const char *mSrcDir; /* 所有连接共用 HttpConn::srcDir */
 
-    char *mmFile;
-    struct stat mmFileStat;
+    /* 缓存项由引用计数持有, 发送链写完前不会被 munmap */
+    std::shared_ptr<const CachedFile> mFile;
 
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
-    static const std::unordered_map<int, std::string> CODE_STATUS;
-    static const std::unordered_map<int, std::string> CODE_PATH;
+    StreamProducer producer;
+    const MimeType *streamType; /* 流式响应与直接给出内容时的类型 */
+    std::shared_ptr<const std::string> content;
 };
 
 #endif // HTTP_RESPONSE_H
\ No newline at end of file
@@ -0,0 +1,340 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "httptables.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h> // strncasecmp
+
+namespace
+{
+    struct StrLit
+    {
+        const char *str;
+        size_t len;
+
+        constexpr StrLit() : str(""), len(0) {}
+        template <size_t N>
+        constexpr StrLit(const char (&s)[N]) : str(s), len(N - 1) {}
+    };
+
+    constexpr char ToLower(char ch)
+    {
+        return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+    }
+
+    /* FNV-1a, 忽略大小写, seed 由编译期搜索得到 */
+    constexpr uint32_t Hash(const char *str, size_t len, uint32_t seed)
+    {
+        uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+        for (size_t i = 0; i < len; i++)
+        {
+            h ^= static_cast<uint8_t>(ToLower(str[i]));
+            h *= 16777619u;
+        }
+        return h ^ (h >> 16);
+    }
+
+    constexpr uint32_t HashInt(int key, uint32_t seed)
+    {
+        return (static_cast<uint32_t>(key) * (2654435761u ^ (seed * 0x9e3779b9u))) >> 7;
+    }
+
+    template <size_t M>
+    struct PerfectHash
+    {
+        uint32_t seed;
+        int16_t slot[M];
+    };
+
+    /* 编译期逐个尝试 seed, 直到所有 key 落在不同槽位 */
+    template <size_t M, size_t N>
+    constexpr PerfectHash<M> BuildHash(const StrLit (&keys)[N])
+    {
+        PerfectHash<M> ph{};
+        for (uint32_t seed = 1; seed < 100000; seed++)
+        {
+            for (size_t i = 0; i < M; i++)
+            {
+                ph.slot[i] = -1;
+            }
+            bool ok = true;
+            for (size_t k = 0; k < N && ok; k++)
+            {
+                uint32_t h = Hash(keys[k].str, keys[k].len, seed) % M;
+                if (ph.slot[h] != -1)
+                {
+                    ok = false;
+                }
+                else
+                {
+                    ph.slot[h] = static_cast<int16_t>(k);
+                }
+            }
+            if (ok)
+            {
+                ph.seed = seed;
+                return ph;
+            }
+        }
+        ph.seed = 0;
+        return ph;
+    }
+
+    template <size_t M, size_t N>
+    constexpr PerfectHash<M> BuildIntHash(const int (&keys)[N])
+    {
+        PerfectHash<M> ph{};
+        for (uint32_t seed = 1; seed < 100000; seed++)
+        {
+            for (size_t i = 0; i < M; i++)
+            {
+                ph.slot[i] = -1;
+            }
+            bool ok = true;
+            for (size_t k = 0; k < N && ok; k++)
+            {
+                uint32_t h = HashInt(keys[k], seed) % M;
+                if (ph.slot[h] != -1)
+                {
+                    ok = false;
+                }
+                else
+                {
+                    ph.slot[h] = static_cast<int16_t>(k);
+                }
+            }
+            if (ok)
+            {
+                ph.seed = seed;
+                return ph;
+            }
+        }
+        ph.seed = 0;
+        return ph;
+    }
+
+    template <size_t M, size_t N>
+    int Lookup(const PerfectHash<M> &ph, const StrLit (&keys)[N], const char *str, size_t len, bool noCase)
+    {
+        int idx = ph.slot[Hash(str, len, ph.seed) % M];
+        if (idx < 0 || static_cast<size_t>(idx) >= N || keys[idx].len != len)
+        {
+            return -1;
+        }
+        int diff = noCase ? strncasecmp(keys[idx].str, str, len) : memcmp(keys[idx].str, str, len);
+        return diff == 0 ? idx : -1;
+    }
+
+    /* ---------------- 请求头 ---------------- */
+    constexpr StrLit HEADER_NAMES[] = {
+        "Host",
+        "Connection",
+        "Keep-Alive",
+        "Content-Length",
+        "Content-Type",
+        "Transfer-Encoding",
+        "Expect",
+        "Upgrade",
+        "HTTP2-Settings",
+        "User-Agent",
+        "Accept",
+        "Accept-Encoding",
+        "Accept-Language",
+        "Cache-Control",
+        "Pragma",
+        "Cookie",
+        "Referer",
+        "Origin",
+        "Authorization",
+        "If-Modified-Since",
+        "If-None-Match",
+        "Range",
+        "Upgrade-Insecure-Requests",
+        "DNT",
+    };
+    static_assert(sizeof(HEADER_NAMES) / sizeof(HEADER_NAMES[0]) == HDR_COUNT, "HEADER_NAMES != HEADER_ID");
+    constexpr PerfectHash<128> HEADER_HASH = BuildHash<128>(HEADER_NAMES);
+    static_assert(HEADER_HASH.seed != 0, "no perfect hash for HEADER_NAMES");
+
+    /* ---------------- 请求方法 ---------------- */
+    constexpr StrLit METHOD_NAMES[] = {
+        "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS",
+    };
+    static_assert(sizeof(METHOD_NAMES) / sizeof(METHOD_NAMES[0]) == METHOD_COUNT, "METHOD_NAMES != HTTP_METHOD");
+    constexpr PerfectHash<16> METHOD_HASH = BuildHash<16>(METHOD_NAMES);
+    static_assert(METHOD_HASH.seed != 0, "no perfect hash for METHOD_NAMES");
+
+    /* ---------------- 状态行 ---------------- */
+#define HTTP_STATUS(code, reason, page) \
+    {code, reason, "HTTP/1.1 " #code " " reason "\r\n", sizeof("HTTP/1.1 " #code " " reason "\r\n") - 1, page}
+
+    constexpr int STATUS_CODES[] = {
+        100, 101, 200, 201, 202, 204, 206, 301, 302, 303, 304, 307, 308,
+        400, 401, 403, 404, 405, 408, 409, 411, 413, 414, 415, 416, 429, 431,
+        500, 501, 502, 503, 504, 505,
+    };
+    constexpr HttpStatus STATUS[] = {
+        HTTP_STATUS(100, "Continue", nullptr),
+        HTTP_STATUS(101, "Switching Protocols", nullptr),
+        HTTP_STATUS(200, "OK", nullptr),
+        HTTP_STATUS(201, "Created", nullptr),
+        HTTP_STATUS(202, "Accepted", nullptr),
+        HTTP_STATUS(204, "No Content", nullptr),
+        HTTP_STATUS(206, "Partial Content", nullptr),
+        HTTP_STATUS(301, "Moved Permanently", nullptr),
+        HTTP_STATUS(302, "Found", nullptr),
+        HTTP_STATUS(303, "See Other", nullptr),
+        HTTP_STATUS(304, "Not Modified", nullptr),
+        HTTP_STATUS(307, "Temporary Redirect", nullptr),
+        HTTP_STATUS(308, "Permanent Redirect", nullptr),
+        HTTP_STATUS(400, "Bad Request", "/400.html"),
+        HTTP_STATUS(401, "Unauthorized", nullptr),
+        HTTP_STATUS(403, "Forbidden", "/403.html"),
+        HTTP_STATUS(404, "Not Found", "/404.html"),
+        HTTP_STATUS(405, "Method Not Allowed", "/405.html"),
+        HTTP_STATUS(408, "Request Timeout", nullptr),
+        HTTP_STATUS(409, "Conflict", nullptr),
+        HTTP_STATUS(411, "Length Required", nullptr),
+        HTTP_STATUS(413, "Payload Too Large", nullptr),
+        HTTP_STATUS(414, "URI Too Long", nullptr),
+        HTTP_STATUS(415, "Unsupported Media Type", nullptr),
+        HTTP_STATUS(416, "Range Not Satisfiable", nullptr),
+        HTTP_STATUS(429, "Too Many Requests", nullptr),
+        HTTP_STATUS(431, "Request Header Fields Too Large", nullptr),
+        HTTP_STATUS(500, "Internal Server Error", nullptr),
+        HTTP_STATUS(501, "Not Implemented", nullptr),
+        HTTP_STATUS(502, "Bad Gateway", nullptr),
+        HTTP_STATUS(503, "Service Unavailable", nullptr),
+        HTTP_STATUS(504, "Gateway Timeout", nullptr),
+        HTTP_STATUS(505, "HTTP Version Not Supported", nullptr),
+    };
+#undef HTTP_STATUS
+    static_assert(sizeof(STATUS_CODES) / sizeof(int) == sizeof(STATUS) / sizeof(HttpStatus), "STATUS size");
+    constexpr PerfectHash<128> STATUS_HASH = BuildIntHash<128>(STATUS_CODES);
+    static_assert(STATUS_HASH.seed != 0, "no perfect hash for STATUS_CODES");
+
+    /* ---------------- 文件类型 ---------------- */
+#define MIME(type) \
+    {type, "Content-type: " type "\r\n", sizeof("Content-type: " type "\r\n") - 1}
+
+    constexpr StrLit MIME_SUFFIX[] = {
+        ".html", ".xml", ".xhtml", ".txt", ".rtf", ".pdf", ".word",
+        ".png", ".gif", ".jpg", ".jpeg", ".ico", ".svg",
+        ".au", ".mpeg", ".mpg", ".avi", ".mp4",
+        ".gz", ".tar", ".css", ".js", ".json",
+        ".woff", ".woff2", ".ttf", ".otf", ".eot",
+    };
+    constexpr MimeType MIME_TYPE[] = {
+        MIME("text/html"), MIME("text/xml"), MIME("application/xhtml+xml"), MIME("text/plain"),
+        MIME("application/rtf"), MIME("application/pdf"), MIME("application/nsword"),
+        MIME("image/png"), MIME("image/gif"), MIME("image/jpeg"), MIME("image/jpeg"),
+        MIME("image/x-icon"), MIME("image/svg+xml"),
+        MIME("audio/basic"), MIME("video/mpeg"), MIME("video/mpeg"), MIME("video/x-msvideo"), MIME("video/mp4"),
+        MIME("application/x-gzip"), MIME("application/x-tar"), MIME("text/css"), MIME("text/javascript"),
+        MIME("application/json"),
+        MIME("font/woff"), MIME("font/woff2"), MIME("font/ttf"), MIME("font/otf"),
+        MIME("application/vnd.ms-fontobject"),
+    };
+    constexpr MimeType MIME_DEFAULT = MIME("text/plain");
+#undef MIME
+    static_assert(sizeof(MIME_SUFFIX) / sizeof(StrLit) == sizeof(MIME_TYPE) / sizeof(MimeType), "MIME size");
+    constexpr PerfectHash<128> MIME_HASH = BuildHash<128>(MIME_SUFFIX);
+    static_assert(MIME_HASH.seed != 0, "no perfect hash for MIME_SUFFIX");
+
+    /* ---------------- 默认页面 ---------------- */
+    constexpr StrLit DEFAULT_HTML[] = {
+        "/index", "/register", "/login", "/welcome", "/video", "/picture",
+    };
+    constexpr PerfectHash<16> DEFAULT_HTML_HASH = BuildHash<16>(DEFAULT_HTML);
+    static_assert(DEFAULT_HTML_HASH.seed != 0, "no perfect hash for DEFAULT_HTML");
+}
+
+HEADER_ID FindHeaderId(const char *name, size_t len)
+{
+    int idx = Lookup(HEADER_HASH, HEADER_NAMES, name, len, true);
+    return idx < 0 ? HDR_UNKNOWN : static_cast<HEADER_ID>(idx);
+}
+
+const char *HeaderName(HEADER_ID id)
+{
+    return id < HDR_COUNT ? HEADER_NAMES[id].str : "";
+}
+
+HTTP_METHOD FindMethod(const char *method, size_t len)
+{
+    /* 方法名区分大小写 */
+    int idx = Lookup(METHOD_HASH, METHOD_NAMES, method, len, false);
+    return idx < 0 ? METHOD_UNKNOWN : static_cast<HTTP_METHOD>(idx);
+}
+
+const char *MethodName(HTTP_METHOD method)
+{
+    return method < METHOD_COUNT ? METHOD_NAMES[method].str : "";
+}
+
+const HttpStatus *FindStatus(int code)
+{
+    int idx = STATUS_HASH.slot[HashInt(code, STATUS_HASH.seed) % 128];
+    if (idx < 0 || STATUS_CODES[idx] != code)
+    {
+        return nullptr;
+    }
+    return &STATUS[idx];
+}
+
+const MimeType *FindMimeType(const char *suffix, size_t len)
+{
+    int idx = Lookup(MIME_HASH, MIME_SUFFIX, suffix, len, true);
+    return idx < 0 ? nullptr : &MIME_TYPE[idx];
+}
+
+const MimeType *DefaultMimeType()
+{
+    return &MIME_DEFAULT;
+}
+
+const MimeType *FindMimeTypeByPath(const char *path, size_t len)
+{
+    const char *dot = static_cast<const char *>(memrchr(path, '.', len));
+    if (!dot)
+    {
+        return &MIME_DEFAULT;
+    }
+    const MimeType *type = FindMimeType(dot, path + len - dot);
+    return type ? type : &MIME_DEFAULT;
+}
+
+namespace
+{
+#define STR_(x) #x
+#define STR(x) STR_(x)
+    char keepAlive[96] = "Connection: keep-alive\r\nkeep-alive: max=" STR(HTTP_KEEP_ALIVE_MAX) ", timeout=60\r\n";
+#undef STR
+#undef STR_
+    size_t keepAliveLen = strlen(keepAlive);
+}
+
+void SetKeepAliveTimeout(int ms)
+{
+    /* 按整秒向下取, 客户端总在服务器关闭之前放弃连接 */
+    int n = ms > 0 ? snprintf(keepAlive, sizeof(keepAlive), "Connection: keep-alive\r\nkeep-alive: max=%d, timeout=%d\r\n",
+                              HTTP_KEEP_ALIVE_MAX, ms / 1000)
+                   : snprintf(keepAlive, sizeof(keepAlive), "Connection: keep-alive\r\nkeep-alive: max=%d\r\n",
+                              HTTP_KEEP_ALIVE_MAX);
+    keepAliveLen = static_cast<size_t>(n);
+}
+
+const char *ConnectionHeader(bool isKeepAlive, size_t *len)
+{
+    static const char CLOSE[] = "Connection: close\r\n";
+    *len = isKeepAlive ? keepAliveLen : sizeof(CLOSE) - 1;
+    return isKeepAlive ? keepAlive : CLOSE;
+}
+
+bool IsDefaultHtml(const char *path, size_t len)
+{
+    return Lookup(DEFAULT_HTML_HASH, DEFAULT_HTML, path, len, false) >= 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef HTTP_TABLES_H
+#define HTTP_TABLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 常用请求头, 解析时直接落到固定数组槽位 */
+enum HEADER_ID
+{
+    HDR_HOST,
+    HDR_CONNECTION,
+    HDR_KEEP_ALIVE,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_TYPE,
+    HDR_TRANSFER_ENCODING,
+    HDR_EXPECT,
+    HDR_UPGRADE,
+    HDR_HTTP2_SETTINGS,
+    HDR_USER_AGENT,
+    HDR_ACCEPT,
+    HDR_ACCEPT_ENCODING,
+    HDR_ACCEPT_LANGUAGE,
+    HDR_CACHE_CONTROL,
+    HDR_PRAGMA,
+    HDR_COOKIE,
+    HDR_REFERER,
+    HDR_ORIGIN,
+    HDR_AUTHORIZATION,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_NONE_MATCH,
+    HDR_RANGE,
+    HDR_UPGRADE_INSECURE_REQUESTS,
+    HDR_DNT,
+    HDR_COUNT,
+    HDR_UNKNOWN = HDR_COUNT,
+};
+
+enum HTTP_METHOD
+{
+    METHOD_GET,
+    METHOD_HEAD,
+    METHOD_POST,
+    METHOD_PUT,
+    METHOD_DELETE,
+    METHOD_PATCH,
+    METHOD_OPTIONS,
+    METHOD_COUNT,
+    METHOD_UNKNOWN = METHOD_COUNT,
+};
+
+struct HttpStatus
+{
+    int code;
+    const char *reason;
+    const char *line; /* 完整状态行 "HTTP/1.1 200 OK\r\n" */
+    size_t lineLen;
+    const char *errorPage; /* 对应的错误页, 没有则为 nullptr */
+};
+
+struct MimeType
+{
+    const char *type;
+    const char *header; /* 完整头部行 "Content-type: text/html\r\n" */
+    size_t headerLen;
+};
+
+/* 编译期生成的完美哈希查找, 热路径上不构造 std::string 也不走 unordered_map */
+HEADER_ID FindHeaderId(const char *name, size_t len);
+const char *HeaderName(HEADER_ID id);
+
+HTTP_METHOD FindMethod(const char *method, size_t len);
+const char *MethodName(HTTP_METHOD method);
+
+const HttpStatus *FindStatus(int code);
+const MimeType *FindMimeType(const char *suffix, size_t len);
+const MimeType *DefaultMimeType();
+/* 按路径后缀查找, 没有后缀或未知后缀返回默认类型 */
+const MimeType *FindMimeTypeByPath(const char *path, size_t len);
+
+/* 一个长连接上最多处理的请求数, 与 keep-alive 头部中的 max 一致 */
+#define HTTP_KEEP_ALIVE_MAX 6
+
+/* 完整的 Connection 头部行 */
+const char *ConnectionHeader(bool isKeepAlive, size_t *len);
+/* keep-alive 头部中的 timeout 取实际的空闲超时(毫秒, 0 不限制), 默认 60000; 启动时在处理请求之前设置 */
+void SetKeepAliveTimeout(int ms);
+
+bool IsDefaultHtml(const char *path, size_t len);
+
+#endif // HTTP_TABLES_H
@@ -0,0 +1,280 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "router.h"
+#include <algorithm>
+
+using namespace std;
+
+struct Router::Node
+{
+    string prefix;  /* 静态边上的文本, 参数/通配节点为空 */
+    string indices; /* 各静态子节点 prefix 的首字符, 与 children 一一对应 */
+    vector<unique_ptr<Node>> children;
+    unique_ptr<Node> param; /* ":name" */
+    unique_ptr<Node> wild;  /* "*name" */
+    string name;            /* 参数名 */
+    int handler[METHOD_COUNT];
+
+    Node() { fill(handler, handler + METHOD_COUNT, -1); }
+
+    bool HasHandler() const
+    {
+        return any_of(handler, handler + METHOD_COUNT, [](int h) { return h >= 0; });
+    }
+};
+
+Router::Router() : root(new Node), fallback(&Router::ServeStatic) {}
+
+Router::~Router() = default;
+
+bool Router::Add(HTTP_METHOD method, const string &path, Handler handler)
+{
+    if (method >= METHOD_COUNT || path.empty() || path[0] != '/' || !handler)
+    {
+        LOG_ERROR("Route %s %s error!", MethodName(method), path.c_str());
+        return false;
+    }
+    if (static_cast<size_t>(count_if(path.begin(), path.end(), [](char ch) { return ch == ':' || ch == '*'; })) >
+        RouteParams::MAX_PARAMS)
+    {
+        LOG_ERROR("Route %s too many params!", path.c_str());
+        return false;
+    }
+
+    Node *node = root.get();
+    size_t pos = 0;
+    while (pos < path.size())
+    {
+        char ch = path[pos];
+        if (ch == ':' || ch == '*')
+        {
+            /* 参数到下一个 '/' 为止, 通配到路径末尾 */
+            size_t end = ch == '*' ? path.size() : min(path.find('/', pos), path.size());
+            string name = path.substr(pos + 1, end - pos - 1);
+            unique_ptr<Node> &child = ch == ':' ? node->param : node->wild;
+            if (name.empty())
+            {
+                LOG_ERROR("Route %s empty param name!", path.c_str());
+                return false;
+            }
+            if (!child)
+            {
+                child.reset(new Node);
+                child->name = name;
+            }
+            else if (child->name != name)
+            {
+                LOG_ERROR("Route %s param %s conflicts with %s!", path.c_str(), name.c_str(), child->name.c_str());
+                return false;
+            }
+            node = child.get();
+            pos = end;
+            continue;
+        }
+
+        /* 静态文本, 与已有边共享前缀时拆分 */
+        size_t end = min(path.find_first_of(":*", pos), path.size());
+        size_t i = node->indices.find(ch);
+        if (i == string::npos)
+        {
+            Node *child = new Node;
+            child->prefix = path.substr(pos, end - pos);
+            node->indices += ch;
+            node->children.emplace_back(child);
+            node = child;
+            pos = end;
+            continue;
+        }
+        Node *child = node->children[i].get();
+        size_t l = 0;
+        while (l < child->prefix.size() && pos + l < end && child->prefix[l] == path[pos + l])
+        {
+            l++;
+        }
+        if (l < child->prefix.size())
+        {
+            Node *mid = new Node;
+            mid->prefix = child->prefix.substr(0, l);
+            child->prefix.erase(0, l);
+            mid->indices += child->prefix[0];
+            mid->children.push_back(std::move(node->children[i]));
+            node->children[i].reset(mid);
+            child = mid;
+        }
+        node = child;
+        pos += l;
+    }
+
+    if (node->handler[method] >= 0)
+    {
+        LOG_ERROR("Route %s %s duplicated!", MethodName(method), path.c_str());
+        return false;
+    }
+    node->handler[method] = static_cast<int>(handlers.size());
+    handlers.push_back(std::move(handler));
+    return true;
+}
+
+bool Router::Get(const string &path, Handler handler)
+{
+    return Add(METHOD_GET, path, std::move(handler));
+}
+
+bool Router::Post(const string &path, Handler handler)
+{
+    return Add(METHOD_POST, path, std::move(handler));
+}
+
+void Router::SetFallback(Handler handler)
+{
+    fallback = handler ? std::move(handler) : Handler(&Router::ServeStatic);
+}
+
+const Router::Node *Router::MatchNode(const Node *node, const char *path, size_t pos, size_t len, RouteParams &params)
+{
+    if (pos == len)
+    {
+        if (node->HasHandler())
+        {
+            return node;
+        }
+        if (node->wild && params.cnt < RouteParams::MAX_PARAMS)
+        {
+            params.names[params.cnt] = &node->wild->name;
+            params.values[params.cnt++] = StrRef(path + pos, 0);
+            return node->wild.get();
+        }
+        return nullptr;
+    }
+
+    /* 静态子节点: 首字符定位, 再比较整条边 */
+    const char *idx = static_cast<const char *>(memchr(node->indices.data(), path[pos], node->indices.size()));
+    if (idx)
+    {
+        const Node *child = node->children[idx - node->indices.data()].get();
+        size_t plen = child->prefix.size();
+        if (len - pos >= plen && memcmp(path + pos, child->prefix.data(), plen) == 0)
+        {
+            const Node *ret = MatchNode(child, path, pos + plen, len, params);
+            if (ret)
+            {
+                return ret;
+            }
+        }
+    }
+
+    if (node->param && params.cnt < RouteParams::MAX_PARAMS)
+    {
+        const char *slash = static_cast<const char *>(memchr(path + pos, '/', len - pos));
+        size_t end = slash ? slash - path : len;
+        if (end > pos)
+        {
+            params.names[params.cnt] = &node->param->name;
+            params.values[params.cnt++] = StrRef(path + pos, end - pos);
+            const Node *ret = MatchNode(node->param.get(), path, end, len, params);
+            if (ret)
+            {
+                return ret;
+            }
+            params.cnt--;
+        }
+    }
+
+    if (node->wild && node->wild->HasHandler() && params.cnt < RouteParams::MAX_PARAMS)
+    {
+        params.names[params.cnt] = &node->wild->name;
+        params.values[params.cnt++] = StrRef(path + pos, len - pos);
+        return node->wild.get();
+    }
+    return nullptr;
+}
+
+const Router::Handler *Router::Match(HTTP_METHOD method, const char *path, size_t len,
+                                     RouteParams &params, bool *pathFound, string *allow) const
+{
+    /* 查询串不参与匹配 */
+    const char *query = static_cast<const char *>(memchr(path, '?', len));
+    if (query)
+    {
+        len = query - path;
+    }
+    params.cnt = 0;
+    const Node *node = MatchNode(root.get(), path, 0, len, params);
+    if (pathFound)
+    {
+        *pathFound = node != nullptr;
+    }
+    if (!node)
+    {
+        return nullptr;
+    }
+    int index = method < METHOD_COUNT ? node->handler[method] : -1;
+    if (index < 0 && method == METHOD_HEAD)
+    {
+        index = node->handler[METHOD_GET];
+    }
+    if (index < 0)
+    {
+        if (allow)
+        {
+            allow->clear();
+            for (int m = 0; m < METHOD_COUNT; m++)
+            {
+                if (node->handler[m] >= 0 || (m == METHOD_HEAD && node->handler[METHOD_GET] >= 0))
+                {
+                    *allow += (allow->empty() ? "" : ", ");
+                    *allow += MethodName(static_cast<HTTP_METHOD>(m));
+                }
+            }
+        }
+        return nullptr;
+    }
+    return &handlers[index];
+}
+
+void Router::Dispatch(HttpRequest &request, HttpResponse &response) const
+{
+    RouteParams params;
+    bool pathFound = false;
+    string allow;
+    const string &path = request.GetPath();
+    const Handler *handler = Match(request.GetMethodId(), path.data(), path.size(), params, &pathFound, &allow);
+    if (handler)
+    {
+        for (size_t i = 0; i < params.cnt; i++)
+        {
+            request.SetParam(StrRef(params.names[i]->data(), params.names[i]->size()), params.values[i]);
+        }
+        (*handler)(request, response);
+    }
+    else if (pathFound)
+    {
+        response.SetCode(405);
+        response.SetAllow(std::move(allow));
+    }
+    else
+    {
+        fallback(request, response);
+    }
+}
+
+void Router::ServeStatic(HttpRequest &request, HttpResponse &response)
+{
+    string &path = response.GetPath();
+    size_t query = path.find('?');
+    if (query != string::npos)
+    {
+        path.resize(query);
+    }
+    if (path == "/")
+    {
+        path = "/index.html";
+    }
+    else if (IsDefaultHtml(path.data(), path.size()))
+    {
+        path += ".html";
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "httprequest.h"
+#include "httpresponse.h"
+#include "httptables.h"
+
+/* 匹配到的路由参数, 值指向请求路径, 不分配内存 */
+struct RouteParams
+{
+    static const size_t MAX_PARAMS = 8;
+
+    const std::string *names[MAX_PARAMS];
+    StrRef values[MAX_PARAMS];
+    size_t cnt;
+};
+
+/*
+ * 按方法 + 路径分发的基数树, 启动时注册, 运行中只读.
+ * 路径段: 静态文本, ":name" 匹配一段, "*name" 匹配剩余部分; 优先级 静态 > 参数 > 通配
+ */
+class Router
+{
+public:
+    /* 在工作线程中执行, 通过 response 设置路径/内容/流式数据源 */
+    typedef std::function<void(HttpRequest &request, HttpResponse &response)> Handler;
+
+    Router();
+    ~Router();
+
+    /* 重复注册或同一位置参数名不同返回 false */
+    bool Add(HTTP_METHOD method, const std::string &path, Handler handler);
+    bool Get(const std::string &path, Handler handler);
+    bool Post(const std::string &path, Handler handler);
+
+    /* 未匹配任何路由时执行, 默认为静态文件 */
+    void SetFallback(Handler handler);
+
+    /*
+     * 查找处理函数, 未注册 HEAD 的路径用 GET 的处理函数(响应不带内容);
+     * 路径存在但方法不符时返回 nullptr, pathFound 为 true, allow 为该路径支持的方法, 如 "GET, HEAD"
+     */
+    const Handler *Match(HTTP_METHOD method, const char *path, size_t len,
+                         RouteParams &params, bool *pathFound = nullptr, std::string *allow = nullptr) const;
+
+    void Dispatch(HttpRequest &request, HttpResponse &response) const;
+
+    size_t Size() const { return handlers.size(); }
+
+    /* 静态文件: "/" 及默认页面补全为 .html, 由 HttpResponse 读文件 */
+    static void ServeStatic(HttpRequest &request, HttpResponse &response);
+
+private:
+    struct Node;
+
+    static const Node *MatchNode(const Node *node, const char *path, size_t pos, size_t len, RouteParams &params);
+
+    std::unique_ptr<Node> root;
+    std::vector<Handler> handlers;
+    Handler fallback;
+};
+
+#endif // ROUTER_H
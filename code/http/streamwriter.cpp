@@ -0,0 +1,70 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "streamwriter.h"
+#include <stdio.h>
+
+std::function<void(const StreamWakeRef &)> StreamWake::notify;
+
+std::function<void()> StreamWriter::Waker() const
+{
+    StreamWakeRef w = wake;
+    return [w]()
+    {
+        /* 只有挂起中的连接需要主线程重新注册; 正在发送时留下标记, 挂起前会看到 */
+        if (w && w->state.exchange(StreamWake::WOKEN) == StreamWake::PARKED && StreamWake::notify)
+        {
+            StreamWake::notify(w);
+        }
+    };
+}
+
+void StreamWriter::ChunkHeader(size_t len)
+{
+    char line[32];
+    int n = snprintf(line, sizeof(line), "%zx\r\n", len);
+    chain.Append(line, n);
+}
+
+void StreamWriter::Write(const char *data, size_t len)
+{
+    /* 长度为 0 的 chunk 表示结束, 不能由调用者写出 */
+    if (len == 0)
+    {
+        return;
+    }
+    if (chunked)
+    {
+        ChunkHeader(len);
+    }
+    chain.Append(data, len);
+    if (chunked)
+    {
+        /* 拷贝进同一小块, 与下一个 chunk 头合并为一个 iovec */
+        chain.Append("\r\n", 2);
+    }
+}
+
+void StreamWriter::Write(const std::string &str)
+{
+    Write(str.data(), str.size());
+}
+
+void StreamWriter::WriteShared(const std::shared_ptr<const void> &owner, const char *data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    if (chunked)
+    {
+        ChunkHeader(len);
+    }
+    chain.AppendShared(owner, data, len);
+    if (chunked)
+    {
+        chain.AppendStatic("\r\n", 2);
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef STREAM_WRITER_H
+#define STREAM_WRITER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "../buffer/bufferchain.h"
+
+/*
+ * 流式响应的挂起与唤醒, 每个连接一个.
+ * 数据源暂时没有内容时连接挂起, 不再等可写事件(空闲套接字总是可写, 否则工作线程空转);
+ * 数据源有了内容后在任意线程调用 StreamWriter::Waker() 取得的函数, 由主线程重新注册可写事件
+ */
+struct StreamWake
+{
+    enum STATE
+    {
+        RUNNING = 0,
+        PARKED,  /* 已挂起, 没有注册可写事件 */
+        WOKEN,   /* 已唤醒, 等主线程或工作线程重新注册 */
+        CLOSED,  /* 连接已关闭, 之后的唤醒什么都不做 */
+    };
+
+    explicit StreamWake(int fd) : fd(fd), state(RUNNING) {}
+
+    const int fd;
+    std::atomic<int> state;
+
+    /* 由服务器设置: 把挂起后被唤醒的连接交给主线程, 可在任意线程调用 */
+    static std::function<void(const std::shared_ptr<StreamWake> &)> notify;
+};
+typedef std::shared_ptr<StreamWake> StreamWakeRef;
+
+/* 流式响应的输出端, 每次 Write 成为一个 chunk; 非 chunked 时(短连接)原样输出 */
+class StreamWriter
+{
+public:
+    StreamWriter(BufferChain &chain, bool chunked, StreamWakeRef wake = nullptr)
+        : chain(chain), chunked(chunked), wake(std::move(wake)) {}
+
+    void Write(const char *data, size_t len);
+    void Write(const std::string &str);
+
+    /* 引用计数持有的内容, 不拷贝 */
+    void WriteShared(const std::shared_ptr<const void> &owner, const char *data, size_t len);
+
+    /* 发送链中尚未写出的字节数 */
+    size_t Buffered() const { return chain.ReadableBytes(); }
+
+    /* 数据源没有内容可写时先取得唤醒函数再返回; 有了内容后调用它, 连接重新开始发送. 可保存并在任意线程调用 */
+    std::function<void()> Waker() const;
+
+private:
+    void ChunkHeader(size_t len);
+
+    BufferChain &chain;
+    bool chunked;
+    StreamWakeRef wake;
+};
+
+/* 数据源: 每次调用写入一段内容, 返回 false 表示全部写完.
+   发送链低于水位时才会再次调用, 由套接字可写驱动, 慢客户端不会让内容在内存中堆积;
+   一次什么都不写则连接挂起, 直到调用 Waker() 返回的函数 */
+typedef std::function<bool(StreamWriter &writer)> StreamProducer;
+
+#endif // STREAM_WRITER_H
@@ -0,0 +1,414 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "hpack.h"
+#include <string.h>
+
+using namespace std;
+
+namespace
+{
+    struct HuffNode
+    {
+        int16_t child[2];
+        int16_t sym;
+    };
+
+    /* 由编码表建出的解码树, 首次使用时构造 */
+    const vector<HuffNode> &HuffTree()
+    {
+        static const vector<HuffNode> tree = [] {
+            vector<HuffNode> nodes(1, HuffNode{{-1, -1}, -1});
+            for (int sym = 0; sym < 257; sym++)
+            {
+                uint32_t code = HPACK_HUFFMAN_CODES[sym];
+                int bits = HPACK_HUFFMAN_BITS[sym];
+                size_t cur = 0;
+                for (int i = bits - 1; i >= 0; i--)
+                {
+                    int bit = (code >> i) & 1;
+                    if (nodes[cur].child[bit] < 0)
+                    {
+                        nodes[cur].child[bit] = static_cast<int16_t>(nodes.size());
+                        nodes.push_back(HuffNode{{-1, -1}, -1});
+                    }
+                    cur = nodes[cur].child[bit];
+                }
+                nodes[cur].sym = static_cast<int16_t>(sym);
+            }
+            return nodes;
+        }();
+        return tree;
+    }
+}
+
+void HpackEncodeInt(string &out, uint64_t value, int prefix, uint8_t first)
+{
+    uint64_t mask = (1u << prefix) - 1;
+    if (value < mask)
+    {
+        out += static_cast<char>(first | value);
+        return;
+    }
+    out += static_cast<char>(first | mask);
+    value -= mask;
+    while (value >= 128)
+    {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool HpackDecodeInt(const uint8_t *&p, const uint8_t *end, int prefix, uint64_t &value)
+{
+    if (p >= end)
+    {
+        return false;
+    }
+    uint64_t mask = (1u << prefix) - 1;
+    value = *p++ & mask;
+    if (value < mask)
+    {
+        return true;
+    }
+    int shift = 0;
+    uint8_t b;
+    do
+    {
+        if (p >= end || shift > 56)
+        {
+            return false;
+        }
+        b = *p++;
+        value += static_cast<uint64_t>(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return true;
+}
+
+size_t HuffmanLength(const char *str, size_t len)
+{
+    size_t bits = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        bits += HPACK_HUFFMAN_BITS[static_cast<uint8_t>(str[i])];
+    }
+    return (bits + 7) / 8;
+}
+
+void HuffmanEncode(string &out, const char *str, size_t len)
+{
+    uint64_t acc = 0;
+    int n = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t sym = static_cast<uint8_t>(str[i]);
+        acc = (acc << HPACK_HUFFMAN_BITS[sym]) | HPACK_HUFFMAN_CODES[sym];
+        n += HPACK_HUFFMAN_BITS[sym];
+        while (n >= 8)
+        {
+            n -= 8;
+            out += static_cast<char>(acc >> n);
+        }
+        acc &= (1ull << n) - 1;
+    }
+    if (n > 0)
+    {
+        /* 用 EOS 的高位(全 1)补齐 */
+        out += static_cast<char>((acc << (8 - n)) | ((1u << (8 - n)) - 1));
+    }
+}
+
+bool HuffmanDecode(const uint8_t *data, size_t len, string &out)
+{
+    const vector<HuffNode> &tree = HuffTree();
+    int node = 0;
+    int pending = 0;     /* 上一个符号之后的位数 */
+    bool allOnes = true; /* 这些位是否全为 1 */
+    for (size_t i = 0; i < len; i++)
+    {
+        for (int bit = 7; bit >= 0; bit--)
+        {
+            int b = (data[i] >> bit) & 1;
+            node = tree[node].child[b];
+            if (node < 0)
+            {
+                return false;
+            }
+            pending++;
+            allOnes = allOnes && b;
+            if (tree[node].sym >= 0)
+            {
+                if (tree[node].sym == 256)
+                {
+                    return false;
+                }
+                out += static_cast<char>(tree[node].sym);
+                node = 0;
+                pending = 0;
+                allOnes = true;
+            }
+        }
+    }
+    /* 填充不超过 7 位且必须是 EOS 的前缀 */
+    return pending <= 7 && allOnes;
+}
+
+HpackTable::HpackTable(size_t maxSize) : size(0), maxSize(maxSize) {}
+
+void HpackTable::SetMaxSize(size_t maxSize)
+{
+    this->maxSize = maxSize;
+    Evict(maxSize);
+}
+
+void HpackTable::Evict(size_t limit)
+{
+    while (size > limit && !entries.empty())
+    {
+        size -= entries.back().first.size() + entries.back().second.size() + 32;
+        entries.pop_back();
+    }
+}
+
+void HpackTable::Add(const string &name, const string &value)
+{
+    size_t entrySize = name.size() + value.size() + 32;
+    if (entrySize > maxSize)
+    {
+        /* 比整张表还大的条目会清空表 */
+        Evict(0);
+        return;
+    }
+    Evict(maxSize - entrySize);
+    entries.emplace_front(name, value);
+    size += entrySize;
+}
+
+bool HpackTable::Get(size_t index, const char *&name, size_t &nameLen, const char *&value, size_t &valueLen) const
+{
+    if (index == 0)
+    {
+        return false;
+    }
+    if (index <= HPACK_STATIC_COUNT)
+    {
+        const HpackHeader &h = HPACK_STATIC_TABLE[index - 1];
+        name = h.name;
+        nameLen = strlen(h.name);
+        value = h.value;
+        valueLen = strlen(h.value);
+        return true;
+    }
+    index -= HPACK_STATIC_COUNT + 1;
+    if (index >= entries.size())
+    {
+        return false;
+    }
+    name = entries[index].first.data();
+    nameLen = entries[index].first.size();
+    value = entries[index].second.data();
+    valueLen = entries[index].second.size();
+    return true;
+}
+
+size_t HpackTable::Find(const char *name, const char *value, size_t valueLen, size_t *nameIndex) const
+{
+    *nameIndex = 0;
+    for (size_t i = 0; i < HPACK_STATIC_COUNT; i++)
+    {
+        const HpackHeader &h = HPACK_STATIC_TABLE[i];
+        if (strcmp(h.name, name) != 0)
+        {
+            continue;
+        }
+        if (strlen(h.value) == valueLen && memcmp(h.value, value, valueLen) == 0)
+        {
+            return i + 1;
+        }
+        if (*nameIndex == 0)
+        {
+            *nameIndex = i + 1;
+        }
+    }
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].first != name)
+        {
+            continue;
+        }
+        if (entries[i].second.size() == valueLen && memcmp(entries[i].second.data(), value, valueLen) == 0)
+        {
+            return HPACK_STATIC_COUNT + 1 + i;
+        }
+        if (*nameIndex == 0)
+        {
+            *nameIndex = HPACK_STATIC_COUNT + 1 + i;
+        }
+    }
+    return 0;
+}
+
+bool HpackDecoder::DecodeString(const uint8_t *&p, const uint8_t *end, string &out)
+{
+    if (p >= end)
+    {
+        return false;
+    }
+    bool huffman = *p & 0x80;
+    uint64_t len;
+    if (!HpackDecodeInt(p, end, 7, len) || len > static_cast<uint64_t>(end - p))
+    {
+        return false;
+    }
+    out.clear();
+    if (huffman)
+    {
+        if (!HuffmanDecode(p, len, out))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        out.assign(reinterpret_cast<const char *>(p), len);
+    }
+    p += len;
+    return true;
+}
+
+bool HpackDecoder::AddListSize(size_t nameLen, size_t valueLen)
+{
+    /* 少量编码字节可以引用动态表中的大字段, 必须按解码后的大小限制 */
+    listSize += nameLen + valueLen + 32;
+    if (listSize > maxListSize)
+    {
+        listTooLarge = true;
+        return false;
+    }
+    return true;
+}
+
+bool HpackDecoder::Decode(const uint8_t *data, size_t len, HeaderList &headers)
+{
+    const uint8_t *p = data, *end = data + len;
+    listSize = 0;
+    listTooLarge = false;
+    bool seenHeader = false;
+    const char *name, *value;
+    size_t nameLen, valueLen;
+    while (p < end)
+    {
+        uint8_t b = *p;
+        uint64_t index;
+        if (b & 0x80)
+        {
+            /* 索引字段 */
+            if (!HpackDecodeInt(p, end, 7, index) || !table.Get(index, name, nameLen, value, valueLen) ||
+                !AddListSize(nameLen, valueLen))
+            {
+                return false;
+            }
+            headers.emplace_back(string(name, nameLen), string(value, valueLen));
+        }
+        else if ((b & 0xe0) == 0x20)
+        {
+            /* 动态表大小更新, 只能出现在头部块开头 */
+            if (seenHeader || !HpackDecodeInt(p, end, 5, index) || index > settingsMax)
+            {
+                return false;
+            }
+            table.SetMaxSize(index);
+            continue;
+        }
+        else
+        {
+            /* 字面量: 01 加入动态表, 0000 不加入, 0001 永不加入 */
+            bool addIndex = (b & 0x40) != 0;
+            if (!HpackDecodeInt(p, end, addIndex ? 6 : 4, index))
+            {
+                return false;
+            }
+            headers.emplace_back();
+            if (index)
+            {
+                if (!table.Get(index, name, nameLen, value, valueLen))
+                {
+                    return false;
+                }
+                headers.back().first.assign(name, nameLen);
+            }
+            else if (!DecodeString(p, end, headers.back().first))
+            {
+                return false;
+            }
+            if (!DecodeString(p, end, headers.back().second) ||
+                !AddListSize(headers.back().first.size(), headers.back().second.size()))
+            {
+                return false;
+            }
+            if (addIndex)
+            {
+                table.Add(headers.back().first, headers.back().second);
+            }
+        }
+        seenHeader = true;
+    }
+    return true;
+}
+
+void HpackEncoder::SetMaxTableSize(size_t size)
+{
+    /* 编码端最多用 4096 字节, 对端允许更大也不用 */
+    table.SetMaxSize(min(size, static_cast<size_t>(4096)));
+    pendingUpdate = true;
+}
+
+void HpackEncoder::EncodeString(string &out, const char *str, size_t len)
+{
+    size_t hlen = HuffmanLength(str, len);
+    if (hlen < len)
+    {
+        HpackEncodeInt(out, hlen, 7, 0x80);
+        HuffmanEncode(out, str, len);
+    }
+    else
+    {
+        HpackEncodeInt(out, len, 7, 0);
+        out.append(str, len);
+    }
+}
+
+void HpackEncoder::Encode(string &out, const char *name, const char *value, size_t valueLen, bool index)
+{
+    if (pendingUpdate)
+    {
+        HpackEncodeInt(out, table.MaxSize(), 5, 0x20);
+        pendingUpdate = false;
+    }
+    size_t nameIndex;
+    size_t idx = table.Find(name, value, valueLen, &nameIndex);
+    if (idx)
+    {
+        HpackEncodeInt(out, idx, 7, 0x80);
+        return;
+    }
+    HpackEncodeInt(out, nameIndex, index ? 6 : 4, index ? 0x40 : 0);
+    if (nameIndex == 0)
+    {
+        EncodeString(out, name, strlen(name));
+    }
+    EncodeString(out, value, valueLen);
+    if (index)
+    {
+        table.Add(name, string(value, valueLen));
+    }
+}
+
+void HpackEncoder::Encode(string &out, const char *name, const string &value, bool index)
+{
+    Encode(out, name, value.data(), value.size(), index);
+}
@@ -0,0 +1,106 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef HPACK_H
+#define HPACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+
+struct HpackHeader
+{
+    const char *name;
+    const char *value;
+};
+
+const size_t HPACK_STATIC_COUNT = 61;
+extern const HpackHeader HPACK_STATIC_TABLE[HPACK_STATIC_COUNT];
+extern const uint32_t HPACK_HUFFMAN_CODES[257];
+extern const uint8_t HPACK_HUFFMAN_BITS[257];
+
+typedef std::vector<std::pair<std::string, std::string>> HeaderList;
+
+/* 动态表: 新条目在前, 条目大小为 name + value + 32 */
+class HpackTable
+{
+public:
+    explicit HpackTable(size_t maxSize = 4096);
+
+    void SetMaxSize(size_t maxSize);
+    size_t MaxSize() const { return maxSize; }
+    size_t Size() const { return size; }
+    size_t Count() const { return entries.size(); }
+
+    void Add(const std::string &name, const std::string &value);
+
+    /* 索引从 1 开始, 先静态表后动态表 */
+    bool Get(size_t index, const char *&name, size_t &nameLen, const char *&value, size_t &valueLen) const;
+
+    /* 返回完全匹配的索引, 只匹配名字时写入 nameIndex; 都没有返回 0 */
+    size_t Find(const char *name, const char *value, size_t valueLen, size_t *nameIndex) const;
+
+private:
+    void Evict(size_t limit);
+
+    std::deque<std::pair<std::string, std::string>> entries;
+    size_t size;
+    size_t maxSize;
+};
+
+class HpackDecoder
+{
+public:
+    /* 解码一个完整的头部块, 格式错误(COMPRESSION_ERROR)返回 false */
+    bool Decode(const uint8_t *data, size_t len, HeaderList &headers);
+
+    /* 本端 SETTINGS_HEADER_TABLE_SIZE, 对端的表大小更新不能超过它 */
+    void SetMaxTableSize(size_t size) { settingsMax = size; }
+
+    /* 本端 SETTINGS_MAX_HEADER_LIST_SIZE: 解码后每个字段按 name + value + 32 计, 超出时 Decode 失败 */
+    void SetMaxListSize(size_t size) { maxListSize = size; }
+    /* 上次 Decode 失败是因为超出 maxListSize, 而不是格式错误 */
+    bool ListTooLarge() const { return listTooLarge; }
+
+private:
+    bool DecodeString(const uint8_t *&p, const uint8_t *end, std::string &out);
+    bool AddListSize(size_t nameLen, size_t valueLen);
+
+    HpackTable table;
+    size_t settingsMax = 4096;
+    size_t maxListSize = SIZE_MAX;
+    size_t listSize = 0;
+    bool listTooLarge = false;
+};
+
+class HpackEncoder
+{
+public:
+    /* 对端 SETTINGS_HEADER_TABLE_SIZE, 在下一个头部块开头通知对端 */
+    void SetMaxTableSize(size_t size);
+
+    /* index 为 true 时加入动态表, 适合在多个响应间重复的字段 */
+    void Encode(std::string &out, const char *name, const char *value, size_t valueLen, bool index);
+    void Encode(std::string &out, const char *name, const std::string &value, bool index);
+
+private:
+    void EncodeString(std::string &out, const char *str, size_t len);
+
+    HpackTable table;
+    bool pendingUpdate = false;
+};
+
+/* N 位前缀整数, first 为首字节中前缀以外的高位 */
+void HpackEncodeInt(std::string &out, uint64_t value, int prefix, uint8_t first);
+bool HpackDecodeInt(const uint8_t *&p, const uint8_t *end, int prefix, uint64_t &value);
+
+size_t HuffmanLength(const char *str, size_t len);
+void HuffmanEncode(std::string &out, const char *str, size_t len);
+bool HuffmanDecode(const uint8_t *data, size_t len, std::string &out);
+
+#endif // HPACK_H
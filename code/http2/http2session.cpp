@@ -0,0 +1,923 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "http2session.h"
+#include "../http/filecache.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+const char H2_PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+namespace
+{
+    const int64_t H2_MAX_WINDOW = 0x7fffffff;
+    const uint32_t H2_DEFAULT_WINDOW = 65535;
+    const uint32_t H2_DEFAULT_FRAME = 16384;
+
+    uint32_t ReadU32(const uint8_t *p)
+    {
+        return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+
+    void WriteU32(char *p, uint32_t v)
+    {
+        p[0] = static_cast<char>(v >> 24);
+        p[1] = static_cast<char>(v >> 16);
+        p[2] = static_cast<char>(v >> 8);
+        p[3] = static_cast<char>(v);
+    }
+
+    bool Base64UrlDecode(StrRef in, string &out)
+    {
+        uint32_t acc = 0;
+        int bits = 0;
+        for (size_t i = 0; i < in.len; i++)
+        {
+            char ch = in.data[i];
+            int v;
+            if (ch >= 'A' && ch <= 'Z')
+                v = ch - 'A';
+            else if (ch >= 'a' && ch <= 'z')
+                v = ch - 'a' + 26;
+            else if (ch >= '0' && ch <= '9')
+                v = ch - '0' + 52;
+            else if (ch == '-' || ch == '+')
+                v = 62;
+            else if (ch == '_' || ch == '/')
+                v = 63;
+            else if (ch == '=')
+                break;
+            else
+                return false;
+            acc = (acc << 6) | v;
+            bits += 6;
+            if (bits >= 8)
+            {
+                bits -= 8;
+                out += static_cast<char>(acc >> bits);
+            }
+        }
+        return true;
+    }
+
+    /* 字段名必须小写且不含控制字符; 值中的 CR/LF/NUL 会破坏转换出的 HTTP/1.1 请求 */
+    bool ValidField(const string &name, const string &value)
+    {
+        if (name.empty())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            unsigned char ch = name[i];
+            if (ch <= 0x20 || ch >= 0x7f || (ch >= 'A' && ch <= 'Z') || (ch == ':' && i > 0))
+            {
+                return false;
+            }
+        }
+        return value.find_first_of(string("\r\n\0", 3)) == string::npos;
+    }
+
+    /* 只在 HTTP/1.1 中有意义的逐跳头部, 出现即为格式错误 */
+    bool IsConnectionHeader(const string &name)
+    {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+               name == "transfer-encoding" || name == "upgrade";
+    }
+}
+
+struct Http2Session::Stream
+{
+    uint32_t id;
+    bool remoteClosed; /* 已收到 END_STREAM */
+    bool responded;    /* 响应头已发出 */
+    bool finished;     /* 响应已带 END_STREAM 发完 */
+    int64_t sendWindow;
+    int64_t recvWindow;
+    size_t recvConsumed;
+
+    Buffer in;          /* 转换出的 HTTP/1.1 请求, 请求体按 chunked 追加 */
+    HttpRequest request;
+    HttpResponse response;
+    BufferChain body;   /* 待发送的响应体, 按窗口切成 DATA 帧 */
+
+    Stream(uint32_t id, int64_t window)
+        : id(id), remoteClosed(false), responded(false), finished(false),
+          sendWindow(window), recvWindow(H2_DEFAULT_WINDOW), recvConsumed(0), in(256) {}
+};
+
+Http2Session::Http2Session(const char *srcDir, const Router *router)
+    : srcDir(srcDir), router(router), prefaceDone(false), settingsSent(false), goawaySent(false),
+      goawayReceived(false), headerStream(0), headerEndStream(false), lastStreamId(0), lastScheduled(0),
+      sendWindow(H2_DEFAULT_WINDOW), recvWindow(H2_DEFAULT_WINDOW), recvConsumed(0),
+      peerInitialWindow(H2_DEFAULT_WINDOW), peerMaxFrame(H2_DEFAULT_FRAME)
+{
+    assert(srcDir);
+    decoder.SetMaxListSize(MAX_HEADER_LIST);
+}
+
+Http2Session::~Http2Session() = default;
+
+bool Http2Session::Process(Buffer &in, BufferChain &out)
+{
+    if (goawaySent)
+    {
+        in.RetrieveAll();
+        return false;
+    }
+    if (!settingsSent)
+    {
+        SendSettings(out);
+    }
+    if (!prefaceDone)
+    {
+        size_t n = min(in.ReadableBytes(), H2_PREFACE_LEN);
+        if (memcmp(in.Peek(), H2_PREFACE, n) != 0)
+        {
+            in.RetrieveAll();
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        if (n < H2_PREFACE_LEN)
+        {
+            return true;
+        }
+        in.Retrieve(H2_PREFACE_LEN);
+        prefaceDone = true;
+    }
+
+    bool ok = true;
+    while (ok && in.ReadableBytes() >= H2_FRAME_HEADER_LEN)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(in.Peek());
+        size_t len = (p[0] << 16) | (p[1] << 8) | p[2];
+        uint32_t id = ReadU32(p + 5) & 0x7fffffff;
+        if (len > H2_DEFAULT_FRAME)
+        {
+            /* 本端未调整 SETTINGS_MAX_FRAME_SIZE */
+            ok = GoAway(H2_FRAME_SIZE_ERROR, out);
+            break;
+        }
+        if (in.ReadableBytes() < H2_FRAME_HEADER_LEN + len)
+        {
+            break;
+        }
+        ok = OnFrame(p[3], p[4], id, p + H2_FRAME_HEADER_LEN, len, out);
+        in.Retrieve(H2_FRAME_HEADER_LEN + len);
+    }
+    if (!ok)
+    {
+        in.RetrieveAll();
+        return false;
+    }
+
+    /* 请求体已交给 HttpRequest, 一轮结束后统一补窗口 */
+    char inc[4];
+    if (recvConsumed > 0)
+    {
+        WriteFrameHeader(out, 4, H2_WINDOW_UPDATE, 0, 0);
+        WriteU32(inc, static_cast<uint32_t>(recvConsumed));
+        out.Append(inc, 4);
+        recvWindow += recvConsumed;
+        recvConsumed = 0;
+    }
+    for (auto &it : streams)
+    {
+        Stream &s = *it.second;
+        if (s.recvConsumed > 0 && !s.remoteClosed)
+        {
+            WriteFrameHeader(out, 4, H2_WINDOW_UPDATE, 0, s.id);
+            WriteU32(inc, static_cast<uint32_t>(s.recvConsumed));
+            out.Append(inc, 4);
+            s.recvWindow += s.recvConsumed;
+        }
+        s.recvConsumed = 0;
+    }
+    if (goawayReceived && streams.empty())
+    {
+        GoAway(H2_NO_ERROR, out);
+    }
+    return true;
+}
+
+bool Http2Session::OnFrame(uint8_t type, uint8_t flags, uint32_t id, const uint8_t *payload, size_t len,
+                           BufferChain &out)
+{
+    if (headerStream && (type != H2_CONTINUATION || id != headerStream))
+    {
+        /* 头部块必须连续 */
+        return GoAway(H2_PROTOCOL_ERROR, out);
+    }
+    switch (type)
+    {
+    case H2_DATA:
+        return OnData(id, flags, payload, len, out);
+    case H2_HEADERS:
+    {
+        if (id == 0 || (id & 1) == 0)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        size_t pad = 0;
+        if (flags & H2_FLAG_PADDED)
+        {
+            if (len < 1)
+            {
+                return GoAway(H2_PROTOCOL_ERROR, out);
+            }
+            pad = payload[0];
+            payload++;
+            len--;
+        }
+        if (flags & H2_FLAG_PRIORITY)
+        {
+            /* 不按优先级调度, 跳过依赖与权重 */
+            if (len < 5)
+            {
+                return GoAway(H2_PROTOCOL_ERROR, out);
+            }
+            payload += 5;
+            len -= 5;
+        }
+        if (pad > len)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        headerBlock.assign(reinterpret_cast<const char *>(payload), len - pad);
+        if (flags & H2_FLAG_END_HEADERS)
+        {
+            return OnHeaders(id, flags & H2_FLAG_END_STREAM, out);
+        }
+        headerStream = id;
+        headerEndStream = flags & H2_FLAG_END_STREAM;
+        return true;
+    }
+    case H2_CONTINUATION:
+        if (!headerStream)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        if (headerBlock.size() + len > MAX_HEADER_BLOCK)
+        {
+            return GoAway(H2_ENHANCE_YOUR_CALM, out);
+        }
+        headerBlock.append(reinterpret_cast<const char *>(payload), len);
+        if (flags & H2_FLAG_END_HEADERS)
+        {
+            headerStream = 0;
+            return OnHeaders(id, headerEndStream, out);
+        }
+        return true;
+    case H2_PRIORITY:
+        if (id == 0)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        if (len != 5)
+        {
+            ResetStream(id, H2_FRAME_SIZE_ERROR, out);
+        }
+        return true;
+    case H2_RST_STREAM:
+        if (id == 0 || id > lastStreamId)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        if (len != 4)
+        {
+            return GoAway(H2_FRAME_SIZE_ERROR, out);
+        }
+        streams.erase(id);
+        return true;
+    case H2_SETTINGS:
+        if (id != 0)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        return OnSettings(flags, payload, len, out);
+    case H2_PING:
+        if (id != 0)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        if (len != 8)
+        {
+            return GoAway(H2_FRAME_SIZE_ERROR, out);
+        }
+        if (!(flags & H2_FLAG_ACK))
+        {
+            WriteFrameHeader(out, 8, H2_PING, H2_FLAG_ACK, 0);
+            out.Append(reinterpret_cast<const char *>(payload), 8);
+        }
+        return true;
+    case H2_GOAWAY:
+        if (id != 0)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        /* 已开始的流照常回复, 全部结束后关闭 */
+        goawayReceived = true;
+        return true;
+    case H2_WINDOW_UPDATE:
+        return OnWindowUpdate(id, payload, len, out);
+    case H2_PUSH_PROMISE:
+        /* 客户端不能推送 */
+        return GoAway(H2_PROTOCOL_ERROR, out);
+    default:
+        /* 未知类型的帧忽略 */
+        return true;
+    }
+}
+
+bool Http2Session::OnHeaders(uint32_t id, bool endStream, BufferChain &out)
+{
+    /* HPACK 状态是连接级的, 即使流被拒绝也必须解码 */
+    static thread_local HeaderList headers;
+    headers.clear();
+    if (!decoder.Decode(reinterpret_cast<const uint8_t *>(headerBlock.data()), headerBlock.size(), headers))
+    {
+        /* 超出大小时动态表已与对端不一致, 同样只能关闭连接 */
+        return GoAway(decoder.ListTooLarge() ? H2_ENHANCE_YOUR_CALM : H2_COMPRESSION_ERROR, out);
+    }
+
+    auto it = streams.find(id);
+    if (it != streams.end())
+    {
+        /* 请求体之后的尾部头部, 只用来结束请求 */
+        Stream &s = *it->second;
+        if (s.remoteClosed || !endStream)
+        {
+            ResetStream(id, s.remoteClosed ? H2_STREAM_CLOSED : H2_PROTOCOL_ERROR, out);
+            streams.erase(it);
+            return true;
+        }
+        s.remoteClosed = true;
+        if (!s.responded)
+        {
+            s.in.Append("0\r\n\r\n", 5);
+            Feed(s, out);
+        }
+        return true;
+    }
+    if (id <= lastStreamId)
+    {
+        /* 本端已重置的流, 对端可能还在发送, 忽略 */
+        return true;
+    }
+    lastStreamId = id;
+    if (goawayReceived || streams.size() >= MAX_CONCURRENT_STREAMS)
+    {
+        ResetStream(id, H2_REFUSED_STREAM, out);
+        return true;
+    }
+
+    unique_ptr<Stream> stream(new Stream(id, peerInitialWindow));
+    stream->remoteClosed = endStream;
+    if (!BuildRequest(*stream, headers, endStream))
+    {
+        ResetStream(id, H2_PROTOCOL_ERROR, out);
+        return true;
+    }
+    Stream &s = *stream;
+    streams[id] = std::move(stream);
+    Feed(s, out);
+    return true;
+}
+
+bool Http2Session::BuildRequest(Stream &stream, const HeaderList &headers, bool endStream)
+{
+    /* 伪头部在前, 转换成请求行 */
+    const string *method = nullptr, *path = nullptr, *authority = nullptr;
+    bool regular = false, host = false;
+    for (const auto &h : headers)
+    {
+        if (!ValidField(h.first, h.second))
+        {
+            return false;
+        }
+        if (h.first[0] != ':')
+        {
+            regular = true;
+            host = host || h.first == "host";
+            if (IsConnectionHeader(h.first) || (h.first == "te" && h.second != "trailers"))
+            {
+                return false;
+            }
+            continue;
+        }
+        if (regular)
+        {
+            return false;
+        }
+        if (h.first == ":method")
+        {
+            method = &h.second;
+        }
+        else if (h.first == ":path")
+        {
+            path = &h.second;
+        }
+        else if (h.first == ":authority")
+        {
+            authority = &h.second;
+        }
+        else if (h.first != ":scheme")
+        {
+            return false;
+        }
+    }
+    if (!method || !path || method->empty() || path->empty() ||
+        method->find(' ') != string::npos || path->find(' ') != string::npos)
+    {
+        return false;
+    }
+
+    Buffer &in = stream.in;
+    in.Append(*method);
+    in.Append(" ", 1);
+    in.Append(*path);
+    in.Append(" HTTP/1.1\r\n", 11);
+    if (!host && authority)
+    {
+        in.Append("host: ", 6);
+        in.Append(*authority);
+        in.Append("\r\n", 2);
+    }
+    for (const auto &h : headers)
+    {
+        /* 请求体统一按 chunked 追加, 不用 content-length */
+        if (h.first[0] == ':' || h.first == "content-length" || h.first == "te")
+        {
+            continue;
+        }
+        in.Append(h.first);
+        in.Append(": ", 2);
+        in.Append(h.second);
+        in.Append("\r\n", 2);
+    }
+    if (!endStream)
+    {
+        in.Append("transfer-encoding: chunked\r\n", 28);
+    }
+    in.Append("\r\n", 2);
+    return true;
+}
+
+void Http2Session::Feed(Stream &stream, BufferChain &out)
+{
+    HttpRequest::HTTP_CODE ret = stream.request.parse(stream.in);
+    if (ret == HttpRequest::NO_REQUEST)
+    {
+        return;
+    }
+    int code = 200;
+    if (ret != HttpRequest::GET_REQUEST)
+    {
+        code = ret == HttpRequest::ENTITY_TOO_LARGE ? 413 : ret == HttpRequest::INTERNAL_ERROR ? 500 : 400;
+    }
+    Respond(stream, stream.request, code, out);
+}
+
+void Http2Session::Respond(Stream &stream, HttpRequest &request, int code, BufferChain &out)
+{
+    HttpResponse &response = stream.response;
+    uint64_t start = Metrics::Now();
+    /* 按非长连接初始化, 流式响应不加 chunked 编码, 由 DATA 帧分界 */
+    response.Init(srcDir, request.GetPath(), false, code, request.GetMethodId());
+    if (code == 200)
+    {
+        if (router)
+        {
+            router->Dispatch(request, response);
+        }
+        else
+        {
+            Router::ServeStatic(request, response);
+        }
+    }
+    response.Resolve();
+
+    /* HEAD 与 1xx/204/304 只发头部 */
+    bool noBody = request.GetMethodId() == METHOD_HEAD || !response.HasBody();
+    if (noBody)
+    {
+        response.StopStream();
+    }
+    bool empty = noBody || (!response.IsStreaming() && response.BodyLen() == 0);
+    if (!empty && !response.IsStreaming())
+    {
+        response.AppendBody(stream.body);
+    }
+    SendHeaders(stream, empty, out);
+    Metrics::Observe(MH_HANDLE, Metrics::Now() - start);
+    Metrics::Status(response.Code());
+    stream.responded = true;
+    stream.in.RetrieveAll();
+    if (empty)
+    {
+        CloseStream(stream.id, out);
+    }
+}
+
+void Http2Session::SendHeaders(Stream &stream, bool endStream, BufferChain &out)
+{
+    HttpResponse &response = stream.response;
+    scratch.clear();
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%d", response.Code());
+    encoder.Encode(scratch, ":status", num, n, false);
+    const MimeType *type = response.ContentType();
+    encoder.Encode(scratch, "content-type", type->type, strlen(type->type), true);
+    if (!response.IsStreaming() && response.HasBody())
+    {
+        n = snprintf(num, sizeof(num), "%zu", response.BodyLen());
+        encoder.Encode(scratch, "content-length", num, n, false);
+    }
+    if (!response.Allow().empty())
+    {
+        encoder.Encode(scratch, "allow", response.Allow(), false);
+    }
+    /* "Date: ...\r\n" 取出值, 同一秒内的响应都命中动态表 */
+    shared_ptr<const string> date = FileCache::DateLine();
+    encoder.Encode(scratch, "date", date->data() + 6, date->size() - 8, true);
+
+    /* 超过对端帧大小时拆成 HEADERS + CONTINUATION */
+    size_t off = 0;
+    do
+    {
+        size_t len = min(scratch.size() - off, static_cast<size_t>(peerMaxFrame));
+        uint8_t flags = off + len == scratch.size() ? H2_FLAG_END_HEADERS : 0;
+        if (off == 0 && endStream)
+        {
+            flags |= H2_FLAG_END_STREAM;
+        }
+        WriteFrameHeader(out, len, off == 0 ? H2_HEADERS : H2_CONTINUATION, flags, stream.id);
+        out.Append(scratch.data() + off, len);
+        off += len;
+    } while (off < scratch.size());
+}
+
+bool Http2Session::OnData(uint32_t id, uint8_t flags, const uint8_t *payload, size_t len, BufferChain &out)
+{
+    if (id == 0)
+    {
+        return GoAway(H2_PROTOCOL_ERROR, out);
+    }
+    /* 整个帧(含填充)都计入流量控制 */
+    if (static_cast<int64_t>(len) > recvWindow)
+    {
+        return GoAway(H2_FLOW_CONTROL_ERROR, out);
+    }
+    recvWindow -= len;
+    recvConsumed += len;
+
+    auto it = streams.find(id);
+    if (it == streams.end())
+    {
+        /* 已关闭的流上迟到的数据直接丢弃 */
+        return id > lastStreamId ? GoAway(H2_PROTOCOL_ERROR, out) : true;
+    }
+    Stream &s = *it->second;
+    if (s.remoteClosed)
+    {
+        ResetStream(id, H2_STREAM_CLOSED, out);
+        streams.erase(it);
+        return true;
+    }
+    if (static_cast<int64_t>(len) > s.recvWindow)
+    {
+        ResetStream(id, H2_FLOW_CONTROL_ERROR, out);
+        streams.erase(it);
+        return true;
+    }
+    s.recvWindow -= len;
+    s.recvConsumed += len;
+
+    size_t pad = 0;
+    if (flags & H2_FLAG_PADDED)
+    {
+        if (len < 1 || payload[0] >= len)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        pad = payload[0];
+        payload++;
+        len--;
+    }
+    len -= pad;
+    s.remoteClosed = flags & H2_FLAG_END_STREAM;
+    if (s.responded)
+    {
+        /* 已提前回复错误, 其余请求体不再处理 */
+        return true;
+    }
+    if (len > 0)
+    {
+        char line[32];
+        int n = snprintf(line, sizeof(line), "%zx\r\n", len);
+        s.in.Append(line, n);
+        s.in.Append(payload, len);
+        s.in.Append("\r\n", 2);
+    }
+    if (s.remoteClosed)
+    {
+        s.in.Append("0\r\n\r\n", 5);
+    }
+    Feed(s, out);
+    return true;
+}
+
+bool Http2Session::OnSettings(uint8_t flags, const uint8_t *payload, size_t len, BufferChain &out)
+{
+    if (flags & H2_FLAG_ACK)
+    {
+        return len == 0 ? true : GoAway(H2_FRAME_SIZE_ERROR, out);
+    }
+    if (len % 6)
+    {
+        return GoAway(H2_FRAME_SIZE_ERROR, out);
+    }
+    for (size_t i = 0; i < len; i += 6)
+    {
+        if (!ApplySetting((payload[i] << 8) | payload[i + 1], ReadU32(payload + i + 2), out))
+        {
+            return false;
+        }
+    }
+    WriteFrameHeader(out, 0, H2_SETTINGS, H2_FLAG_ACK, 0);
+    return true;
+}
+
+bool Http2Session::ApplySetting(uint16_t id, uint32_t value, BufferChain &out)
+{
+    switch (id)
+    {
+    case H2_SETTINGS_HEADER_TABLE_SIZE:
+        encoder.SetMaxTableSize(value);
+        break;
+    case H2_SETTINGS_ENABLE_PUSH:
+        if (value > 1)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        break;
+    case H2_SETTINGS_INITIAL_WINDOW_SIZE:
+    {
+        if (value > H2_MAX_WINDOW)
+        {
+            return GoAway(H2_FLOW_CONTROL_ERROR, out);
+        }
+        /* 已打开的流按差值调整, 窗口可以变成负数 */
+        int64_t delta = static_cast<int64_t>(value) - peerInitialWindow;
+        for (auto &it : streams)
+        {
+            it.second->sendWindow += delta;
+            if (it.second->sendWindow > H2_MAX_WINDOW)
+            {
+                return GoAway(H2_FLOW_CONTROL_ERROR, out);
+            }
+        }
+        peerInitialWindow = value;
+        break;
+    }
+    case H2_SETTINGS_MAX_FRAME_SIZE:
+        if (value < H2_DEFAULT_FRAME || value > 0xffffff)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        peerMaxFrame = value;
+        break;
+    default:
+        /* 其余设置与未知设置忽略 */
+        break;
+    }
+    return true;
+}
+
+bool Http2Session::OnWindowUpdate(uint32_t id, const uint8_t *payload, size_t len, BufferChain &out)
+{
+    if (len != 4)
+    {
+        return GoAway(H2_FRAME_SIZE_ERROR, out);
+    }
+    uint32_t inc = ReadU32(payload) & 0x7fffffff;
+    if (id == 0)
+    {
+        sendWindow += inc;
+        if (inc == 0)
+        {
+            return GoAway(H2_PROTOCOL_ERROR, out);
+        }
+        return sendWindow > H2_MAX_WINDOW ? GoAway(H2_FLOW_CONTROL_ERROR, out) : true;
+    }
+    auto it = streams.find(id);
+    if (it == streams.end())
+    {
+        return id > lastStreamId ? GoAway(H2_PROTOCOL_ERROR, out) : true;
+    }
+    it->second->sendWindow += inc;
+    if (inc == 0 || it->second->sendWindow > H2_MAX_WINDOW)
+    {
+        ResetStream(id, inc == 0 ? H2_PROTOCOL_ERROR : H2_FLOW_CONTROL_ERROR, out);
+        streams.erase(it);
+    }
+    return true;
+}
+
+void Http2Session::Pump(BufferChain &out)
+{
+    /* 升级后等客户端序言到达再发 DATA, 避免 101 之后一次塞给客户端过多数据 */
+    if (!prefaceDone)
+    {
+        return;
+    }
+    /* 每个流每轮最多一帧, 多个文件的 DATA 帧交错发出 */
+    bool progress = true;
+    while (progress && !goawaySent && !streams.empty() && out.ReadableBytes() < PUMP_LOW_WATER)
+    {
+        progress = false;
+        auto it = streams.upper_bound(lastScheduled);
+        for (size_t i = streams.size(); i > 0 && out.ReadableBytes() < PUMP_LOW_WATER; i--)
+        {
+            if (it == streams.end())
+            {
+                it = streams.begin();
+            }
+            Stream &s = *it->second;
+            ++it;
+            if (!SendData(s, out))
+            {
+                continue;
+            }
+            progress = true;
+            lastScheduled = s.id;
+            if (s.finished)
+            {
+                CloseStream(s.id, out);
+            }
+        }
+    }
+    if (goawayReceived && streams.empty() && !goawaySent)
+    {
+        GoAway(H2_NO_ERROR, out);
+    }
+}
+
+bool Http2Session::SendData(Stream &stream, BufferChain &out)
+{
+    if (!stream.responded || stream.finished)
+    {
+        return false;
+    }
+    /* 帧大小不超过默认值, 让各流交错得更细 */
+    size_t frame = min(peerMaxFrame, H2_DEFAULT_FRAME);
+    if (stream.response.IsStreaming() && stream.body.ReadableBytes() < frame)
+    {
+        stream.response.Pump(stream.body, wake);
+    }
+    bool more = stream.response.IsStreaming();
+    size_t avail = stream.body.ReadableBytes();
+    if (avail == 0 && more)
+    {
+        return false;
+    }
+    if (avail > 0 && (sendWindow <= 0 || stream.sendWindow <= 0))
+    {
+        return false;
+    }
+    size_t len = min(avail, frame);
+    len = min(len, static_cast<size_t>(min(sendWindow, stream.sendWindow)));
+    stream.finished = !more && len == avail;
+    WriteFrameHeader(out, len, H2_DATA, stream.finished ? H2_FLAG_END_STREAM : 0, stream.id);
+    stream.body.MoveTo(out, len);
+    sendWindow -= len;
+    stream.sendWindow -= len;
+    return true;
+}
+
+bool Http2Session::WantWrite() const
+{
+    if (!prefaceDone || goawaySent || sendWindow <= 0)
+    {
+        return false;
+    }
+    for (const auto &it : streams)
+    {
+        const Stream &s = *it.second;
+        if (s.responded && !s.finished && s.sendWindow > 0 &&
+            (s.body.ReadableBytes() > 0 || s.response.IsStreaming()))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Http2Session::CloseStream(uint32_t id, BufferChain &out)
+{
+    auto it = streams.find(id);
+    if (it == streams.end())
+    {
+        return;
+    }
+    if (!it->second->remoteClosed)
+    {
+        /* 响应已发完, 不再接收剩余的请求体 */
+        ResetStream(id, H2_NO_ERROR, out);
+    }
+    streams.erase(it);
+}
+
+bool Http2Session::Upgrade(StrRef settings)
+{
+    string payload;
+    if (!Base64UrlDecode(settings, payload) || payload.size() % 6)
+    {
+        return false;
+    }
+    BufferChain discard;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(payload.data());
+    for (size_t i = 0; i < payload.size(); i += 6)
+    {
+        if (!ApplySetting((p[i] << 8) | p[i + 1], ReadU32(p + i + 2), discard))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Http2Session::UpgradeResponse(HttpRequest &request, BufferChain &out)
+{
+    /* 升级请求视为流 1, 已处于半关闭(远端)状态 */
+    SendSettings(out);
+    lastStreamId = 1;
+    unique_ptr<Stream> stream(new Stream(1, peerInitialWindow));
+    stream->remoteClosed = true;
+    Stream &s = *stream;
+    streams[1] = std::move(stream);
+    Respond(s, request, 200, out);
+}
+
+void Http2Session::SendSettings(BufferChain &out)
+{
+    settingsSent = true;
+    char payload[12] = {0, H2_SETTINGS_MAX_CONCURRENT_STREAMS, 0, 0, 0, 0, 0, H2_SETTINGS_MAX_HEADER_LIST_SIZE};
+    WriteU32(payload + 2, MAX_CONCURRENT_STREAMS);
+    WriteU32(payload + 8, MAX_HEADER_LIST);
+    WriteFrameHeader(out, sizeof(payload), H2_SETTINGS, 0, 0);
+    out.Append(payload, sizeof(payload));
+}
+
+void Http2Session::WriteFrameHeader(BufferChain &out, size_t len, uint8_t type, uint8_t flags, uint32_t id)
+{
+    char header[H2_FRAME_HEADER_LEN];
+    header[0] = static_cast<char>(len >> 16);
+    header[1] = static_cast<char>(len >> 8);
+    header[2] = static_cast<char>(len);
+    header[3] = static_cast<char>(type);
+    header[4] = static_cast<char>(flags);
+    WriteU32(header + 5, id);
+    out.Append(header, sizeof(header));
+}
+
+void Http2Session::ResetStream(uint32_t id, H2_ERROR error, BufferChain &out)
+{
+    char payload[4];
+    WriteU32(payload, error);
+    WriteFrameHeader(out, sizeof(payload), H2_RST_STREAM, 0, id);
+    out.Append(payload, sizeof(payload));
+}
+
+void Http2Session::Drain(BufferChain &out)
+{
+    /* 与收到对端 GOAWAY 相同: 新流被拒绝, 客户端可以安全重试 */
+    goawayReceived = true;
+    if (streams.empty())
+    {
+        GoAway(H2_NO_ERROR, out);
+    }
+}
+
+bool Http2Session::GoAway(H2_ERROR error, BufferChain &out)
+{
+    if (!goawaySent)
+    {
+        goawaySent = true;
+        char payload[8];
+        WriteU32(payload, lastStreamId);
+        WriteU32(payload + 4, error);
+        WriteFrameHeader(out, sizeof(payload), H2_GOAWAY, 0, 0);
+        out.Append(payload, sizeof(payload));
+        LOG_DEBUG("h2 goaway, error %d, last stream %u", error, lastStreamId);
+    }
+    headerStream = 0;
+    if (error != H2_NO_ERROR)
+    {
+        streams.clear();
+    }
+    return false;
+}
@@ -0,0 +1,164 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef HTTP2_SESSION_H
+#define HTTP2_SESSION_H
+
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <memory>
+
+#include "../buffer/buffer.h"
+#include "../buffer/bufferchain.h"
+#include "../http/httprequest.h"
+#include "../http/httpresponse.h"
+#include "../http/router.h"
+#include "../metrics/metrics.h"
+#include "hpack.h"
+
+enum H2_FRAME_TYPE
+{
+    H2_DATA = 0x0,
+    H2_HEADERS = 0x1,
+    H2_PRIORITY = 0x2,
+    H2_RST_STREAM = 0x3,
+    H2_SETTINGS = 0x4,
+    H2_PUSH_PROMISE = 0x5,
+    H2_PING = 0x6,
+    H2_GOAWAY = 0x7,
+    H2_WINDOW_UPDATE = 0x8,
+    H2_CONTINUATION = 0x9,
+};
+
+enum H2_FLAG
+{
+    H2_FLAG_END_STREAM = 0x1,
+    H2_FLAG_ACK = 0x1,
+    H2_FLAG_END_HEADERS = 0x4,
+    H2_FLAG_PADDED = 0x8,
+    H2_FLAG_PRIORITY = 0x20,
+};
+
+enum H2_ERROR
+{
+    H2_NO_ERROR = 0x0,
+    H2_PROTOCOL_ERROR = 0x1,
+    H2_INTERNAL_ERROR = 0x2,
+    H2_FLOW_CONTROL_ERROR = 0x3,
+    H2_STREAM_CLOSED = 0x5,
+    H2_FRAME_SIZE_ERROR = 0x6,
+    H2_REFUSED_STREAM = 0x7,
+    H2_CANCEL = 0x8,
+    H2_COMPRESSION_ERROR = 0x9,
+    H2_ENHANCE_YOUR_CALM = 0xb,
+};
+
+enum H2_SETTING
+{
+    H2_SETTINGS_HEADER_TABLE_SIZE = 0x1,
+    H2_SETTINGS_ENABLE_PUSH = 0x2,
+    H2_SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+    H2_SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+    H2_SETTINGS_MAX_FRAME_SIZE = 0x5,
+    H2_SETTINGS_MAX_HEADER_LIST_SIZE = 0x6,
+};
+
+/* 客户端连接序言, 明文 HTTP/2 直接以它开头 */
+extern const char H2_PREFACE[];
+const size_t H2_PREFACE_LEN = 24;
+const size_t H2_FRAME_HEADER_LEN = 9;
+
+/*
+ * 一个 HTTP/2 连接: 帧解析, HPACK, 流复用与流量控制.
+ * 每个流把头部转换成一条 HTTP/1.1 请求交给自己的 HttpRequest 解析, 再走同一个 Router,
+ * 响应体按流放进各自的发送链, 由 Pump 按帧轮转写入连接的发送链
+ */
+class Http2Session
+{
+public:
+    Http2Session(const char *srcDir, const Router *router);
+    ~Http2Session();
+
+    /* 处理读缓冲区中的完整帧, 控制帧与响应头写入 out; 连接级错误时写出 GOAWAY 并返回 false */
+    bool Process(Buffer &in, BufferChain &out);
+
+    /* 在窗口允许范围内轮转各流, 每次一个 DATA 帧, out 达到水位即停 */
+    void Pump(BufferChain &out);
+
+    /* 还有可以立即发送的响应数据 */
+    bool WantWrite() const;
+
+    /* 已发出 GOAWAY, 发送链写完后关闭连接 */
+    bool IsClosing() const { return goawaySent; }
+
+    size_t StreamCount() const { return streams.size(); }
+
+    /* 连接的唤醒状态, 传给各流的流式数据源 */
+    void SetWake(StreamWakeRef w) { wake = std::move(w); }
+
+    /* 本端停止服务: 不再接受新流, 已打开的流发完后写出 GOAWAY */
+    void Drain(BufferChain &out);
+
+    /* HTTP/1.1 Upgrade: h2c, settings 为 HTTP2-Settings 头部的 base64url 值 */
+    bool Upgrade(StrRef settings);
+    /* 升级请求作为流 1 回复, 须在 101 之后立即调用 */
+    void UpgradeResponse(HttpRequest &request, BufferChain &out);
+
+    static const uint32_t MAX_CONCURRENT_STREAMS = 100;
+    static const size_t MAX_HEADER_BLOCK = 64 * 1024;
+    static const size_t MAX_HEADER_LIST = 64 * 1024; /* 解码后的头部大小, 以 SETTINGS_MAX_HEADER_LIST_SIZE 通告 */
+    static const size_t PUMP_LOW_WATER = 64 * 1024;
+
+private:
+    struct Stream;
+
+    bool OnFrame(uint8_t type, uint8_t flags, uint32_t id, const uint8_t *payload, size_t len, BufferChain &out);
+    bool OnHeaders(uint32_t id, bool endStream, BufferChain &out);
+    bool OnData(uint32_t id, uint8_t flags, const uint8_t *payload, size_t len, BufferChain &out);
+    bool OnSettings(uint8_t flags, const uint8_t *payload, size_t len, BufferChain &out);
+    bool OnWindowUpdate(uint32_t id, const uint8_t *payload, size_t len, BufferChain &out);
+    bool ApplySetting(uint16_t id, uint32_t value, BufferChain &out);
+
+    bool BuildRequest(Stream &stream, const HeaderList &headers, bool endStream);
+    void Feed(Stream &stream, BufferChain &out);
+    void Respond(Stream &stream, HttpRequest &request, int code, BufferChain &out);
+    void SendHeaders(Stream &stream, bool endStream, BufferChain &out);
+    bool SendData(Stream &stream, BufferChain &out);
+    void CloseStream(uint32_t id, BufferChain &out);
+
+    void SendSettings(BufferChain &out);
+    void WriteFrameHeader(BufferChain &out, size_t len, uint8_t type, uint8_t flags, uint32_t id);
+    void ResetStream(uint32_t id, H2_ERROR error, BufferChain &out);
+    bool GoAway(H2_ERROR error, BufferChain &out);
+
+    const char *srcDir;
+    const Router *router;
+
+    bool prefaceDone;
+    bool settingsSent;
+    bool goawaySent;
+    bool goawayReceived;
+
+    HpackDecoder decoder;
+    StreamWakeRef wake;
+    HpackEncoder encoder;
+    std::string headerBlock;   /* HEADERS + CONTINUATION 拼接的头部块 */
+    uint32_t headerStream;     /* 正在接收 CONTINUATION 的流, 0 表示没有 */
+    bool headerEndStream;
+    std::string scratch;       /* 编码响应头用的临时空间 */
+
+    std::map<uint32_t, std::unique_ptr<Stream>> streams;
+    uint32_t lastStreamId;     /* 对端最近打开的流 */
+    uint32_t lastScheduled;    /* 轮转调度的位置 */
+
+    int64_t sendWindow;        /* 连接级发送窗口 */
+    int64_t recvWindow;        /* 连接级接收窗口 */
+    size_t recvConsumed;       /* 本轮已消费, 处理完后一次性 WINDOW_UPDATE */
+    uint32_t peerInitialWindow;
+    uint32_t peerMaxFrame;
+};
+
+#endif // HTTP2_SESSION_H
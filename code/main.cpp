@@ -6,14 +6,17 @@
 #include <unistd.h>
 #include "server/webserver.h"
 
-int main() {
+int main(int argc, char *argv[]) {
     /* 守护进程 后台运行 */
     //daemon(1, 0); 
 
-    WebServer server(
-        1316, 3, 60000, false,             /* 端口 ET模式 timeoutMs 优雅退出  */
-        3306, "root", "SK.2022a", "webserver", /* Mysql配置 */
-        12, 6, true, 1, 1024);             /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+    /* 默认值见 config/config.h; -c 指定配置文件, --key=value 覆盖, --help 列出所有配置项 */
+    ServerConfig config;
+    std::string err;
+    if(!Config::Parse(argc, argv, config, &err)) {
+        fprintf(stderr, "%s\n%s --help lists all settings\n", err.c_str(), argv[0]);
+        return 1;
+    }
+    WebServer server(config);
     server.Start();
 } 
-  
\ No newline at end of file
@@ -0,0 +1,310 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "metrics.h"
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+using namespace std;
+
+namespace
+{
+    const char *PREFIX = "webserver_";
+
+    struct CounterInfo
+    {
+        const char *name;
+        const char *help;
+    };
+
+    const CounterInfo COUNTERS[METRIC_COUNTER_COUNT] = {
+        {"connections_accepted_total", "Accepted connections."},
+        {"connections_rejected_total", "Connections rejected because the server was full."},
+        {"connections_closed_total", "Closed connections."},
+        {"received_bytes_total", "Application bytes read from clients."},
+        {"sent_bytes_total", "Application bytes written to clients."},
+        {"connections_shed_total", "Connections answered 503 because the worker queue delay was too high."},
+        {"client_throttled_total", "Connections or requests refused by per-client limits."},
+        {"timeouts_header_total", "Connections closed because the request header did not complete in time."},
+        {"timeouts_body_total", "Connections closed because the request body arrived too slowly."},
+        {"timeouts_idle_total", "Keep-alive connections closed after idling."},
+        {"timeouts_write_total", "Connections closed because the client stopped reading the response."},
+        {"connections_remote_node_total", "Connections whose receiving CPU is on another NUMA node than the server memory."},
+    };
+
+    struct HistogramInfo
+    {
+        const char *name;
+        const char *phase;
+        const char *help;
+    };
+
+    const HistogramInfo HISTOGRAMS[METRIC_HISTOGRAM_COUNT] = {
+        {"request_parse_seconds", "parse", "Time of the parse call that completed a request."},
+        {"request_handle_seconds", "handle", "Time spent routing a request and building its response."},
+        {"write_seconds", "write", "Time of one write pass over the send chain."},
+        {"sql_pool_wait_seconds", "sql_wait", "Time spent waiting for a free SQL connection."},
+    };
+
+    /* 输出的桶边界: 2^10ns(约 1us) 到 2^36ns, 都是分桶的边界, 累计值精确 */
+    const int EXPORT_MIN_EXP = 10;
+
+    const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+    void AppendHeader(string &out, const char *name, const char *help, const char *type)
+    {
+        out += "# HELP ";
+        out += PREFIX;
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += PREFIX;
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    }
+
+    void AppendSample(string &out, const char *name, const char *suffix, const char *labels, double value)
+    {
+        char num[32];
+        snprintf(num, sizeof(num), "%.9g", value);
+        out += PREFIX;
+        out += name;
+        out += suffix;
+        if (labels && labels[0])
+        {
+            out += '{';
+            out += labels;
+            out += '}';
+        }
+        out += ' ';
+        out += num;
+        out += '\n';
+    }
+}
+
+Histogram::Histogram() : count(0), sum(0)
+{
+    memset(buckets, 0, sizeof(buckets));
+}
+
+uint64_t Histogram::BucketUpper(size_t index)
+{
+    assert(index < BUCKETS);
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+    int exp = static_cast<int>(index / SUB_BUCKETS) + SUB_BITS - 1;
+    uint64_t sub = index % SUB_BUCKETS;
+    uint64_t step = 1ull << (exp - SUB_BITS);
+    return ((SUB_BUCKETS + sub) << (exp - SUB_BITS)) + step - 1;
+}
+
+void Histogram::Record(uint64_t value)
+{
+    buckets[BucketIndex(value)]++;
+    count++;
+    sum += value;
+}
+
+void Histogram::Merge(const Histogram &other)
+{
+    for (size_t i = 0; i < BUCKETS; i++)
+    {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+}
+
+uint64_t Histogram::Percentile(double q) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(ceil(q * count));
+    if (target == 0)
+    {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+        {
+            return BucketUpper(i);
+        }
+    }
+    return BucketUpper(BUCKETS - 1);
+}
+
+Metrics::Metrics() : shardCnt(0), nextShared(0)
+{
+    for (size_t i = 0; i < MAX_SHARDS; i++)
+    {
+        shards[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Metrics *Metrics::Instance()
+{
+    static Metrics metrics;
+    return &metrics;
+}
+
+Metrics::Shard *Metrics::NewShard()
+{
+    lock_guard<mutex> locker(mtx);
+    size_t cnt = shardCnt.load(std::memory_order_relaxed);
+    if (cnt == MAX_SHARDS)
+    {
+        /* 原子加法保证共用分片也不会丢计数 */
+        return shards[nextShared.fetch_add(1, std::memory_order_relaxed) % MAX_SHARDS].load(std::memory_order_relaxed);
+    }
+    /* 值初始化即全部清零; 分片随进程存活, 不释放 */
+    Shard *shard = new Shard();
+    shards[cnt].store(shard, std::memory_order_release);
+    shardCnt.store(cnt + 1, std::memory_order_release);
+    return shard;
+}
+
+void Metrics::AddGauge(const char *name, const char *help, std::function<double()> value)
+{
+    assert(name && help && value);
+    lock_guard<mutex> locker(mtx);
+    gauges.push_back(Gauge{name, help, std::move(value)});
+}
+
+void Metrics::ClearGauges()
+{
+    lock_guard<mutex> locker(mtx);
+    gauges.clear();
+}
+
+uint64_t Metrics::Counter(METRIC_COUNTER counter) const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < ShardCount(); i++)
+    {
+        total += shards[i].load(std::memory_order_acquire)->counters[counter].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t Metrics::StatusCount(int code) const
+{
+    size_t slot = code >= 100 && code < 600 ? code - 100 : STATUS_SLOTS - 1;
+    uint64_t total = 0;
+    for (size_t i = 0; i < ShardCount(); i++)
+    {
+        total += shards[i].load(std::memory_order_acquire)->status[slot].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram Metrics::Snapshot(METRIC_HISTOGRAM histogram) const
+{
+    Histogram result;
+    for (size_t i = 0; i < ShardCount(); i++)
+    {
+        const Shard *shard = shards[i].load(std::memory_order_acquire);
+        for (size_t b = 0; b < Histogram::BUCKETS; b++)
+        {
+            uint64_t n = shard->buckets[histogram][b].load(std::memory_order_relaxed);
+            result.buckets[b] += n;
+            result.count += n;
+        }
+        result.sum += shard->sums[histogram].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+string Metrics::Render() const
+{
+    string out;
+    out.reserve(16 * 1024);
+    char labels[64];
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        AppendHeader(out, COUNTERS[c].name, COUNTERS[c].help, "counter");
+        AppendSample(out, COUNTERS[c].name, "", nullptr, static_cast<double>(Counter(static_cast<METRIC_COUNTER>(c))));
+    }
+
+    AppendHeader(out, "http_responses_total", "HTTP responses by status code.", "counter");
+    for (size_t slot = 0; slot < STATUS_SLOTS; slot++)
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i < ShardCount(); i++)
+        {
+            total += shards[i].load(std::memory_order_acquire)->status[slot].load(std::memory_order_relaxed);
+        }
+        if (total == 0)
+        {
+            continue;
+        }
+        if (slot == STATUS_SLOTS - 1)
+        {
+            snprintf(labels, sizeof(labels), "code=\"other\"");
+        }
+        else
+        {
+            snprintf(labels, sizeof(labels), "code=\"%zu\"", slot + 100);
+        }
+        AppendSample(out, "http_responses_total", "", labels, static_cast<double>(total));
+    }
+
+    /* 直方图按 2 的幂输出累计桶; 分位数用完整精度另外给出 */
+    Histogram snapshots[METRIC_HISTOGRAM_COUNT];
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++)
+    {
+        const char *name = HISTOGRAMS[h].name;
+        Histogram &snap = snapshots[h];
+        snap = Snapshot(static_cast<METRIC_HISTOGRAM>(h));
+        AppendHeader(out, name, HISTOGRAMS[h].help, "histogram");
+        uint64_t cumulative = 0;
+        size_t b = 0;
+        for (int exp = EXPORT_MIN_EXP; exp <= Histogram::MAX_EXP; exp++)
+        {
+            uint64_t bound = 1ull << exp;
+            for (; b < Histogram::BUCKETS && Histogram::BucketUpper(b) < bound; b++)
+            {
+                cumulative += snap.Bucket(b);
+            }
+            snprintf(labels, sizeof(labels), "le=\"%.9g\"", bound / 1e9);
+            AppendSample(out, name, "_bucket", labels, static_cast<double>(cumulative));
+        }
+        AppendSample(out, name, "_bucket", "le=\"+Inf\"", static_cast<double>(snap.Count()));
+        AppendSample(out, name, "_sum", nullptr, snap.Sum() / 1e9);
+        AppendSample(out, name, "_count", nullptr, static_cast<double>(snap.Count()));
+    }
+    AppendHeader(out, "latency_quantile_seconds", "Latency quantiles since start, relative error under 12.5%.", "gauge");
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++)
+    {
+        if (snapshots[h].Count() == 0)
+        {
+            continue;
+        }
+        for (double q : QUANTILES)
+        {
+            snprintf(labels, sizeof(labels), "phase=\"%s\",quantile=\"%g\"", HISTOGRAMS[h].phase, q);
+            AppendSample(out, "latency_quantile_seconds", "", labels, snapshots[h].Percentile(q) / 1e9);
+        }
+    }
+
+    lock_guard<mutex> locker(mtx);
+    for (const Gauge &gauge : gauges)
+    {
+        AppendHeader(out, gauge.name.c_str(), gauge.help.c_str(), "gauge");
+        AppendSample(out, gauge.name.c_str(), "", nullptr, gauge.value());
+    }
+    return out;
+}
@@ -0,0 +1,181 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+
+enum METRIC_COUNTER
+{
+    MC_ACCEPTED = 0,  /* 接受的连接 */
+    MC_REJECTED,      /* 连接数已满被拒绝 */
+    MC_CLOSED,        /* 关闭的连接 */
+    MC_BYTES_IN,      /* 读到的应用层字节 */
+    MC_BYTES_OUT,     /* 写出的应用层字节 */
+    MC_SHED,          /* 线程池排队过久, 新连接直接返回 503 */
+    MC_THROTTLED,     /* 超出单 IP 连接数或速率限制 */
+    MC_TIMEOUT_HEADER, /* 请求头超时, 与 CONN_PHASE 顺序一致 */
+    MC_TIMEOUT_BODY,   /* 请求体速率过低 */
+    MC_TIMEOUT_IDLE,   /* 长连接空闲超时 */
+    MC_TIMEOUT_WRITE,  /* 发送停滞 */
+    MC_REMOTE_NODE,    /* 收包 CPU 与内存不在同一 NUMA 节点, 开启 cpu.incoming 时统计 */
+    METRIC_COUNTER_COUNT
+};
+
+enum METRIC_HISTOGRAM
+{
+    MH_PARSE = 0,     /* 解析出一条完整请求的那次 parse */
+    MH_HANDLE,        /* 路由处理 + 生成响应 */
+    MH_WRITE,         /* 一次 write: writev / SSL_write 循环 */
+    MH_SQL_WAIT,      /* 等待 SqlConnPool 空闲连接 */
+    METRIC_HISTOGRAM_COUNT
+};
+
+/*
+ * HDR 风格的对数-线性分桶, 单位纳秒: 小于 SUB_BUCKETS 的值精确计数,
+ * 之后每个 2 的幂区间再分 SUB_BUCKETS 份, 相对误差不超过 1/SUB_BUCKETS
+ */
+class Histogram
+{
+public:
+    static const int SUB_BITS = 3;
+    static const uint64_t SUB_BUCKETS = 1 << SUB_BITS;
+    static const int MAX_EXP = 36; /* 不小于 2^37ns(约 137s) 的值记入最后一个桶 */
+    static const size_t BUCKETS = (MAX_EXP - SUB_BITS + 2) * SUB_BUCKETS;
+
+    Histogram();
+
+    static size_t BucketIndex(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+        {
+            return value;
+        }
+        int exp = 63 - __builtin_clzll(value);
+        if (exp > MAX_EXP)
+        {
+            return BUCKETS - 1;
+        }
+        return (exp - SUB_BITS + 1) * SUB_BUCKETS + ((value >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1));
+    }
+    /* 桶内最大值(含) */
+    static uint64_t BucketUpper(size_t index);
+
+    void Record(uint64_t value);
+    void Merge(const Histogram &other);
+
+    uint64_t Count() const { return count; }
+    uint64_t Sum() const { return sum; }
+    uint64_t Bucket(size_t index) const { return buckets[index]; }
+    /* 不小于 q(0~1) 比例样本的最小桶上界, 没有样本时为 0 */
+    uint64_t Percentile(double q) const;
+
+private:
+    friend class Metrics;
+
+    uint64_t buckets[BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+};
+
+/*
+ * 进程内指标: 每个线程第一次记录时分到自己的分片, 热路径只有 relaxed 原子加,
+ * 读取时合并所有分片. 瞬时值(连接数/队列长度等)由所有者注册回调, 输出时才读取
+ */
+class Metrics
+{
+public:
+    static Metrics *Instance();
+
+    static void Add(METRIC_COUNTER counter, uint64_t n = 1)
+    {
+        Local()->counters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /* 响应状态码, 100~599 以外的合并输出为 code="other" */
+    static void Status(int code)
+    {
+        size_t slot = code >= 100 && code < 600 ? code - 100 : STATUS_SLOTS - 1;
+        Local()->status[slot].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void Observe(METRIC_HISTOGRAM histogram, uint64_t ns)
+    {
+        Shard *shard = Local();
+        shard->buckets[histogram][Histogram::BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+        shard->sums[histogram].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    /* 单调时钟, 纳秒 */
+    static uint64_t Now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    /* 启动时注册, name 不含前缀 */
+    void AddGauge(const char *name, const char *help, std::function<double()> value);
+    void ClearGauges();
+
+    uint64_t Counter(METRIC_COUNTER counter) const;
+    uint64_t StatusCount(int code) const;
+    Histogram Snapshot(METRIC_HISTOGRAM histogram) const;
+    size_t ShardCount() const { return shardCnt.load(std::memory_order_acquire); }
+
+    /* Prometheus 文本格式 0.0.4 */
+    std::string Render() const;
+
+    static const size_t MAX_SHARDS = 128;
+    static const size_t STATUS_SLOTS = 501;
+
+private:
+    struct Shard
+    {
+        std::atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+        std::atomic<uint64_t> status[STATUS_SLOTS];
+        std::atomic<uint64_t> buckets[METRIC_HISTOGRAM_COUNT][Histogram::BUCKETS];
+        std::atomic<uint64_t> sums[METRIC_HISTOGRAM_COUNT];
+        char pad[64]; /* 与下一个分片的分配隔开缓存行 */
+    };
+
+    struct Gauge
+    {
+        std::string name;
+        std::string help;
+        std::function<double()> value;
+    };
+
+    Metrics();
+    ~Metrics() = default;
+
+    static Shard *Local()
+    {
+        static thread_local Shard *shard = nullptr;
+        if (!shard)
+        {
+            shard = Instance()->NewShard();
+        }
+        return shard;
+    }
+    Shard *NewShard();
+
+    /* 分片只增不减, 线程退出后计数仍然有效; 超过上限的线程共用已有分片 */
+    std::atomic<Shard *> shards[MAX_SHARDS];
+    std::atomic<size_t> shardCnt;
+    std::atomic<size_t> nextShared;
+
+    std::vector<Gauge> gauges;
+    mutable std::mutex mtx;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,170 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "tracer.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+namespace
+{
+    /* 相邻两个时间点之间的阶段名, 下标为结束点 */
+    const char *PHASE_NAMES[TRACE_PHASE_COUNT] = {
+        "", "dispatch", "queue", "read+parse", "handle", "send wait", "send",
+    };
+
+    void AppendEscaped(string &out, const char *str)
+    {
+        for (; *str; str++)
+        {
+            unsigned char c = *str;
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (c < 0x20)
+            {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+
+    void AppendEvent(string &out, bool &first, const char *name, const char *suffix, uint64_t begin, uint64_t end,
+                     int tid, const char *args)
+    {
+        char buf[160];
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"name\":\"";
+        AppendEscaped(out, name);
+        AppendEscaped(out, suffix);
+        /* trace-event 的时间单位为微秒 */
+        snprintf(buf, sizeof(buf), "\",\"cat\":\"http\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+                 begin / 1e3, (end - begin) / 1e3, tid);
+        out += buf;
+        if (args)
+        {
+            out += ",\"args\":";
+            out += args;
+        }
+        out += '}';
+    }
+}
+
+Tracer::Tracer() : sampleRate(0) {}
+
+Tracer *Tracer::Instance()
+{
+    static Tracer tracer;
+    return &tracer;
+}
+
+Tracer::Ring *Tracer::NewRing()
+{
+    unique_ptr<Ring> ring(new Ring());
+    ring->spans.reserve(RING_SIZE);
+    ring->next = 0;
+    ring->tid = static_cast<int>(syscall(SYS_gettid));
+    lock_guard<mutex> locker(mtx);
+    rings.push_back(std::move(ring));
+    return rings.back().get();
+}
+
+void Tracer::Record(const TraceSpan &span)
+{
+    static thread_local Ring *ring = nullptr;
+    if (!ring)
+    {
+        ring = Instance()->NewRing();
+    }
+    lock_guard<mutex> locker(ring->mtx);
+    if (ring->spans.size() < RING_SIZE)
+    {
+        ring->spans.push_back(span);
+    }
+    else
+    {
+        ring->spans[ring->next] = span;
+    }
+    ring->next = (ring->next + 1) % RING_SIZE;
+}
+
+size_t Tracer::Count()
+{
+    size_t cnt = 0;
+    lock_guard<mutex> locker(mtx);
+    for (auto &ring : rings)
+    {
+        lock_guard<mutex> ringLocker(ring->mtx);
+        cnt += ring->spans.size();
+    }
+    return cnt;
+}
+
+string Tracer::Dump(bool clear)
+{
+    /* 先复制出来, 不在持锁时格式化 */
+    vector<pair<int, TraceSpan>> spans;
+    {
+        lock_guard<mutex> locker(mtx);
+        for (auto &ring : rings)
+        {
+            lock_guard<mutex> ringLocker(ring->mtx);
+            for (const TraceSpan &span : ring->spans)
+            {
+                spans.emplace_back(ring->tid, span);
+            }
+            if (clear)
+            {
+                ring->spans.clear();
+                ring->next = 0;
+            }
+        }
+    }
+
+    /* 每个连接一行(tid 为 fd): 整个请求一个事件, 各阶段嵌套在其中 */
+    string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    char args[128];
+    for (const auto &item : spans)
+    {
+        const TraceSpan &span = item.second;
+        int begin = 0;
+        while (begin < TRACE_PHASE_COUNT && span.ts[begin] == 0)
+        {
+            begin++;
+        }
+        if (begin == TRACE_PHASE_COUNT || span.ts[TP_LAST_BYTE] < span.ts[begin])
+        {
+            continue;
+        }
+        snprintf(args, sizeof(args), "{\"code\":%d,\"bytes\":%llu,\"thread\":%d}", span.code,
+                 static_cast<unsigned long long>(span.bytes), item.first);
+        string name = string(span.method) + " ";
+        AppendEvent(out, first, name.c_str(), span.path, span.ts[begin], span.ts[TP_LAST_BYTE], span.fd, args);
+        uint64_t prev = span.ts[begin];
+        for (int phase = begin + 1; phase < TRACE_PHASE_COUNT; phase++)
+        {
+            /* 缺失或乱序的时间点跳过, 阶段并入下一段 */
+            if (span.ts[phase] == 0 || span.ts[phase] < prev)
+            {
+                continue;
+            }
+            AppendEvent(out, first, PHASE_NAMES[phase], "", prev, span.ts[phase], span.fd, nullptr);
+            prev = span.ts[phase];
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
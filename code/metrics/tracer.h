@@ -0,0 +1,91 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "metrics.h"
+
+/* 一个请求经过的时间点, 按发生顺序 */
+enum TRACE_PHASE
+{
+    TP_WAKE = 0,    /* epoll_wait 返回, 主线程开始分发 */
+    TP_ENQUEUE,     /* 任务放入线程池 */
+    TP_START,       /* 工作线程开始执行任务 */
+    TP_PARSED,      /* 解析出完整请求 */
+    TP_BUILT,       /* 路由处理完成, 响应排入发送链 */
+    TP_FIRST_BYTE,  /* 第一次写出数据 */
+    TP_LAST_BYTE,   /* 发送链写空 */
+    TRACE_PHASE_COUNT
+};
+
+struct TraceSpan
+{
+    uint64_t ts[TRACE_PHASE_COUNT]; /* Metrics::Now(), 0 表示没有记录 */
+    int fd;
+    int code;
+    uint64_t bytes;
+    const char *method; /* MethodName, 静态字符串 */
+    char path[48]; /* 截断 */
+};
+
+/*
+ * 按采样率记录请求各阶段的时间点. 请求结束时 span 写入当前线程自己的环形缓冲区,
+ * 旧记录被覆盖; Dump 输出 Chrome trace-event JSON, 可在 chrome://tracing 或 Perfetto 中查看
+ */
+class Tracer
+{
+public:
+    static Tracer *Instance();
+
+    /* 每 rate 个请求采样一个, 0 关闭 */
+    void SetSampleRate(uint32_t rate) { sampleRate.store(rate, std::memory_order_relaxed); }
+    uint32_t SampleRate() const { return sampleRate.load(std::memory_order_relaxed); }
+
+    /* 关闭时调用方不取时间戳 */
+    static bool Enabled() { return Instance()->SampleRate() != 0; }
+    /* 当前请求是否采样, 每个线程独立计数 */
+    static bool Sample()
+    {
+        uint32_t rate = Instance()->SampleRate();
+        static thread_local uint32_t seen = 0;
+        return rate != 0 && ++seen % rate == 0;
+    }
+
+    static void Record(const TraceSpan &span);
+
+    /* clear 为 true 时输出后清空所有环 */
+    std::string Dump(bool clear = false);
+    size_t Count();
+
+    static const size_t RING_SIZE = 4096;
+
+private:
+    struct Ring
+    {
+        std::mutex mtx; /* 只有所属线程写, 与 Dump 之间几乎没有竞争 */
+        std::vector<TraceSpan> spans;
+        size_t next;
+        int tid;
+    };
+
+    Tracer();
+    ~Tracer() = default;
+
+    Ring *NewRing();
+
+    std::atomic<uint32_t> sampleRate;
+    std::vector<std::unique_ptr<Ring>> rings; /* 随进程存活 */
+    std::mutex mtx;
+};
+
+#endif // TRACER_H
@@ -0,0 +1,212 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "registerbatch.h"
+#include <unordered_set>
+#include <unordered_map>
+#include <chrono>
+
+using namespace std;
+
+RegisterBatch::RegisterBatch()
+{
+    connPool = nullptr;
+    windowMs = 1;
+    maxBatch = 64;
+    isClose = true;
+}
+
+RegisterBatch::~RegisterBatch()
+{
+    Close();
+}
+
+RegisterBatch *RegisterBatch::Instance()
+{
+    static RegisterBatch batch;
+    return &batch;
+}
+
+void RegisterBatch::Init(SqlConnPool *connPool, int windowMs, size_t maxBatch)
+{
+    assert(connPool && windowMs >= 0 && maxBatch > 0);
+    lock_guard<mutex> locker(mtx);
+    if (flushThread)
+    {
+        return;
+    }
+    this->connPool = connPool;
+    this->windowMs = windowMs;
+    this->maxBatch = maxBatch;
+    isClose = false;
+    flushThread.reset(new thread(&RegisterBatch::FlushThread, this));
+}
+
+void RegisterBatch::Close()
+{
+    {
+        lock_guard<mutex> locker(mtx);
+        if (!flushThread)
+        {
+            return;
+        }
+        isClose = true;
+    }
+    condFlush.notify_all();
+    flushThread->join();
+    flushThread.reset();
+}
+
+bool RegisterBatch::Register(const string &name, const string &pwd)
+{
+    Item item = {&name, &pwd, false, false};
+    unique_lock<mutex> locker(mtx);
+    if (isClose)
+    {
+        LOG_WARN("RegisterBatch closed!");
+        return false;
+    }
+    pending.push_back(&item);
+    /* 第一个元素开启时间窗口, 攒满一批立即提交 */
+    if (pending.size() == 1 || pending.size() >= maxBatch)
+    {
+        condFlush.notify_one();
+    }
+    while (!item.done)
+    {
+        condDone.wait(locker);
+    }
+    return item.result;
+}
+
+void RegisterBatch::FlushThread()
+{
+    unique_lock<mutex> locker(mtx);
+    while (true)
+    {
+        while (pending.empty() && !isClose)
+        {
+            condFlush.wait(locker);
+        }
+        if (pending.empty())
+        {
+            break;
+        }
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds(windowMs);
+        while (!isClose && pending.size() < maxBatch &&
+               condFlush.wait_until(locker, deadline) != cv_status::timeout)
+        {
+        }
+
+        vector<Item *> batch;
+        batch.swap(pending);
+        locker.unlock();
+        Commit(batch);
+        locker.lock();
+        for (auto item : batch)
+        {
+            item->done = true;
+        }
+        condDone.notify_all();
+    }
+}
+
+void RegisterBatch::Commit(vector<Item *> &batch)
+{
+    MYSQL *sql;
+    SqlConnRAII conn(&sql, connPool);
+    if (!sql)
+    {
+        LOG_WARN("RegisterBatch get conn failed, drop %d item", (int)batch.size());
+        return;
+    }
+
+    /* 一次查询本批所有用户名 */
+    string order = "SELECT username FROM user WHERE username IN (";
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        order += (i ? ",'" : "'") + SqlConnPool::Escape(sql, *batch[i]->name) + "'";
+    }
+    order += ")";
+    LOG_DEBUG("%s", order.c_str());
+    if (mysql_query(sql, order.c_str()))
+    {
+        LOG_ERROR("MySQL-ERROR: %s", mysql_error(sql));
+        return;
+    }
+    unordered_set<string> used;
+    MYSQL_RES *res = mysql_store_result(sql);
+    if (res)
+    {
+        while (MYSQL_ROW row = mysql_fetch_row(res))
+        {
+            used.insert(row[0]);
+        }
+        mysql_free_result(res);
+    }
+
+    /* 批内同名只有第一个生效 */
+    vector<Item *> fresh;
+    order = "INSERT IGNORE INTO user(username, password) VALUES ";
+    for (auto item : batch)
+    {
+        if (!used.insert(*item->name).second)
+        {
+            LOG_DEBUG("user used!");
+            continue;
+        }
+        order += (fresh.empty() ? "('" : ",('") + SqlConnPool::Escape(sql, *item->name) + "','" +
+                 SqlConnPool::Escape(sql, *item->pwd) + "')";
+        fresh.push_back(item);
+    }
+    if (fresh.empty())
+    {
+        return;
+    }
+    if (mysql_query(sql, order.c_str()))
+    {
+        LOG_ERROR("Insert error! %s", mysql_error(sql));
+        return;
+    }
+    my_ulonglong inserted = mysql_affected_rows(sql);
+    if (inserted == fresh.size())
+    {
+        for (auto item : fresh)
+        {
+            item->result = true;
+        }
+    }
+    else
+    {
+        /* 部分被 IGNORE (并发注册同名), 回查落库的密码确认归属 */
+        order = "SELECT username, password FROM user WHERE username IN (";
+        for (size_t i = 0; i < fresh.size(); i++)
+        {
+            order += (i ? ",'" : "'") + SqlConnPool::Escape(sql, *fresh[i]->name) + "'";
+        }
+        order += ")";
+        if (mysql_query(sql, order.c_str()))
+        {
+            LOG_ERROR("MySQL-ERROR: %s", mysql_error(sql));
+            return;
+        }
+        unordered_map<string, string> stored;
+        res = mysql_store_result(sql);
+        if (res)
+        {
+            while (MYSQL_ROW row = mysql_fetch_row(res))
+            {
+                stored[row[0]] = row[1] ? row[1] : "";
+            }
+            mysql_free_result(res);
+        }
+        for (auto item : fresh)
+        {
+            auto it = stored.find(*item->name);
+            item->result = it != stored.end() && it->second == *item->pwd;
+        }
+    }
+    LOG_DEBUG("RegisterBatch commit %d/%d/%d", (int)inserted, (int)fresh.size(), (int)batch.size());
+}
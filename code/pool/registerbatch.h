@@ -0,0 +1,60 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef REGISTERBATCH_H
+#define REGISTERBATCH_H
+
+#include <mysql/mysql.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <assert.h>
+#include "sqlconnpool.h"
+#include "sqlconnRAII.h"
+#include "../log/log.h"
+
+/* 注册合并提交: 短时间窗口内的并发注册合并为一次 SELECT + 一次多行 INSERT */
+class RegisterBatch
+{
+public:
+    static RegisterBatch *Instance();
+
+    void Init(SqlConnPool *connPool, int windowMs = 1, size_t maxBatch = 64);
+    void Close();
+
+    /* 阻塞直到所在批次提交完成, 返回该用户是否注册成功 */
+    bool Register(const std::string &name, const std::string &pwd);
+
+private:
+    struct Item
+    {
+        const std::string *name;
+        const std::string *pwd;
+        bool done;
+        bool result;
+    };
+
+    RegisterBatch();
+    ~RegisterBatch();
+
+    void FlushThread();
+    void Commit(std::vector<Item *> &batch);
+
+    SqlConnPool *connPool;
+    int windowMs;
+    size_t maxBatch;
+    bool isClose;
+
+    std::vector<Item *> pending;
+    std::mutex mtx;
+    std::condition_variable condFlush;
+    std::condition_variable condDone;
+    std::unique_ptr<std::thread> flushThread;
+};
+
+#endif // REGISTERBATCH_H
@@ -17,7 +17,7 @@ public:
         assert(connpool);
         *sql = connpool->GetConn();
         mSql = *sql;
-        connpool = connpool;
+        this->connpool = connpool;
     }
 
     ~SqlConnRAII()
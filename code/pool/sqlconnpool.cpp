@@ -54,7 +54,9 @@ MYSQL *SqlConnPool::GetConn()
         LOG_WARN("SqlConnPool busy!");
         return nullptr;
     }
+    uint64_t start = Metrics::Now();
     sem_wait(&semId);
+    Metrics::Observe(MH_SQL_WAIT, Metrics::Now() - start);
     {
         lock_guard<mutex> locker(mtx);
         sql = connQue.front();
@@ -89,6 +91,13 @@ int SqlConnPool::GetFreeConnCount()
     return connQue.size();
 }
 
+string SqlConnPool::Escape(MYSQL *sql, const string &str)
+{
+    string out(str.size() * 2 + 1, '\0');
+    out.resize(mysql_real_escape_string(sql, &out[0], str.data(), str.size()));
+    return out;
+}
+
 SqlConnPool::~SqlConnPool()
 {
     ClosePool();
@@ -13,6 +13,7 @@
 #include <semaphore.h>
 #include <thread>
 #include "../log/log.h"
+#include "../metrics/metrics.h"
 
 class SqlConnPool {
 public:
@@ -27,6 +28,9 @@ public:
               const char* dbName, int connSize);
     void ClosePool();
 
+    /* 按连接字符集转义, 用于拼接 SQL 字符串常量 */
+    static std::string Escape(MYSQL *sql, const std::string &str);
+
 private:
     SqlConnPool();
     ~SqlConnPool();
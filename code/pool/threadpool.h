@@ -11,22 +11,29 @@
 #include <condition_variable>
 #include <queue>
 #include <thread>
+#include <vector>
 #include <functional>
+#include <chrono>
+#include <atomic>
 
 class ThreadPool
 {
 public:
-    explicit ThreadPool(size_t threadCount = 8) : pool(std::make_shared<Pool>())
+    /* onStart 在每个工作线程取任务之前调用, 参数为线程序号, 用于绑核等线程级设置 */
+    explicit ThreadPool(size_t threadCount = 8, std::function<void(size_t)> onStart = nullptr)
+        : pool(std::make_shared<Pool>())
     {
         assert(threadCount > 0);
         for (size_t i = 0; i < threadCount; i++)
         {
-            std::thread([pool = pool]
+            workers.emplace_back([pool = pool, onStart, i]
                         {
+                    if(onStart) onStart(i);
                     std::unique_lock<std::mutex> locker(pool->mtx);
                     while(true) {
                         if(!pool->tasks.empty()) {
-                            auto task = std::move(pool->tasks.front());
+                            auto task = std::move(pool->tasks.front().second);
+                            pool->UpdateDelay(Now() - pool->tasks.front().first);
                             pool->tasks.pop();
                             locker.unlock();
                             task();
@@ -34,8 +41,7 @@ public:
                         } 
                         else if(pool->isClosed) break;
                         else pool->cond.wait(locker);
-                    } })
-                .detach();
+                    } });
         }
     }
 
@@ -43,6 +49,7 @@ public:
 
     ThreadPool(ThreadPool &&) = default;
 
+    /* 已入队的任务全部执行完才返回, 任务引用的对象须在线程池之后析构 */
     ~ThreadPool()
     {
         if (static_cast<bool>(pool))
@@ -53,6 +60,10 @@ public:
             }
             pool->cond.notify_all();
         }
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
     }
 
     template <class F>
@@ -60,20 +71,48 @@ public:
     {
         {
             std::lock_guard<std::mutex> locker(pool->mtx);
-            pool->tasks.emplace(std::forward<F>(task));
+            pool->tasks.emplace(Now(), std::forward<F>(task));
         }
         pool->cond.notify_one();
     }
 
+    /* 排队未执行的任务数 */
+    size_t QueueSize()
+    {
+        std::lock_guard<std::mutex> locker(pool->mtx);
+        return pool->tasks.size();
+    }
+
+    /* 最近任务从入队到开始执行的平滑等待时间(纳秒), 只在有任务出队时更新 */
+    uint64_t QueueDelay() const
+    {
+        return pool->delay.load(std::memory_order_relaxed);
+    }
+
 private:
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     struct Pool
     {
         std::mutex mtx;
         std::condition_variable cond;
-        bool isClosed;
-        std::queue<std::function<void()>> tasks;
+        bool isClosed = false;
+        std::queue<std::pair<uint64_t, std::function<void()>>> tasks; /* 入队时间, 任务 */
+        std::atomic<uint64_t> delay{0};
+
+        /* 持锁调用; 指数平滑, 权重 1/8 */
+        void UpdateDelay(uint64_t wait)
+        {
+            int64_t old = delay.load(std::memory_order_relaxed);
+            delay.store(old + (static_cast<int64_t>(wait) - old) / 8, std::memory_order_relaxed);
+        }
     };
     std::shared_ptr<Pool> pool;
+    std::vector<std::thread> workers;
 };
 
 #endif // THREADPOOL_H
\ No newline at end of file
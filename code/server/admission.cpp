@@ -0,0 +1,213 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "admission.h"
+#include <algorithm>
+#include <assert.h>
+#include "../metrics/metrics.h"
+
+using namespace std;
+
+namespace
+{
+    const char RESP_503[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                            "Content-Type: text/plain\r\n"
+                            "Content-Length: 12\r\n"
+                            "Retry-After: 1\r\n"
+                            "Connection: close\r\n"
+                            "\r\n"
+                            "Server busy\n";
+
+    const char RESP_429[] = "HTTP/1.1 429 Too Many Requests\r\n"
+                            "Content-Type: text/plain\r\n"
+                            "Content-Length: 18\r\n"
+                            "Retry-After: 1\r\n"
+                            "Connection: close\r\n"
+                            "\r\n"
+                            "Too many requests\n";
+
+    float BucketCap(double rate, double burstSec)
+    {
+        return static_cast<float>(max(1.0, rate * burstSec));
+    }
+}
+
+Admission::Admission(const AdmissionConfig &config) : perIp(false), mask(0), shift(64)
+{
+    Configure(config);
+}
+
+size_t Admission::TableSize(int maxConns)
+{
+    /* 有连接的 IP 不超过 maxConns 个, 表至少留一半空闲, 探测序列很短 */
+    size_t size = 1024;
+    while (size < static_cast<size_t>(maxConns) * 2)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+void Admission::Configure(const AdmissionConfig &config)
+{
+    assert(config.acceptBatch > 0);
+    this->config = config;
+    maxQueueDelay = config.maxQueueDelayMs > 0 ? static_cast<uint64_t>(config.maxQueueDelayMs) * 1000000 : 0;
+    connCap = BucketCap(config.connRate, config.burstSec);
+    reqCap = BucketCap(config.reqRate, config.burstSec);
+    bool enable = config.perIpConns > 0 || config.connRate > 0 || config.reqRate > 0;
+    if (enable && table.size() < TableSize(config.maxConns))
+    {
+        /* 只增不减, 旧表中的连接计数与令牌搬到新表 */
+        vector<Entry> old;
+        old.swap(table);
+        size_t size = TableSize(config.maxConns);
+        shift = 64;
+        for (size_t n = size; n > 1; n >>= 1)
+        {
+            shift--;
+        }
+        table.assign(size, Entry{0, 0, 0, 0, 0});
+        mask = size - 1;
+        for (const Entry &entry : old)
+        {
+            Entry *moved = entry.last != 0 ? Find(entry.ip, entry.last, true) : nullptr;
+            if (moved)
+            {
+                *moved = entry;
+            }
+        }
+    }
+    perIp.store(enable, std::memory_order_relaxed);
+}
+
+void Admission::Reload(const AdmissionConfig &config)
+{
+    lock_guard<mutex> locker(mtx);
+    Configure(config);
+}
+
+Admission::Entry *Admission::Find(uint32_t ip, uint64_t now, bool insert)
+{
+    /* 乘法散列取高位, 同一网段的地址也能分散开 */
+    size_t index = static_cast<size_t>((ip * 0x9E3779B97F4A7C15ull) >> shift);
+    Entry *reuse = nullptr;
+    for (size_t i = 0; i < MAX_PROBE; i++)
+    {
+        Entry &entry = table[(index + i) & mask];
+        if (entry.last != 0 && entry.ip == ip)
+        {
+            return &entry;
+        }
+        /* 优先空槽和令牌已回满的槽; 都没有时挤掉最久未活动的无连接槽, 它的限速状态随之丢弃 */
+        if (entry.conns == 0 && (!reuse || entry.last < reuse->last))
+        {
+            reuse = &entry;
+        }
+    }
+    if (!insert || !reuse)
+    {
+        return nullptr;
+    }
+    *reuse = Entry{ip, 0, connCap, reqCap, now};
+    return reuse;
+}
+
+void Admission::Refill(Entry &entry, uint64_t now) const
+{
+    double elapsed = (now - entry.last) / 1e9;
+    entry.connTokens = min(connCap, static_cast<float>(entry.connTokens + elapsed * config.connRate));
+    entry.reqTokens = min(reqCap, static_cast<float>(entry.reqTokens + elapsed * config.reqRate));
+    entry.last = now;
+}
+
+Admission::VERDICT Admission::OnAccept(uint32_t ip, int conns, bool overloaded)
+{
+    if (conns >= config.maxConns)
+    {
+        return FULL;
+    }
+    if (overloaded)
+    {
+        return OVERLOADED;
+    }
+    if (!perIp)
+    {
+        return ADMIT;
+    }
+    uint64_t now = Metrics::Now();
+    lock_guard<mutex> locker(mtx);
+    Entry *entry = Find(ip, now, true);
+    if (!entry)
+    {
+        /* 探测范围内全是有连接的 IP, 只会在大量来源同时占满连接时出现 */
+        return THROTTLED;
+    }
+    Refill(*entry, now);
+    if (config.perIpConns > 0 && entry->conns >= static_cast<uint32_t>(config.perIpConns))
+    {
+        return THROTTLED;
+    }
+    if (config.connRate > 0)
+    {
+        if (entry->connTokens < 1)
+        {
+            return THROTTLED;
+        }
+        entry->connTokens -= 1;
+    }
+    entry->conns++;
+    return ADMIT;
+}
+
+void Admission::OnClose(uint32_t ip)
+{
+    if (!perIp)
+    {
+        return;
+    }
+    lock_guard<mutex> locker(mtx);
+    Entry *entry = Find(ip, 0, false);
+    if (entry && entry->conns > 0)
+    {
+        entry->conns--;
+    }
+}
+
+bool Admission::OnRequests(uint32_t ip, int n)
+{
+    if (config.reqRate <= 0 || n <= 0)
+    {
+        return true;
+    }
+    uint64_t now = Metrics::Now();
+    lock_guard<mutex> locker(mtx);
+    Entry *entry = Find(ip, now, false);
+    if (!entry)
+    {
+        return true;
+    }
+    Refill(*entry, now);
+    /* 请求处理完才扣除, 欠额不超过一个桶, 停止发送后能按速率恢复 */
+    entry->reqTokens = max(-reqCap, entry->reqTokens - n);
+    return entry->reqTokens >= 0;
+}
+
+const char *Admission::Response(VERDICT verdict, size_t *len)
+{
+    switch (verdict)
+    {
+    case FULL:
+    case OVERLOADED:
+        *len = sizeof(RESP_503) - 1;
+        return RESP_503;
+    case THROTTLED:
+        *len = sizeof(RESP_429) - 1;
+        return RESP_429;
+    default:
+        *len = 0;
+        return "";
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+struct AdmissionConfig
+{
+    int maxConns = 65536;     /* 总连接数上限 */
+    int perIpConns = 0;       /* 单个 IP 的并发连接上限, 0 不限 */
+    double connRate = 0;      /* 单个 IP 每秒新建连接数, 0 不限 */
+    double reqRate = 0;       /* 单个 IP 每秒请求数, 0 不限 */
+    double burstSec = 1;      /* 令牌桶容量 = 速率 * burstSec, 至少 1 */
+    int acceptBatch = 64;     /* 一次监听事件最多 accept 的连接数 */
+    int backlog = 1024;       /* listen 队列长度, 实际受 net.core.somaxconn 限制 */
+    int maxQueueDelayMs = 0;  /* 线程池平均排队超过此值时新连接直接返回 503, 0 关闭 */
+};
+
+/*
+ * 连接准入: 总连接数, 单 IP 并发连接与令牌桶限速, 线程池过载时拒绝新连接.
+ * 单 IP 状态放在定长开放寻址表中, 只在开启单 IP 限制时分配;
+ * 插入时复用探测范围内最久未活动的无连接槽位, 不需要删除和老化
+ */
+class Admission
+{
+public:
+    enum VERDICT
+    {
+        ADMIT = 0,
+        FULL,        /* 连接数已满 */
+        OVERLOADED,  /* 线程池排队过久 */
+        THROTTLED,   /* 超出单 IP 限制 */
+    };
+
+    explicit Admission(const AdmissionConfig &config);
+
+    /* 主线程调用, 换用新的限制; 单 IP 表需要变大时按原有内容重建. 刚开启单 IP 限制时, 之前建立的连接不计入 */
+    void Reload(const AdmissionConfig &config);
+
+    /* 主线程 accept 之后调用; 返回 ADMIT 时该 IP 计入一个连接 */
+    VERDICT OnAccept(uint32_t ip, int conns, bool overloaded);
+    /* 关闭一个 ADMIT 过的连接, 可在工作线程调用 */
+    void OnClose(uint32_t ip);
+    /* 扣除该 IP 新处理的 n 个请求, 配额耗尽时返回 false */
+    bool OnRequests(uint32_t ip, int n);
+
+    bool Overloaded(uint64_t queueDelayNs) const
+    {
+        return maxQueueDelay > 0 && queueDelayNs > maxQueueDelay;
+    }
+    bool LimitRequests() const { return config.reqRate > 0; }
+    int AcceptBatch() const { return config.acceptBatch; }
+    int Backlog() const { return config.backlog; }
+
+    /* 预先生成的拒绝响应, 不分配内存, 直接 send */
+    static const char *Response(VERDICT verdict, size_t *len);
+
+    static const size_t MAX_PROBE = 16;
+
+private:
+    struct Entry
+    {
+        uint32_t ip;
+        uint32_t conns;
+        float connTokens;
+        float reqTokens;
+        uint64_t last; /* 上次补充令牌的时间(纳秒), 0 为空槽 */
+    };
+
+    Entry *Find(uint32_t ip, uint64_t now, bool insert);
+    void Refill(Entry &entry, uint64_t now) const;
+    void Configure(const AdmissionConfig &config);
+    static size_t TableSize(int maxConns);
+
+    AdmissionConfig config;
+    std::atomic<bool> perIp; /* 工作线程关闭连接时不加锁读取 */
+    uint64_t maxQueueDelay; /* 纳秒 */
+    float connCap;
+    float reqCap;
+
+    std::mutex mtx;
+    std::vector<Entry> table;
+    size_t mask;
+    int shift;
+};
+
+#endif // ADMISSION_H
@@ -0,0 +1,267 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "affinity.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <fstream>
+#include "../log/log.h"
+
+using namespace std;
+
+namespace
+{
+    const char NODE_DIR[] = "/sys/devices/system/node";
+    const int MAX_NODES = 64; /* 节点掩码只用一个 unsigned long */
+
+    bool NodeCpus(int node, vector<int> *cpus)
+    {
+        ifstream in(string(NODE_DIR) + "/node" + to_string(node) + "/cpulist");
+        string line;
+        if (!in || !getline(in, line))
+        {
+            return false;
+        }
+        return ParseCpuList(line, cpus);
+    }
+
+    /* 没有 NUMA 信息(内核未开启或容器内不可见)时为空 */
+    vector<int> CpuNodeTable()
+    {
+        vector<int> table;
+        DIR *dir = opendir(NODE_DIR);
+        if (!dir)
+        {
+            return table;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr)
+        {
+            int node;
+            char tail;
+            vector<int> cpus;
+            if (sscanf(entry->d_name, "node%d%c", &node, &tail) != 1 || !NodeCpus(node, &cpus))
+            {
+                continue;
+            }
+            for (int cpu : cpus)
+            {
+                if (static_cast<size_t>(cpu) >= table.size())
+                {
+                    table.resize(cpu + 1, -1);
+                }
+                table[cpu] = node;
+            }
+        }
+        closedir(dir);
+        return table;
+    }
+
+    string FormatCpus(const vector<int> &cpus)
+    {
+        string out;
+        for (size_t i = 0; i < cpus.size(); i++)
+        {
+            /* 连续的一段写成 a-b */
+            size_t j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            {
+                j++;
+            }
+            out += (out.empty() ? "" : ",") + to_string(cpus[i]);
+            if (j > i)
+            {
+                out += "-" + to_string(cpus[j]);
+            }
+            i = j;
+        }
+        return out.empty() ? "any" : out;
+    }
+}
+
+bool ParseCpuList(const string &s, vector<int> *cpus)
+{
+    cpus->clear();
+    if (s.find_first_not_of(" \t\r\n") == string::npos)
+    {
+        return true;
+    }
+    for (size_t pos = 0; pos != string::npos;)
+    {
+        size_t comma = s.find(',', pos);
+        string token = s.substr(pos, comma == string::npos ? string::npos : comma - pos);
+        pos = comma == string::npos ? comma : comma + 1;
+        /* 去掉空白, 允许 "0, 2" 与末尾换行 */
+        token.erase(0, token.find_first_not_of(" \t\r\n"));
+        token.erase(token.find_last_not_of(" \t\r\n") + 1);
+        const char *p = token.c_str();
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p)
+        {
+            return false;
+        }
+        if (*end == '-')
+        {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p)
+            {
+                return false;
+            }
+        }
+        if (*end || first < 0 || first > last || last >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            cpus->push_back(cpu);
+        }
+    }
+    return true;
+}
+
+bool PlanPlacement(const ServerConfig &config, Placement *placement, string *err)
+{
+    Placement plan;
+    plan.cpuNode = CpuNodeTable();
+    vector<int> workers;
+    if (!ParseCpuList(config.cpuWorkers, &workers))
+    {
+        *err = "invalid cpu.workers '" + config.cpuWorkers + "'";
+        return false;
+    }
+
+    /* 只指定节点时, 事件循环与工作线程都限制在该节点的 CPU 上, 由调度器在节点内安排 */
+    vector<int> nodeCpus;
+    if (config.numaNode >= 0 && !NodeCpus(config.numaNode, &nodeCpus))
+    {
+        *err = "NUMA node " + to_string(config.numaNode) + " not found";
+        return false;
+    }
+    if (config.cpuReactor >= 0)
+    {
+        plan.reactor.push_back(config.cpuReactor);
+    }
+    else
+    {
+        plan.reactor = nodeCpus;
+    }
+    for (int cpu : workers)
+    {
+        plan.workers.push_back({cpu});
+    }
+    if (plan.workers.empty() && !nodeCpus.empty())
+    {
+        plan.workers.push_back(nodeCpus);
+    }
+
+    /* 未指定节点时内存跟随事件循环线程所在的节点 */
+    plan.node = config.numaNode;
+    if (plan.node < 0 && config.cpuReactor >= 0 && static_cast<size_t>(config.cpuReactor) < plan.cpuNode.size())
+    {
+        plan.node = plan.cpuNode[config.cpuReactor];
+    }
+    if (plan.node >= MAX_NODES)
+    {
+        *err = "NUMA node " + to_string(plan.node) + " out of range";
+        return false;
+    }
+
+    /* 只能使用进程被允许的 CPU(taskset, cgroup cpuset), 否则线程启动后才会绑核失败 */
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+    {
+        *err = string("sched_getaffinity: ") + strerror(errno);
+        return false;
+    }
+    vector<int> used = plan.reactor;
+    used.insert(used.end(), workers.begin(), workers.end());
+    for (int cpu : used)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+        {
+            *err = "CPU " + to_string(cpu) + " is not available to this process";
+            return false;
+        }
+    }
+    *placement = std::move(plan);
+    return true;
+}
+
+bool PinThread(const vector<int> &cpus)
+{
+    if (cpus.empty())
+    {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        CPU_SET(cpu, &set);
+    }
+    /* pid 为 0 时只作用于调用线程 */
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+    {
+        LOG_WARN("Pin thread to CPU %s error: %s", FormatCpus(cpus).c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool PreferNode(int node)
+{
+    if (node < 0)
+    {
+        return true;
+    }
+    unsigned long mask = 1UL << node;
+    /* glibc 没有封装, 不为这一个调用链接 libnuma */
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8) < 0)
+    {
+        LOG_WARN("Prefer NUMA node %d error: %s", node, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+int IncomingCpu(int fd)
+{
+#ifdef SO_INCOMING_CPU
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0)
+    {
+        return cpu;
+    }
+#endif
+    return -1;
+}
+
+string Placement::Describe() const
+{
+    string out = "reactor " + FormatCpus(reactor) + ", workers ";
+    if (workers.empty())
+    {
+        out += "any";
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        out += (i ? "/" : "") + FormatCpus(workers[i]);
+    }
+    return out + ", memory " + (node >= 0 ? "node " + to_string(node) : "local");
+}
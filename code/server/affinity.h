@@ -0,0 +1,52 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>
+#include <vector>
+
+#include "../config/config.h"
+
+/*
+ * 线程绑核与 NUMA 内存放置.
+ * 内存策略在主线程设置, 之后创建的线程(工作线程, 日志线程)继承, 连接表, 缓冲区, 文件缓存都从同一节点分配;
+ * 工作线程启动时各自绑核, 事件循环线程在进入循环时绑核, 构造期间创建的辅助线程不会跟着挤在事件循环的 CPU 上
+ */
+struct Placement
+{
+    std::vector<int> reactor;              /* 事件循环线程可用的 CPU, 空为不限制 */
+    std::vector<std::vector<int>> workers; /* 第 i 个工作线程用 workers[i % size], 空为不限制 */
+    int node = -1;                         /* 优先分配内存的节点, -1 不设置 */
+    std::vector<int> cpuNode;              /* 下标为 CPU, 值为所在节点, 未知为 -1 */
+
+    /* 收包 CPU 与内存不在同一节点 */
+    bool Remote(int cpu) const
+    {
+        return node >= 0 && cpu >= 0 && static_cast<size_t>(cpu) < cpuNode.size() &&
+               cpuNode[cpu] >= 0 && cpuNode[cpu] != node;
+    }
+
+    /* 供日志输出 */
+    std::string Describe() const;
+};
+
+/* 解析 "0-3,8,10-11" 形式的 CPU 列表, 保持给出的顺序; 空串得到空列表 */
+bool ParseCpuList(const std::string &s, std::vector<int> *cpus);
+
+/* 由配置得出放置方案, 检查 CPU 与节点都可用 */
+bool PlanPlacement(const ServerConfig &config, Placement *placement, std::string *err);
+
+/* 限制调用线程只在 cpus 上运行, 空列表什么都不做 */
+bool PinThread(const std::vector<int> &cpus);
+
+/* 调用线程及之后由它创建的线程优先从 node 分配内存, 节点内存不足时仍可从其它节点分配 */
+bool PreferNode(int node);
+
+/* 已连接套接字最近一次收包的 CPU, 即处理其网卡队列的 CPU; 不可用时返回 -1 */
+int IncomingCpu(int fd);
+
+#endif // AFFINITY_H
@@ -0,0 +1,52 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef CONN_SLAB_H
+#define CONN_SLAB_H
+
+#include <vector>
+#include <memory>
+#include <assert.h>
+#include "../http/httpconn.h"
+
+/*
+ * 以 fd 为下标的连接数组, 按块懒分配
+ * 连接对象地址固定, 定时器回调和线程池任务可以直接持有指针
+ */
+class ConnSlab
+{
+public:
+    explicit ConnSlab(size_t maxFd) : chunks((maxFd + CHUNK_SIZE - 1) / CHUNK_SIZE) {}
+
+    /* 取 fd 对应的连接, 所在块不存在时分配 */
+    HttpConn *Get(int fd)
+    {
+        assert(fd >= 0 && static_cast<size_t>(fd) < chunks.size() * CHUNK_SIZE);
+        std::unique_ptr<HttpConn[]> &chunk = chunks[fd / CHUNK_SIZE];
+        if (!chunk)
+        {
+            chunk.reset(new HttpConn[CHUNK_SIZE]);
+        }
+        return &chunk[fd % CHUNK_SIZE];
+    }
+
+    /* 只查找不分配 */
+    HttpConn *Find(int fd) const
+    {
+        if (fd < 0 || static_cast<size_t>(fd) >= chunks.size() * CHUNK_SIZE || !chunks[fd / CHUNK_SIZE])
+        {
+            return nullptr;
+        }
+        return &chunks[fd / CHUNK_SIZE][fd % CHUNK_SIZE];
+    }
+
+    size_t Capacity() const { return chunks.size() * CHUNK_SIZE; }
+
+private:
+    static const size_t CHUNK_SIZE = 1024;
+    std::vector<std::unique_ptr<HttpConn[]>> chunks;
+};
+
+#endif // CONN_SLAB_H
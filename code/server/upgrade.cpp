@@ -0,0 +1,185 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "upgrade.h"
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "../log/log.h"
+
+using namespace std;
+
+extern char **environ;
+
+namespace
+{
+    const int LISTEN_FDS_START = 3; /* systemd 约定的第一个继承 fd */
+    const int READY_FD = LISTEN_FDS_START + 1;
+    const char READY_ENV[] = "WEBSERVER_READY_FD";
+
+    bool HasPrefix(const char *s, const char *prefix)
+    {
+        return strncmp(s, prefix, strlen(prefix)) == 0;
+    }
+
+    /* fork 之后只能调用异步信号安全的函数, 自己转换 pid */
+    void FormatPid(char *out, pid_t pid)
+    {
+        char digits[16];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + pid % 10;
+            pid /= 10;
+        } while (pid > 0);
+        while (n > 0)
+        {
+            *out++ = digits[--n];
+        }
+        *out = '\0';
+    }
+}
+
+int InheritListenFd()
+{
+    const char *pid = getenv("LISTEN_PID");
+    const char *fds = getenv("LISTEN_FDS");
+    if (!pid || !fds || atol(pid) != getpid())
+    {
+        return -1;
+    }
+    int count = atoi(fds);
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    if (count < 1)
+    {
+        return -1;
+    }
+    if (count > 1)
+    {
+        LOG_WARN("Inherited %d sockets, only fd %d is used", count, LISTEN_FDS_START);
+    }
+    int fd = LISTEN_FDS_START;
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) < 0 || !listening)
+    {
+        LOG_ERROR("Inherited fd %d is not a listening socket", fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+void NotifyReady()
+{
+    const char *env = getenv(READY_ENV);
+    if (!env)
+    {
+        return;
+    }
+    int fd = atoi(env);
+    unsetenv(READY_ENV);
+    if (write(fd, "1", 1) != 1)
+    {
+        LOG_WARN("Notify ready error: %s", strerror(errno));
+    }
+    close(fd);
+}
+
+string ExecutablePath()
+{
+    char path[4096];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    return len > 0 ? string(path, len) : string();
+}
+
+pid_t SpawnSuccessor(const string &exe, int listenFd, int *readyFd)
+{
+    /* 命令行原样沿用 */
+    string cmdline;
+    FILE *fp = fopen("/proc/self/cmdline", "r");
+    if (!fp)
+    {
+        LOG_ERROR("Read cmdline error!");
+        return -1;
+    }
+    char chunk[1024];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+    {
+        cmdline.append(chunk, n);
+    }
+    fclose(fp);
+    vector<char *> argv;
+    for (size_t pos = 0; pos < cmdline.size(); pos += strlen(&cmdline[pos]) + 1)
+    {
+        argv.push_back(&cmdline[pos]);
+    }
+    argv.push_back(nullptr);
+
+    /* 环境变量在 fork 之前准备好, 子进程里只填 pid */
+    vector<string> env;
+    for (char **e = environ; *e; e++)
+    {
+        if (!HasPrefix(*e, "LISTEN_PID=") && !HasPrefix(*e, "LISTEN_FDS=") &&
+            !HasPrefix(*e, "LISTEN_FDNAMES=") && !HasPrefix(*e, READY_ENV))
+        {
+            env.push_back(*e);
+        }
+    }
+    env.push_back("LISTEN_FDS=1");
+    env.push_back(string(READY_ENV) + "=" + to_string(READY_FD));
+    char pidEnv[32] = "LISTEN_PID=";
+    vector<char *> envp;
+    for (string &e : env)
+    {
+        envp.push_back(&e[0]);
+    }
+    envp.push_back(pidEnv);
+    envp.push_back(nullptr);
+
+    int ready[2];
+    if (pipe2(ready, O_CLOEXEC) < 0)
+    {
+        LOG_ERROR("Create ready pipe error: %s", strerror(errno));
+        return -1;
+    }
+    /* 超过连接表容量的 fd 在 accept 后立即关闭, 不必逐个关到 _SC_OPEN_MAX */
+    long maxFd = min(sysconf(_SC_OPEN_MAX), 1L << 17);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        /* 先复制到高位再放到 3, 4, 避免原 fd 恰好占着目标位置; 其余 fd 全部关闭, 连接不泄漏给新进程 */
+        int listenCopy = fcntl(listenFd, F_DUPFD, READY_FD + 1);
+        int readyCopy = fcntl(ready[1], F_DUPFD, READY_FD + 1);
+        if (listenCopy < 0 || readyCopy < 0 || dup2(listenCopy, LISTEN_FDS_START) < 0 || dup2(readyCopy, READY_FD) < 0)
+        {
+            _exit(127);
+        }
+        for (long fd = READY_FD + 1; fd < maxFd; fd++)
+        {
+            close(fd);
+        }
+        FormatPid(pidEnv + strlen("LISTEN_PID="), getpid());
+        execve(exe.c_str(), argv.data(), envp.data());
+        _exit(127);
+    }
+    close(ready[1]);
+    if (pid < 0)
+    {
+        LOG_ERROR("Fork error: %s", strerror(errno));
+        close(ready[0]);
+        return -1;
+    }
+    fcntl(ready[0], F_SETFL, O_NONBLOCK);
+    *readyFd = ready[0];
+    return pid;
+}
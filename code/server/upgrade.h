@@ -0,0 +1,34 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+#include <string>
+#include <sys/types.h>
+
+/*
+ * 监听套接字继承与不停机升级.
+ * 新进程按 systemd 套接字激活的约定(LISTEN_PID/LISTEN_FDS, fd 从 3 开始)取得监听套接字,
+ * 因此同一套代码既能由 systemd 的 .socket 单元启动, 也能由旧进程 fork + exec 拉起;
+ * 新进程进入事件循环后通过 WEBSERVER_READY_FD 指定的管道通知旧进程, 旧进程随后停止 accept 并排空连接
+ */
+
+/* 取得继承来的监听套接字, 没有时返回 -1; 取走后清除环境变量, 不再传给子进程 */
+int InheritListenFd();
+
+/* 通知拉起本进程的旧进程: 已开始接受连接. 不是由旧进程拉起时什么都不做 */
+void NotifyReady();
+
+/* 当前可执行文件的路径, 须在启动时取得: 二进制被替换之后 /proc/self/exe 指向已删除的旧文件 */
+std::string ExecutablePath();
+
+/*
+ * 以相同的命令行与工作目录启动 exe, 传入监听套接字;
+ * 成功时返回子进程 pid, *readyFd 为就绪管道的读端(非阻塞), 读到一个字节表示新进程已就绪, 读到 EOF 表示启动失败
+ */
+pid_t SpawnSuccessor(const std::string &exe, int listenFd, int *readyFd);
+
+#endif // UPGRADE_H
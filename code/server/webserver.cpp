@@ -5,56 +5,246 @@
  */
 
 #include "webserver.h"
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
 
 using namespace std;
 
-WebServer::WebServer(
-    int port, int trigMode, int timeoutMS, bool OptLinger,
-    int sqlPort, const char *sqlUser, const char *sqlPwd,
-    const char *dbName, int connPoolNum, int threadNum,
-    bool openLog, int logLevel, int logQueSize) : port(port), openLinger(OptLinger), timeoutMS(timeoutMS), isClose(false),
-                                                  timer(new HeapTimer()), threadpool(new ThreadPool(threadNum)), epoller(new Epoller())
+namespace
+{
+    /* 信号处理函数只往管道写一个字节, 由主线程在事件循环中处理 */
+    int signalPipe[2] = {-1, -1};
+
+    void OnSignal(int sig)
+    {
+        int saved = errno;
+        unsigned char c = static_cast<unsigned char>(sig);
+        if (write(signalPipe[1], &c, 1) < 0)
+        {
+            /* 管道满说明还有未处理的信号, 丢弃即可 */
+        }
+        errno = saved;
+    }
+}
+
+WebServer::WebServer(const ServerConfig &config)
+    : port(config.port), openLinger(config.optLinger), timeoutMS(config.timeoutMs), config(config), isClose(false),
+      draining(false), drainDeadline(0), nextSweep(0), exePath(ExecutablePath()), successor(-1), readyFd(-1), wakeFd(-1),
+      timerSize(0), wakeAt(0),
+      timer(new HeapTimer()), epoller(new Epoller()),
+      admission(new Admission(config.admission)), users(MAX_FD)
 {
     srcDir = getcwd(nullptr, 256);
     assert(srcDir);
     strncat(srcDir, "/resources/", 16);
     HttpConn::userCount = 0;
     HttpConn::srcDir = srcDir;
-    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
+    HttpConn::fionRead = config.fionRead;
+    SetKeepAliveTimeout(timeoutMS);
+
+    /* 内存策略要在分配连接表, 缓冲区与创建其它线程之前设置; 此时日志还未打开, 出错原因在下面输出 */
+    std::string placementErr;
+    if (!PlanPlacement(config, &placement, &placementErr))
+    {
+        isClose = true;
+    }
+    PreferNode(placement.node);
+    const Placement *plan = &placement;
+    threadpool.reset(new ThreadPool(config.threadNum, [plan](size_t i)
+    {
+        if (!plan->workers.empty())
+        {
+            PinThread(plan->workers[i % plan->workers.size()]);
+        }
+    }));
+    BufferPool::Instance()->Init(config.bufferPoolMax, config.bufferSize);
+    FileCache::Instance()->Init(config.cacheBytes, config.cacheTtlMs);
+    Tracer::Instance()->SetSampleRate(config.traceSample);
+
+    const char *localUserDb = config.localUserDb.empty() ? nullptr : config.localUserDb.c_str();
+#ifdef WEBSERVER_NO_MYSQL
+    /* 未链接 MySQL 的构建只能使用本地用户库, 默认值见 ServerConfig */
+    bool noAuth = !localUserDb;
+    if (noAuth)
+    {
+        isClose = true;
+    }
+#else
+    const bool noAuth = false;
+#endif
+    /* 指定本地用户库时不依赖 MySQL */
+    if (localUserDb)
+    {
+        LocalAuth *local = new LocalAuth(localUserDb);
+        auth.reset(local);
+        if (!local->IsOpen())
+        {
+            isClose = true;
+        }
+    }
+#ifndef WEBSERVER_NO_MYSQL
+    else
+    {
+        auth.reset(new SqlAuth("localhost", config.sqlPort, config.sqlUser.c_str(), config.sqlPwd.c_str(),
+                               config.dbName.c_str(), config.connPoolNum));
+    }
+#endif
+    InitRoutes();
+    InitGauges(localUserDb == nullptr);
+    HttpConn::router = &router;
 
-    InitEventMode(trigMode);
+    /* 给出证书与私钥时监听端口只接受 TLS */
+    if (!config.tlsCert.empty() && !config.tlsKey.empty())
+    {
+        tls.reset(new TlsContext());
+        if (!tls->Init(config.tlsCert.c_str(), config.tlsKey.c_str()))
+        {
+            isClose = true;
+        }
+        HttpConn::tlsCtx = tls.get();
+    }
+
+    InitEventMode(config.trigMode);
     if (!InitSocket())
     {
+        listenFd = -1;
         isClose = true;
     }
+    InitSignals();
+    InitWake();
 
-    if (openLog)
+    if (config.openLog)
     {
-        Log::Instance()->init(logLevel, "./bin", ".log", logQueSize);
+        Log::Instance()->init(config.logLevel, "./bin", ".log", config.logQueSize);
         if (isClose)
         {
             LOG_ERROR("========== Server init error!==========");
+            if (!placementErr.empty())
+            {
+                LOG_ERROR("Placement error: %s", placementErr.c_str());
+            }
+            if (noAuth)
+            {
+                LOG_ERROR("user_db is empty but MySQL support is not built in");
+            }
         }
         else
         {
             LOG_INFO("========== Server init ==========");
-            LOG_INFO("Port:%d, OpenLinger: %s", port, OptLinger ? "true" : "false");
+            LOG_INFO("Config: %s", config.configFile.empty() ? "defaults" : config.configFile.c_str());
+            LOG_INFO("Port:%d, OpenLinger: %s", port, openLinger ? "true" : "false");
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
                      (listenEvent & EPOLLET ? "ET" : "LT"),
                      (connEvent & EPOLLET ? "ET" : "LT"));
-            LOG_INFO("LogSys level: %d", logLevel);
+            LOG_INFO("LogSys level: %d", config.logLevel);
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("Auth: %s, SqlConnPool num: %d, ThreadPool num: %d", auth->Name(), config.connPoolNum, config.threadNum);
+            LOG_INFO("TLS: %s", tls ? "on" : "off");
+            LOG_INFO("Trace sample: 1/%d", config.traceSample);
+            LOG_INFO("Placement: %s", placement.Describe().c_str());
+            LOG_INFO("Cache: %zu bytes, ttl %dms, Buffer: %d bytes, pool %zu, FIONREAD %s",
+                     config.cacheBytes, config.cacheTtlMs, config.bufferSize, config.bufferPoolMax,
+                     config.fionRead ? "on" : "off");
+            LOG_INFO("Timeout: idle %dms, header %dms, body %dms + %dB/s, write stall %dms, drain %dms",
+                     timeoutMS, config.timeouts.headerMs, config.timeouts.bodyGraceMs, config.timeouts.bodyMinRate,
+                     config.timeouts.writeStallMs, config.timeouts.drainMs);
+            LOG_INFO("Admission: max conns %d, per IP %d conns %.0f conn/s %.0f req/s, shed at %dms queue delay",
+                     config.admission.maxConns, config.admission.perIpConns, config.admission.connRate,
+                     config.admission.reqRate, config.admission.maxQueueDelayMs);
         }
     }
 }
 
 WebServer::~WebServer()
 {
-    close(listenFd);
+    /* 先等工作线程做完已入队的任务, 它们还在使用连接与 epoll */
+    threadpool.reset();
+    StreamWake::notify = nullptr;
+    if (wakeFd >= 0)
+    {
+        close(wakeFd);
+    }
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+    }
+    if (readyFd >= 0)
+    {
+        close(readyFd);
+    }
     isClose = true;
     free(srcDir);
-    SqlConnPool::Instance()->ClosePool();
+    HttpConn::router = nullptr;
+    HttpConn::tlsCtx = nullptr;
+    HttpConn::draining = false;
+    HttpConn::fionRead = false;
+    SetKeepAliveTimeout(ServerConfig().timeoutMs);
+    Metrics::Instance()->ClearGauges();
+}
+
+static bool UserVerify(AuthBackend *auth, const string &name, const string &pwd, bool isLogin)
+{
+    if (name == "" || pwd == "")
+    {
+        return false;
+    }
+    LOG_INFO("Verify name:%s", name.c_str());
+    bool flag = isLogin ? auth->Login(name, pwd) : auth->Register(name, pwd);
+    LOG_DEBUG("UserVerify %s: %d", auth->Name(), flag);
+    return flag;
+}
+
+void WebServer::InitRoutes()
+{
+    /* 登录注册表单, 兼容提交到 .html 的旧地址 */
+    AuthBackend *backend = auth.get();
+    for (bool isLogin : {true, false})
+    {
+        Router::Handler verify = [backend, isLogin](HttpRequest &request, HttpResponse &response) {
+            bool ok = UserVerify(backend, request.GetPost("username"), request.GetPost("password"), isLogin);
+            response.SetPath(ok ? "/welcome.html" : "/error.html");
+        };
+        const char *page = isLogin ? "/login" : "/register";
+        router.Post(page, verify);
+        router.Post(string(page) + ".html", verify);
+        router.Get(page, &Router::ServeStatic);
+        router.Get(string(page) + ".html", &Router::ServeStatic);
+    }
+
+    /* Prometheus 抓取 */
+    router.Get("/metrics", [](HttpRequest &, HttpResponse &response) {
+        response.SetContent(FindMimeType(".txt", 4), Metrics::Instance()->Render());
+    });
+    /* 采样到的请求, Chrome trace-event JSON */
+    router.Get("/debug/trace", [](HttpRequest &, HttpResponse &response) {
+        response.SetContent(FindMimeType(".json", 5), Tracer::Instance()->Dump());
+    });
+}
+
+void WebServer::InitGauges(bool sqlPool)
+{
+    /* 计数器在各自的热路径上累加, 这里只注册输出时读取的瞬时值 */
+    Metrics *metrics = Metrics::Instance();
+    metrics->AddGauge("active_connections", "Open client connections.",
+                      [] { return static_cast<double>(HttpConn::userCount); });
+    ThreadPool *pool = threadpool.get();
+    metrics->AddGauge("threadpool_queue_depth", "Tasks waiting for a worker thread.",
+                      [pool] { return static_cast<double>(pool->QueueSize()); });
+    metrics->AddGauge("threadpool_queue_delay_seconds", "Smoothed wait of recent tasks before a worker picked them up.",
+                      [pool] { return pool->QueueDelay() / 1e9; });
+    std::atomic<size_t> *timers = &timerSize;
+    metrics->AddGauge("timer_heap_size", "Connections tracked by the idle timer.",
+                      [timers] { return static_cast<double>(timers->load(std::memory_order_relaxed)); });
+#ifndef WEBSERVER_NO_MYSQL
+    if (sqlPool)
+    {
+        metrics->AddGauge("sql_pool_free_connections", "Idle connections in the SQL pool.",
+                          [] { return static_cast<double>(SqlConnPool::Instance()->GetFreeConnCount()); });
+    }
+#else
+    (void)sqlPool;
+#endif
 }
 
 void WebServer::InitEventMode(int trigMode)
@@ -89,14 +279,23 @@ void WebServer::Start()
     if (!isClose)
     {
         LOG_INFO("========== Server start ==========");
+        PinThread(placement.reactor);
+        /* 由旧进程拉起时, 通知它可以停止 accept 了 */
+        NotifyReady();
     }
     while (!isClose)
     {
         if (timeoutMS > 0)
         {
             timeMS = timer->GetNextTick();
+            timerSize.store(timer->size(), std::memory_order_relaxed);
+        }
+        if (draining && (timeMS < 0 || timeMS > DRAIN_POLL_MS))
+        {
+            timeMS = DRAIN_POLL_MS;
         }
         int eventCnt = epoller->Wait(timeMS);
+        wakeAt = Tracer::Enabled() ? Metrics::Now() : 0;
         for (int i = 0; i < eventCnt; i++)
         {
             /* 处理事件 */
@@ -106,108 +305,522 @@ void WebServer::Start()
             {
                 HandleListen();
             }
+            else if (fd == signalPipe[0])
+            {
+                HandleSignal();
+            }
+            else if (fd == readyFd)
+            {
+                HandleReady();
+            }
+            else if (fd == wakeFd)
+            {
+                HandleWake();
+            }
             else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
             {
-                assert(users.count(fd) > 0);
-                CloseConn(&users[fd]);
+                assert(users.Find(fd));
+                CloseConn(users.Find(fd));
+            }
+            else if (users.Find(fd) && users.Find(fd)->IsBusy())
+            {
+                /* 挂起的连接由主线程重新注册, 同一轮里可能多出一次就绪; 工作线程结束时会再注册, 不重复分发 */
+                continue;
             }
             else if (events & EPOLLIN)
             {
-                assert(users.count(fd) > 0);
-                HandleRead(&users[fd]);
+                assert(users.Find(fd));
+                HandleRead(users.Find(fd));
             }
             else if (events & EPOLLOUT)
             {
-                assert(users.count(fd) > 0);
-                HandleWrite(&users[fd]);
+                assert(users.Find(fd));
+                HandleWrite(users.Find(fd));
             }
             else
             {
                 LOG_ERROR("Unexpected event");
             }
         }
+        if (draining)
+        {
+            DrainStep();
+        }
+    }
+    if (Log::Instance()->IsOpen())
+    {
+        LOG_INFO("========== Server stop ==========");
+        Log::Instance()->flush();
     }
 }
 
-void WebServer::SendError(int fd, const char *info)
+void WebServer::InitSignals()
 {
-    assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
-    if (ret < 0)
+    /* 写关闭的连接返回 EPIPE 即可, 不能让进程退出 */
+    signal(SIGPIPE, SIG_IGN);
+    if (signalPipe[0] < 0 && pipe2(signalPipe, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        LOG_ERROR("Create signal pipe error!");
+        return;
+    }
+    epoller->AddFd(signalPipe[0], EPOLLIN);
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = OnSignal;
+    act.sa_flags = SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    /* TERM/INT 优雅退出, USR2 启动新的二进制并把监听套接字交给它, HUP 重新读取配置文件 */
+    for (int sig : {SIGTERM, SIGINT, SIGUSR2, SIGHUP})
+    {
+        sigaction(sig, &act, nullptr);
+    }
+}
+
+void WebServer::InitWake()
+{
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0)
+    {
+        LOG_ERROR("Create wake eventfd error!");
+        return;
+    }
+    epoller->AddFd(wakeFd, EPOLLIN);
+    /* 数据源所在的线程只把连接放进队列, 重新注册由主线程完成, 与关闭, 超时检查不会交错 */
+    StreamWake::notify = [this](const StreamWakeRef &wake) { QueueWake(wake); };
+}
+
+void WebServer::QueueWake(const StreamWakeRef &wake)
+{
+    {
+        std::lock_guard<std::mutex> locker(wakeMtx);
+        wakeQueue.push_back(wake);
+    }
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0)
+    {
+        /* 计数溢出之前主线程必然已经读过, 不会丢失 */
+    }
+}
+
+bool WebServer::ParkConn(HttpConn *client)
+{
+    /* 没有唤醒通道时不挂起, 退回到等可写事件 */
+    if (wakeFd < 0 || !client->Park())
+    {
+        return false;
+    }
+    /*
+     * 挂起时的事件也交给主线程注册: 工作线程在这里注册的话, 主线程处理同时到达的唤醒时
+     * 两次 ModifyFd 的先后无法确定, 后到的挂起注册会盖掉唤醒
+     */
+    QueueWake(client->Wake());
+    return true;
+}
+
+void WebServer::HandleWake()
+{
+    uint64_t count;
+    if (read(wakeFd, &count, sizeof(count)) < 0)
+    {
+        return;
+    }
+    std::vector<StreamWakeRef> woken;
+    {
+        std::lock_guard<std::mutex> locker(wakeMtx);
+        woken.swap(wakeQueue);
+    }
+    for (const StreamWakeRef &wake : woken)
+    {
+        HttpConn *client = users.Find(wake->fd);
+        /* 连接已关闭或复用则丢弃; 工作线程正在处理时保留 WOKEN, 它挂起前会看到 */
+        if (!client || client->IsClosed() || client->Wake() != wake || client->IsBusy())
+        {
+            continue;
+        }
+        int expected = StreamWake::WOKEN;
+        if (wake->state.compare_exchange_strong(expected, StreamWake::RUNNING))
+        {
+            epoller->ModifyFd(wake->fd, connEvent | EPOLLOUT);
+        }
+        else if (expected == StreamWake::PARKED)
+        {
+            /* 工作线程刚挂起: HTTP/2 继续接收对端的帧; HTTP/1 只留 EPOLLRDHUP, 对端断开时照常关闭 */
+            epoller->ModifyFd(wake->fd, client->IsH2() ? connEvent | EPOLLIN : connEvent);
+        }
+    }
+}
+
+void WebServer::HandleSignal()
+{
+    unsigned char sigs[16];
+    ssize_t n;
+    while ((n = read(signalPipe[0], sigs, sizeof(sigs))) > 0)
+    {
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (sigs[i] == SIGUSR2)
+            {
+                Upgrade();
+            }
+            else if (sigs[i] == SIGHUP)
+            {
+                Reload();
+            }
+            else
+            {
+                StartDrain(sigs[i] == SIGINT ? "SIGINT" : "SIGTERM");
+            }
+        }
+    }
+}
+
+void WebServer::Upgrade()
+{
+    if (draining || readyFd >= 0 || listenFd < 0)
     {
-        LOG_WARN("send error to client[%d] error!", fd);
+        LOG_WARN("Upgrade ignored: %s", readyFd >= 0 ? "already in progress" : "server is stopping");
+        return;
+    }
+    pid_t pid = SpawnSuccessor(exePath, listenFd, &readyFd);
+    if (pid < 0)
+    {
+        return;
+    }
+    successor = pid;
+    epoller->AddFd(readyFd, EPOLLIN);
+    LOG_INFO("Upgrade: started %s as pid %d", exePath.c_str(), pid);
+}
+
+void WebServer::Reload()
+{
+    ServerConfig next = config;
+    string err;
+    if (!Config::Load(next, &err))
+    {
+        LOG_ERROR("Reload failed, keeping the current config: %s", err.c_str());
+        return;
+    }
+    /* 可重载的项逐个搬到当前配置; 超时直接从 config 读取, 下次检查时生效 */
+    int applied = 0;
+    bool cacheChanged = false;
+    for (const string &key : Config::Diff(config, next))
+    {
+        string value = Config::Get(next, key);
+        if (!Config::Reloadable(key))
+        {
+            if (Config::Secret(key))
+            {
+                LOG_WARN("Reload: %s changed, takes effect after restart", key.c_str());
+            }
+            else
+            {
+                LOG_WARN("Reload: %s changed to %s, takes effect after restart", key.c_str(), value.c_str());
+            }
+            continue;
+        }
+        if (Config::Secret(key))
+        {
+            LOG_INFO("Reload: %s changed", key.c_str());
+        }
+        else
+        {
+            LOG_INFO("Reload: %s = %s (was %s)", key.c_str(), value.c_str(), Config::Get(config, key).c_str());
+        }
+        Config::Set(config, key, value, &err);
+        cacheChanged |= key.compare(0, 6, "cache.") == 0;
+        applied++;
+    }
+    Log::Instance()->SetLevel(config.logLevel);
+    Tracer::Instance()->SetSampleRate(config.traceSample);
+    admission->Reload(config.admission);
+    if (cacheChanged)
+    {
+        FileCache::Instance()->Init(config.cacheBytes, config.cacheTtlMs);
+    }
+    LOG_INFO("Reload: %d settings applied", applied);
+}
+
+void WebServer::HandleReady()
+{
+    char c;
+    ssize_t n = read(readyFd, &c, 1);
+    if (n < 0 && errno == EAGAIN)
+    {
+        return;
+    }
+    epoller->DeleteFd(readyFd);
+    close(readyFd);
+    readyFd = -1;
+    if (n == 1)
+    {
+        /* 两个进程共享同一个监听队列, 旧进程停止 accept 后新连接都由新进程接受 */
+        LOG_INFO("Upgrade: pid %d is accepting", successor);
+        StartDrain("upgrade");
+        return;
+    }
+    /* 新进程在就绪前退出, 继续由本进程服务 */
+    int status = 0;
+    if (waitpid(successor, &status, WNOHANG) == successor)
+    {
+        LOG_ERROR("Upgrade failed: pid %d exited with status %d", successor, status);
+    }
+    else
+    {
+        LOG_ERROR("Upgrade failed: pid %d closed the ready pipe", successor);
+    }
+    successor = -1;
+}
+
+void WebServer::StartDrain(const char *reason)
+{
+    if (draining)
+    {
+        return;
+    }
+    draining = true;
+    drainDeadline = Metrics::Now() + static_cast<uint64_t>(config.timeouts.drainMs) * 1000000;
+    HttpConn::draining = true;
+    if (listenFd >= 0)
+    {
+        epoller->DeleteFd(listenFd);
+        close(listenFd);
+        listenFd = -1;
+    }
+    LOG_INFO("Draining (%s): %d connections, up to %dms", reason, (int)HttpConn::userCount, config.timeouts.drainMs);
+}
+
+void WebServer::DrainStep()
+{
+    /*
+     * 进行中的连接下一个响应带 Connection: close, HTTP/2 在流结束后发 GOAWAY;
+     * 空闲的长连接等一小段时间再关, 刚发出的请求不会被丢掉.
+     * 在本轮事件全部分发之后处理, 不会关掉本轮还有事件的 fd;
+     * 未被分发的连接没有工作线程持有, 可以在主线程直接关闭
+     */
+    uint64_t now = Metrics::Now();
+    if (now >= nextSweep)
+    {
+        nextSweep = now + DRAIN_POLL_MS * 1000000ull;
+        for (size_t fd = 0; fd < users.Capacity(); fd++)
+        {
+            HttpConn *client = users.Find(fd);
+            if (!client || client->IsClosed() || client->IsBusy() || client->Phase() != CP_IDLE ||
+                now - client->PhaseStart() < DRAIN_IDLE_MS * 1000000ull)
+            {
+                continue;
+            }
+            if (!client->Drain())
+            {
+                CloseConn(client);
+            }
+            else if (client->ToWriteBytes() > 0)
+            {
+                client->EndTask();
+                epoller->ModifyFd(client->GetFd(), connEvent | EPOLLOUT);
+            }
+        }
+    }
+    if (HttpConn::userCount == 0)
+    {
+        LOG_INFO("All connections drained");
+        isClose = true;
+    }
+    else if (now >= drainDeadline)
+    {
+        LOG_WARN("Drain timeout, closing %d connections", (int)HttpConn::userCount);
+        isClose = true;
+    }
+}
+
+void WebServer::SendReject(int fd, Admission::VERDICT verdict)
+{
+    /* TLS 端口上明文响应没有意义, 直接关闭 */
+    if (HttpConn::tlsCtx)
+    {
+        return;
+    }
+    size_t len = 0;
+    const char *resp = Admission::Response(verdict, &len);
+    if (send(fd, resp, len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+    {
+        LOG_DEBUG("send reject to client[%d] error!", fd);
     }
-    close(fd);
 }
 
 void WebServer::CloseConn(HttpConn *client)
 {
     assert(client);
     LOG_INFO("Client[%d] quit!", client->GetFd());
+    /* 关闭之后 fd 与对象可能立即被新连接复用, 先取出地址 */
+    uint32_t ip = client->GetAddr().sin_addr.s_addr;
     epoller->DeleteFd(client->GetFd());
-    client->Close();
+    if (client->Close())
+    {
+        admission->OnClose(ip);
+    }
 }
 
 void WebServer::AddClient(int fd, sockaddr_in addr)
 {
     assert(fd > 0);
-    users[fd].init(fd, addr);
+    HttpConn *client = users.Get(fd);
+    client->init(fd, addr);
+    Metrics::Add(MC_ACCEPTED);
+    if (config.cpuIncoming && placement.Remote(IncomingCpu(fd)))
+    {
+        Metrics::Add(MC_REMOTE_NODE);
+    }
     if (timeoutMS > 0)
     {
-        timer->add(fd, timeoutMS, std::bind(&WebServer::CloseConn, this, &users[fd]));
+        timer->add(fd, min(timeoutMS, config.timeouts.headerMs), std::bind(&WebServer::CheckTimeout, this, client));
     }
     epoller->AddFd(fd, EPOLLIN | connEvent);
     SetFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users[fd].GetFd());
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
 void WebServer::HandleListen()
 {
     struct sockaddr_in addr;
     socklen_t len = sizeof(addr);
-    do
+    /* 每批只判断一次过载, 读取排队长度要加锁 */
+    bool overloaded = admission->Overloaded(threadpool->QueueDelay()) && threadpool->QueueSize() > 0;
+    for (int i = 0; i < admission->AcceptBatch(); i++)
     {
         int fd = accept(listenFd, (struct sockaddr *)&addr, &len);
         if (fd <= 0)
         {
             return;
         }
-        else if (HttpConn::userCount >= MAX_FD)
+        Admission::VERDICT verdict = static_cast<size_t>(fd) >= users.Capacity()
+                                         ? Admission::FULL
+                                         : admission->OnAccept(addr.sin_addr.s_addr, HttpConn::userCount, overloaded);
+        if (verdict != Admission::ADMIT)
         {
-            SendError(fd, "Server busy!");
-            LOG_WARN("Clients is full!");
-            return;
+            SendReject(fd, verdict);
+            close(fd);
+            switch (verdict)
+            {
+            case Admission::FULL:
+                Metrics::Add(MC_REJECTED);
+                LOG_WARN("Clients is full!");
+                break;
+            case Admission::OVERLOADED:
+                Metrics::Add(MC_SHED);
+                LOG_DEBUG("Shed client, queue delay %lluus", (unsigned long long)threadpool->QueueDelay() / 1000);
+                break;
+            default:
+                Metrics::Add(MC_THROTTLED);
+                LOG_DEBUG("Throttled client %s", inet_ntoa(addr.sin_addr));
+                break;
+            }
+            continue;
         }
         AddClient(fd, addr);
-    } while (listenEvent & EPOLLET);
+        if (!(listenEvent & EPOLLET))
+        {
+            return;
+        }
+    }
+    /* ET 模式下本批用完而队列可能还有连接, 重新注册使其再次触发, 先处理其它事件 */
+    if (listenEvent & EPOLLET)
+    {
+        epoller->ModifyFd(listenFd, listenEvent | EPOLLIN);
+    }
 }
 
 void WebServer::HandleRead(HttpConn *client)
 {
     assert(client);
-    ExtentTime(client);
+    /* 上一轮处理完的请求计入配额; 此时连接不在工作线程中, 可直接回复并关闭 */
+    if (admission->LimitRequests() && !admission->OnRequests(client->GetAddr().sin_addr.s_addr, client->TakeNewRequests()))
+    {
+        Metrics::Add(MC_THROTTLED);
+        SendReject(client->GetFd(), Admission::THROTTLED);
+        CloseConn(client);
+        return;
+    }
+    client->SetBusy();
+    MarkDispatch(client);
     threadpool->AddTask(std::bind(&WebServer::OnRead, this, client));
 }
 
 void WebServer::HandleWrite(HttpConn *client)
 {
     assert(client);
-    ExtentTime(client);
+    client->SetBusy();
+    MarkDispatch(client);
     threadpool->AddTask(std::bind(&WebServer::OnWrite, this, client));
 }
 
-void WebServer::ExtentTime(HttpConn *client)
+void WebServer::MarkDispatch(HttpConn *client)
 {
-    assert(client);
-    if (timeoutMS > 0)
+    /* 入队之后工作线程可能已经开始处理, 时间点必须在 AddTask 之前写入 */
+    if (wakeAt)
+    {
+        client->Mark(TP_WAKE, wakeAt);
+        client->Mark(TP_ENQUEUE, Metrics::Now());
+    }
+}
+
+uint64_t WebServer::Deadline(const HttpConn *client) const
+{
+    const uint64_t MS = 1000000;
+    uint64_t start = client->PhaseStart();
+    switch (client->Phase())
     {
-        timer->adjust(client->GetFd(), timeoutMS);
+    case CP_HEADER:
+        return start + min(timeoutMS, config.timeouts.headerMs) * MS;
+    case CP_BODY:
+        if (config.timeouts.bodyMinRate > 0)
+        {
+            /* 宽限期之后平均每秒至少 bodyMinRate 字节 */
+            return start + config.timeouts.bodyGraceMs * MS + client->BodyReceived() * 1000 / config.timeouts.bodyMinRate * MS;
+        }
+        return start + timeoutMS * MS;
+    case CP_WRITE:
+        /* 挂起的流式响应在等数据源而不是对端, 按空闲超时计; 数据源沉默更久时需要定期发送内容 */
+        return start + (client->Parked() ? timeoutMS : config.timeouts.writeStallMs) * MS;
+    default:
+        return start + timeoutMS * MS;
     }
 }
 
+void WebServer::CheckTimeout(HttpConn *client)
+{
+    /*
+     * 定时器只在最早可能到期的时间触发, 读写事件不再调整堆;
+     * 触发时按连接当前阶段算出真正的期限, 未到则以剩余时间重新加入
+     */
+    if (client->IsClosed())
+    {
+        return;
+    }
+    int fd = client->GetFd();
+    if (client->IsBusy())
+    {
+        timer->add(fd, BUSY_RECHECK_MS, std::bind(&WebServer::CheckTimeout, this, client));
+        return;
+    }
+    uint64_t now = Metrics::Now();
+    uint64_t deadline = Deadline(client);
+    if (now < deadline)
+    {
+        timer->add(fd, static_cast<int>((deadline - now) / 1000000) + 1, std::bind(&WebServer::CheckTimeout, this, client));
+        return;
+    }
+    Metrics::Add(static_cast<METRIC_COUNTER>(MC_TIMEOUT_HEADER + client->Phase()));
+    LOG_INFO("Client[%d] timeout in phase %d", fd, client->Phase());
+    CloseConn(client);
+}
+
 void WebServer::OnRead(HttpConn *client)
 {
     assert(client);
+    if (Tracer::Enabled())
+    {
+        client->Mark(TP_START, Metrics::Now());
+    }
     int ret = -1;
     int readErrno = 0;
     ret = client->read(&readErrno);
@@ -221,23 +834,28 @@ void WebServer::OnRead(HttpConn *client)
 
 void WebServer::OnProcess(HttpConn *client)
 {
-    if (client->process())
-    {
-        epoller->ModifyFd(client->GetFd(), connEvent | EPOLLOUT);
-    }
-    else
+    bool wantWrite = client->process();
+    /* 重新注册之后主线程可能立即再次分发, 阶段必须先写好 */
+    client->EndTask();
+    /* 只剩没有内容的流式数据源时挂起等待唤醒 */
+    if (!wantWrite && client->IsStreaming() && ParkConn(client))
     {
-        epoller->ModifyFd(client->GetFd(), connEvent | EPOLLIN);
+        return;
     }
+    epoller->ModifyFd(client->GetFd(), connEvent | (wantWrite || client->IsStreaming() ? EPOLLOUT : EPOLLIN));
 }
 
 void WebServer::OnWrite(HttpConn *client)
 {
     assert(client);
+    if (Tracer::Enabled())
+    {
+        client->Mark(TP_START, Metrics::Now());
+    }
     int ret = -1;
     int writeErrno = 0;
     ret = client->write(&writeErrno);
-    if (client->ToWriteBytes() == 0)
+    if (client->ToWriteBytes() == 0 && !client->IsStreaming())
     {
         /* 传输完成 */
         if (client->IsKeepAlive())
@@ -246,14 +864,17 @@ void WebServer::OnWrite(HttpConn *client)
             return;
         }
     }
-    else if (ret < 0)
+    else if (ret >= 0 || writeErrno == EAGAIN)
     {
-        if (writeErrno == EAGAIN)
+        /* 继续传输 */
+        client->EndTask();
+        /* 流式数据源没有内容: 空闲套接字总是可写, 不等可写事件, 由数据源唤醒 */
+        if (client->Starved() && ParkConn(client))
         {
-            /* 继续传输 */
-            epoller->ModifyFd(client->GetFd(), connEvent | EPOLLOUT);
             return;
         }
+        epoller->ModifyFd(client->GetFd(), connEvent | EPOLLOUT);
+        return;
     }
     CloseConn(client);
 }
@@ -263,6 +884,25 @@ bool WebServer::InitSocket()
 {
     int ret;
     struct sockaddr_in addr;
+    /* systemd 套接字激活或旧进程升级时继承监听套接字, 不再 bind */
+    listenFd = InheritListenFd();
+    if (listenFd >= 0)
+    {
+        socklen_t len = sizeof(addr);
+        if (getsockname(listenFd, (struct sockaddr *)&addr, &len) == 0)
+        {
+            port = ntohs(addr.sin_port);
+        }
+        if (epoller->AddFd(listenFd, listenEvent | EPOLLIN) == 0)
+        {
+            LOG_ERROR("Add listen error!");
+            close(listenFd);
+            return false;
+        }
+        SetFdNonblock(listenFd);
+        LOG_INFO("Server port:%d (inherited)", port);
+        return true;
+    }
     if (port > 65535 || port < 1024)
     {
         LOG_ERROR("Port:%d error!", port);
@@ -313,7 +953,7 @@ bool WebServer::InitSocket()
         return false;
     }
 
-    ret = listen(listenFd, 6);
+    ret = listen(listenFd, admission->Backlog() > 0 ? admission->Backlog() : SOMAXCONN);
     if (ret < 0)
     {
         LOG_ERROR("Listen port:%d error!", port);
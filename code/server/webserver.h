@@ -16,20 +16,25 @@
 #include <arpa/inet.h>
 
 #include "epoller.h"
+#include "connslab.h"
+#include "admission.h"
+#include "upgrade.h"
+#include "affinity.h"
 #include "../log/log.h"
 #include "../timer/heaptimer.h"
-#include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
-#include "../pool/sqlconnRAII.h"
+#ifndef WEBSERVER_NO_MYSQL
+#include "../auth/sqlauth.h"
+#endif
+#include "../auth/localauth.h"
 #include "../http/httpconn.h"
+#include "../metrics/metrics.h"
+#include "../metrics/tracer.h"
+#include "../config/config.h"
 
 class WebServer {
 public:
-    WebServer(
-        int port, int trigMode, int timeoutMS, bool OptLinger, 
-        int sqlPort, const char* sqlUser, const  char* sqlPwd, 
-        const char* dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize);
+    explicit WebServer(const ServerConfig& config);
 
     ~WebServer();
     void Start();
@@ -37,14 +42,30 @@ public:
 private:
     bool InitSocket(); 
     void InitEventMode(int trigMode);
+    void InitRoutes();
+    void InitGauges(bool sqlPool);
     void AddClient(int fd, sockaddr_in addr);
   
     void HandleListen();
     void HandleWrite(HttpConn* client);
     void HandleRead(HttpConn* client);
 
-    void SendError(int fd, const char*info);
-    void ExtentTime(HttpConn* client);
+    void InitSignals();
+    void HandleSignal();
+    void HandleReady();
+    void InitWake();
+    void HandleWake();
+    void QueueWake(const StreamWakeRef &wake);
+    bool ParkConn(HttpConn *client);
+    void Upgrade();
+    void Reload();
+    void StartDrain(const char *reason);
+    void DrainStep();
+
+    void SendReject(int fd, Admission::VERDICT verdict);
+    void CheckTimeout(HttpConn* client);
+    uint64_t Deadline(const HttpConn* client) const;
+    void MarkDispatch(HttpConn* client);
     void CloseConn(HttpConn* client);
 
     void OnRead(HttpConn* client);
@@ -52,23 +73,44 @@ private:
     void OnProcess(HttpConn* client);
 
     static const int MAX_FD = 65536;
+    static const int BUSY_RECHECK_MS = 1000; /* 超时检查遇到工作线程正在处理时, 隔这么久再查 */
+    static const int DRAIN_POLL_MS = 100;    /* 排空期间 epoll_wait 的最长等待, 按时检查是否结束 */
+    static const int DRAIN_IDLE_MS = 1000;   /* 排空期间空闲这么久的长连接直接关闭 */
 
     static int SetFdNonblock(int fd);
 
     int port;
     bool openLinger;
     int timeoutMS;  /* 毫秒MS */
+    ServerConfig config;     /* 当前生效的配置, SIGHUP 时更新可重载的部分 */
+    Placement placement;     /* 工作线程启动时读取, 之后不再修改 */
     bool isClose;
     int listenFd;
     char* srcDir;
+
+    bool draining;           /* 已停止 accept, 等待进行中的请求完成 */
+    uint64_t drainDeadline;
+    uint64_t nextSweep;      /* 下次检查空闲连接的时间 */
+    std::string exePath;     /* 启动时的可执行文件路径, 升级时执行该路径上的新文件 */
+    pid_t successor;         /* 正在启动的新进程 */
+    int readyFd;             /* 新进程的就绪管道, 没有升级进行中时为 -1 */
+    int wakeFd;              /* 流式数据源唤醒挂起的连接 */
+    std::mutex wakeMtx;
+    std::vector<StreamWakeRef> wakeQueue;
     
     uint32_t listenEvent;
     uint32_t connEvent;
+    std::atomic<size_t> timerSize; /* 主线程每轮发布, 供工作线程输出指标 */
+    uint64_t wakeAt;               /* 本轮 epoll_wait 返回的时间, 未开启 trace 时为 0 */
    
     std::unique_ptr<HeapTimer> timer;
     std::unique_ptr<ThreadPool> threadpool;
     std::unique_ptr<Epoller> epoller;
-    std::unordered_map<int, HttpConn> users;
+    std::unique_ptr<AuthBackend> auth;
+    std::unique_ptr<TlsContext> tls;
+    std::unique_ptr<Admission> admission;
+    Router router;
+    ConnSlab users;
 };
 
 
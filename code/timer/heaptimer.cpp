@@ -7,17 +7,17 @@
 
 void HeapTimer::siftup(size_t i)
 {
-    assert(i >= 0 && i < mHeap.size());
-    size_t j = (i - 1) / 2;
-    while (j >= 0)
+    assert(i < mHeap.size());
+    /* 到堆顶为止; size_t 的 (0 - 1) / 2 会越界 */
+    while (i > 0)
     {
+        size_t j = (i - 1) / 2;
         if (mHeap[j] < mHeap[i])
         {
             break;
         }
         SwapNode(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -83,8 +83,9 @@ void HeapTimer::doWork(int id)
     }
     size_t i = mRef[id];
     TimerNode node = mHeap[i];
-    node.cb();
+    /* 先删除再回调, 回调中可以重新 add 同一个 id */
     remove(i);
+    node.cb();
 }
 
 void HeapTimer::remove(size_t index)
@@ -131,8 +132,8 @@ void HeapTimer::tick()
         {
             break;
         }
-        node.cb();
         pop();
+        node.cb();
     }
 }
 
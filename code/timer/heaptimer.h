@@ -53,6 +53,8 @@ public:
 
     int GetNextTick();
 
+    size_t size() const { return mHeap.size(); }
+
 private:
     void remove(size_t i);
 
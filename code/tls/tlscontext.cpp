@@ -0,0 +1,251 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#include "tlscontext.h"
+#include "../log/log.h"
+#include <openssl/err.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+
+namespace
+{
+    /* ALPN 协议列表, 长度前缀格式 */
+    const unsigned char ALPN_H2[] = "\x02h2";
+    const unsigned char ALPN_HTTP11[] = "\x08http/1.1";
+
+    int SelectAlpn(SSL *, const unsigned char **out, unsigned char *outLen,
+                   const unsigned char *in, unsigned int inLen, void *)
+    {
+        /* 优先 h2, 其次 http/1.1; 都没有时不协商 ALPN, 按 HTTP/1.1 处理 */
+        for (const unsigned char *proto : {ALPN_H2, ALPN_HTTP11})
+        {
+            unsigned char *selected = nullptr;
+            if (SSL_select_next_proto(&selected, outLen, proto, proto[0] + 1, in, inLen) == OPENSSL_NPN_NEGOTIATED)
+            {
+                *out = selected;
+                return SSL_TLSEXT_ERR_OK;
+            }
+        }
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
+    void LogSslError(const char *what)
+    {
+        unsigned long err;
+        while ((err = ERR_get_error()) != 0)
+        {
+            char buf[256];
+            ERR_error_string_n(err, buf, sizeof(buf));
+            LOG_WARN("%s: %s", what, buf);
+        }
+    }
+}
+
+TlsContext::TlsContext() : ctx(nullptr) {}
+
+TlsContext::~TlsContext()
+{
+    if (ctx)
+    {
+        SSL_CTX_free(ctx);
+    }
+}
+
+bool TlsContext::Init(const char *certFile, const char *keyFile)
+{
+    assert(certFile && keyFile);
+    ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx)
+    {
+        LogSslError("SSL_CTX_new");
+        return false;
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    if (SSL_CTX_use_certificate_chain_file(ctx, certFile) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, keyFile, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1)
+    {
+        LOG_ERROR("TLS cert %s / key %s error!", certFile, keyFile);
+        LogSslError("load cert");
+        SSL_CTX_free(ctx);
+        ctx = nullptr;
+        return false;
+    }
+
+    long opts = SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE;
+#ifdef SSL_OP_ENABLE_KTLS
+    /* 内核不支持时 OpenSSL 自动退回用户态加密 */
+    opts |= SSL_OP_ENABLE_KTLS;
+#endif
+    SSL_CTX_set_options(ctx, opts);
+    /* 写缓冲区地址可变: 重试时从发送链重新拼出同样的前缀 */
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                              SSL_MODE_RELEASE_BUFFERS);
+
+    /* 会话恢复: 服务端缓存供 session id 使用, 票据由上下文内的随机密钥加密 */
+    static const unsigned char SID_CTX[] = "TinyWebServer";
+    SSL_CTX_set_session_id_context(ctx, SID_CTX, sizeof(SID_CTX) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, SESSION_CACHE_SIZE);
+    SSL_CTX_set_timeout(ctx, SESSION_TIMEOUT);
+    SSL_CTX_set_alpn_select_cb(ctx, SelectAlpn, nullptr);
+    LOG_INFO("TLS cert: %s", certFile);
+    return true;
+}
+
+TlsConn *TlsContext::NewConn(int fd) const
+{
+    assert(ctx);
+    SSL *ssl = SSL_new(ctx);
+    if (ssl && SSL_set_fd(ssl, fd) != 1)
+    {
+        SSL_free(ssl);
+        ssl = nullptr;
+    }
+    if (!ssl)
+    {
+        LogSslError("SSL_new");
+    }
+    else
+    {
+        SSL_set_accept_state(ssl);
+    }
+    return new TlsConn(ssl);
+}
+
+TlsConn::TlsConn(SSL *ssl) : ssl(ssl), handshakeDone(false), h2(false), ktls(false) {}
+
+TlsConn::~TlsConn()
+{
+    if (ssl)
+    {
+        SSL_free(ssl);
+    }
+}
+
+ssize_t TlsConn::Error(int ret, int *saveErrno)
+{
+    int err = SSL_get_error(ssl, ret);
+    switch (err)
+    {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        *saveErrno = EAGAIN;
+        return -1;
+    case SSL_ERROR_ZERO_RETURN:
+        /* 对端发送了 close_notify */
+        return 0;
+    case SSL_ERROR_SYSCALL:
+        if (errno == 0)
+        {
+            /* 对端直接断开 */
+            return 0;
+        }
+        *saveErrno = errno;
+        return -1;
+    default:
+        LogSslError("TLS");
+        *saveErrno = EPROTO;
+        return -1;
+    }
+}
+
+ssize_t TlsConn::Handshake(int *saveErrno)
+{
+    ERR_clear_error();
+    errno = 0;
+    int ret = SSL_do_handshake(ssl);
+    if (ret != 1)
+    {
+        return Error(ret, saveErrno);
+    }
+    handshakeDone = true;
+
+    const unsigned char *alpn = nullptr;
+    unsigned int alpnLen = 0;
+    SSL_get0_alpn_selected(ssl, &alpn, &alpnLen);
+    h2 = alpnLen == 2 && memcmp(alpn, "h2", 2) == 0;
+    ktls = BIO_get_ktls_send(SSL_get_wbio(ssl));
+    LOG_DEBUG("TLS fd %d: %s %s, resumed %d, alpn %.*s, ktls %d", SSL_get_fd(ssl), SSL_get_version(ssl),
+              SSL_get_cipher_name(ssl), (int)SSL_session_reused(ssl), (int)alpnLen, alpn ? (const char *)alpn : "",
+              (int)ktls);
+    return 1;
+}
+
+ssize_t TlsConn::Read(Buffer &buff, int *saveErrno)
+{
+    if (!ssl)
+    {
+        *saveErrno = EPROTO;
+        return -1;
+    }
+    if (!handshakeDone)
+    {
+        ssize_t ret = Handshake(saveErrno);
+        if (ret <= 0)
+        {
+            return ret;
+        }
+    }
+    buff.EnsureWriteable(RECORD_SIZE);
+    ERR_clear_error();
+    errno = 0;
+    int len = SSL_read(ssl, buff.BeginWrite(), static_cast<int>(std::min(buff.WritableBytes(), static_cast<size_t>(INT_MAX))));
+    if (len <= 0)
+    {
+        return Error(len, saveErrno);
+    }
+    buff.HasWritten(len);
+    return len;
+}
+
+ssize_t TlsConn::Write(BufferChain &chain, int *saveErrno)
+{
+    if (!ssl || !handshakeDone)
+    {
+        *saveErrno = EPROTO;
+        return -1;
+    }
+    if (ktls)
+    {
+        /* 内核加密, 文件映射仍由 writev 直接发出, 不经过用户态加密缓冲 */
+        return chain.WriteFd(SSL_get_fd(ssl), saveErrno);
+    }
+    /* 小片段拼成一条完整记录再加密, 每个线程共用一块暂存区 */
+    static thread_local char record[RECORD_SIZE];
+    size_t len = chain.Gather(record, RECORD_SIZE);
+    if (len == 0)
+    {
+        return 0;
+    }
+    ERR_clear_error();
+    errno = 0;
+    int ret = SSL_write(ssl, record, static_cast<int>(len));
+    if (ret <= 0)
+    {
+        if (Error(ret, saveErrno) == 0)
+        {
+            *saveErrno = EPIPE;
+        }
+        return -1;
+    }
+    chain.Retrieve(ret);
+    return ret;
+}
+
+bool TlsConn::Pending() const
+{
+    return ssl && SSL_pending(ssl) > 0;
+}
+
+void TlsConn::Shutdown()
+{
+    if (ssl && handshakeDone)
+    {
+        ERR_clear_error();
+        SSL_shutdown(ssl);
+    }
+}
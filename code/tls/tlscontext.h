@@ -0,0 +1,76 @@
+/*
+ * @Author       : mark
+ * @Date         : 2026-10-19
+ * @copyleft Apache 2.0
+ */
+#ifndef TLS_CONTEXT_H
+#define TLS_CONTEXT_H
+
+#include <sys/types.h>
+#include <openssl/ssl.h>
+
+#include "../buffer/buffer.h"
+#include "../buffer/bufferchain.h"
+
+class TlsConn;
+
+/*
+ * 服务端 TLS 配置, 启动时创建, 所有连接共用.
+ * 会话缓存 + 会话票据让重连跳过完整握手; 内核支持时启用 kTLS, 加密由内核完成
+ */
+class TlsContext
+{
+public:
+    TlsContext();
+    ~TlsContext();
+
+    /* 加载证书链与私钥, 失败返回 false */
+    bool Init(const char *certFile, const char *keyFile);
+    bool IsOpen() const { return ctx != nullptr; }
+
+    /* 为新连接创建 TLS 状态, 握手在第一次读时进行 */
+    TlsConn *NewConn(int fd) const;
+
+    static const long SESSION_CACHE_SIZE = 20480;
+    static const long SESSION_TIMEOUT = 300; /* 秒 */
+
+private:
+    SSL_CTX *ctx;
+};
+
+/* 一个连接的 TLS 状态, 接口与 Buffer::ReadFd / BufferChain::WriteFd 对应 */
+class TlsConn
+{
+public:
+    explicit TlsConn(SSL *ssl);
+    ~TlsConn();
+
+    /* 握手未完成时先握手; 需要等待时返回 -1 且 Errno 为 EAGAIN, 对端关闭返回 0 */
+    ssize_t Read(Buffer &buff, int *Errno);
+
+    /* kTLS 发送可用时直接 writev 明文, 否则每次最多加密一条 16KB 记录 */
+    ssize_t Write(BufferChain &chain, int *Errno);
+
+    /* 发送 close_notify, 不等待对端回复 */
+    void Shutdown();
+
+    bool HandshakeDone() const { return handshakeDone; }
+    /* SSL 内部还有已解密未读出的数据, epoll 不会再通知 */
+    bool Pending() const;
+    /* ALPN 协商为 h2 */
+    bool IsH2() const { return h2; }
+    bool Ktls() const { return ktls; }
+
+    static const size_t RECORD_SIZE = 16 * 1024;
+
+private:
+    ssize_t Handshake(int *Errno);
+    ssize_t Error(int ret, int *Errno);
+
+    SSL *ssl;
+    bool handshakeDone;
+    bool h2;
+    bool ktls; /* 内核负责发送方向的加密 */
+};
+
+#endif // TLS_CONTEXT_H
@@ -5,7 +5,27 @@
  */ 
 #include "../code/log/log.h"
 #include "../code/pool/threadpool.h"
+#include "../code/auth/localauth.h"
+#include "../code/buffer/bufferchain.h"
+#include "../code/server/connslab.h"
+#include "../code/server/admission.h"
+#include "../code/config/config.h"
+#include "../code/server/affinity.h"
+#include "../code/timer/heaptimer.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/httpresponse.h"
+#include "../code/http/router.h"
+#include "../code/http2/http2session.h"
+#include "../code/tls/tlscontext.h"
+#include "../code/metrics/metrics.h"
+#include "../code/metrics/tracer.h"
+#include <openssl/pem.h>
+#include <openssl/x509.h>
 #include <features.h>
+#include <thread>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <chrono>
 
 #if __GLIBC__ == 2 && __GLIBC_MINOR__ < 30
 #include <sys/syscall.h>
@@ -43,14 +63,1286 @@ void ThreadLogTask(int i, int cnt) {
 
 void TestThreadPool() {
     Log::Instance()->init(0, "./testThreadpool", ".log", 5000);
-    ThreadPool threadpool(6);
-    for(int i = 0; i < 18; i++) {
-        threadpool.AddTask(std::bind(ThreadLogTask, i % 4, i * 10000));
+    std::atomic<int> done(0);
+    {
+        ThreadPool threadpool(6);
+        for(int i = 0; i < 18; i++) {
+            threadpool.AddTask([i, &done] { ThreadLogTask(i % 4, i * 10000); done++; });
+        }
+    }
+    /* 析构等待已入队的任务全部执行完 */
+    assert(done == 18);
+}
+
+/* 统计 operator new 次数, 用于观察每个请求的分配次数 */
+static std::atomic<long> allocCount(0);
+void* operator new(size_t size) {
+    allocCount++;
+    void* ptr = malloc(size);
+    if(!ptr) { throw std::bad_alloc(); }
+    return ptr;
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+void TestHttpRequest() {
+    const std::string req =
+        "POST /login HTTP/1.1\r\n"
+        "Host: 127.0.0.1:1316\r\n"
+        "Connection: keep-alive\r\n"
+        "Content-Length: 41\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "Origin: http://127.0.0.1:1316\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Referer: http://127.0.0.1:1316/login.html\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "\r\n"
+        "username=%E5%BC%A0+san&password=p%40ss%21";
+    HttpRequest request;
+    Buffer buff;
+    buff.Append(req);
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && buff.ReadableBytes() == 0);
+    assert(request.GetMethod() == "POST" && request.GetVersion() == "1.1");
+    assert(request.IsKeepAlive());
+    assert(request.GetHeader("Accept-Language") == "zh-CN,zh;q=0.9,en;q=0.8");
+    assert(request.GetPost("username") == "\xE5\xBC\xA0 san");
+    assert(request.GetPost("password") == "p@ss!");
+    assert(request.GetHeader(HDR_CONTENT_LENGTH) == "41");
+    assert(FindHeaderId("content-TYPE", 12) == HDR_CONTENT_TYPE);
+    assert(FindHeaderId("X-Unknown", 9) == HDR_UNKNOWN);
+    assert(strcmp(FindStatus(404)->line, "HTTP/1.1 404 Not Found\r\n") == 0 && !FindStatus(418));
+    for(int code : {201, 204, 302, 304, 401, 429, 503}) {
+        assert(FindStatus(code) && FindStatus(code)->code == code);
+    }
+    assert(strcmp(FindMimeType(".css", 4)->type, "text/css") == 0 && !FindMimeType(".exe", 4));
+    assert(IsDefaultHtml("/login", 6) && !IsDefaultHtml("/Login", 6));
+
+    /* 流水线: 一次读入多个请求, 逐个解析, 不完整的留在缓冲区 */
+    const std::string get = "GET /a HTTP/1.1\r\nHost: x\r\n\r\n";
+    const std::string get10 = "GET /b HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n";
+    const std::string close = "GET /c HTTP/1.1\r\nConnection: foo, close\r\n\r\n";
+    buff.RetrieveAll();
+    buff.Append(get + get10 + close + req.substr(0, 300));
+    request.Init();
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.GetPath() == "/a" && request.IsKeepAlive());
+    request.Init();
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.GetPath() == "/b" && request.IsKeepAlive());
+    request.Init();
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.GetPath() == "/c" && !request.IsKeepAlive());
+    request.Init();
+    assert(request.parse(buff) == HttpRequest::NO_REQUEST && !request.IsIdle());
+    buff.Append(req.substr(300, req.size() - 310));
+    assert(request.parse(buff) == HttpRequest::NO_REQUEST);
+    buff.Append(req.substr(req.size() - 10));
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.GetPost("password") == "p@ss!");
+    /* 请求头逐字节到达: 不完整的行从上次查找处继续, \r 与 \n 分两次到达也能识别 */
+    request.Init();
+    for(size_t i = 0; i < req.size(); i++) {
+        buff.Append(req.data() + i, 1);
+        assert(request.parse(buff) == (i + 1 == req.size() ? HttpRequest::GET_REQUEST : HttpRequest::NO_REQUEST));
+    }
+    assert(request.GetHeader("Referer") == "http://127.0.0.1:1316/login.html" && request.GetPost("username") == "\xE5\xBC\xA0 san");
+    request.Init();
+    buff.Append("GET / HTTP/1.1\r\nContent-Length: -1\r\n\r\n");
+    assert(request.parse(buff) == HttpRequest::BAD_REQUEST);
+
+    /* 有歧义的重复头部与没有冒号的行返回 400, 相同的 Content-Length 重复可以接受 */
+    const char *bad[] = {
+        "POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\nhello!",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length:\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nHost: b\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nno colon here\r\n\r\n",
+    };
+    for(const char* r : bad) {
+        request.Init();
+        buff.RetrieveAll();
+        buff.Append(r);
+        assert(request.parse(buff) == HttpRequest::BAD_REQUEST);
+    }
+    request.Init();
+    buff.RetrieveAll();
+    buff.Append("POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 5\r\n\r\nhello");
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.GetBody() == "hello");
+
+    /* chunked 请求体逐字节到达 */
+    const std::string chunked = "POST /up HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                "5;ext=1\r\nhello\r\n9\r\n, \r\nworld\r\n0\r\nX-Sum: 1\r\n\r\n";
+    request.Init();
+    buff.RetrieveAll();
+    for(size_t i = 0; i + 1 < chunked.size(); i++) {
+        buff.Append(chunked.data() + i, 1);
+        assert(request.parse(buff) == HttpRequest::NO_REQUEST);
+    }
+    buff.Append(chunked.data() + chunked.size() - 1, 1);
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.GetBody() == "hello, \r\nworld");
+    request.Init();
+    buff.Append("POST /up HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n");
+    assert(request.parse(buff) == HttpRequest::BAD_REQUEST);
+
+    /* 超过上限返回 413, 超过内存上限转存临时文件, 也可交给回调 */
+    size_t maxBody = HttpRequest::maxBodySize, memBody = HttpRequest::memBodySize;
+    HttpRequest::maxBodySize = 1000;
+    HttpRequest::memBodySize = 100;
+    request.Init();
+    buff.RetrieveAll();
+    buff.Append("POST /up HTTP/1.1\r\nContent-Length: 1001\r\n\r\n");
+    assert(request.parse(buff) == HttpRequest::ENTITY_TOO_LARGE);
+    request.Init();
+    buff.RetrieveAll();
+    buff.Append("POST /up HTTP/1.1\r\nContent-Length: 1000\r\nExpect: 100-continue\r\n\r\n");
+    assert(request.parse(buff) == HttpRequest::NO_REQUEST && request.HeadersDone());
+    assert(request.ExpectContinue() && !request.ExpectContinue());
+    buff.Append(std::string(600, 'a'));
+    assert(request.parse(buff) == HttpRequest::NO_REQUEST && buff.ReadableBytes() == 0);
+    buff.Append(std::string(400, 'b'));
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.GetBody().empty());
+    FileSink* file = dynamic_cast<FileSink*>(request.GetBodySink());
+    assert(file && file->Size() == 1000);
+    char tail[4] = {0};
+    assert(pread(file->Fd(), tail, 3, 997) == 3 && strcmp(tail, "bbb") == 0);
+
+    /* 声明的长度超过内存上限: 第一个字节就写入文件, 不按 Content-Length 分配内存; 恰好等于上限时留在内存 */
+    request.Init();
+    buff.Append("POST /up HTTP/1.1\r\nContent-Length: 1000\r\n\r\nx");
+    assert(request.parse(buff) == HttpRequest::NO_REQUEST && dynamic_cast<FileSink*>(request.GetBodySink()));
+    request.Init();
+    buff.Append("POST /up HTTP/1.1\r\nContent-Length: 100\r\n\r\n" + std::string(100, 'y'));
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && !request.GetBodySink() && request.GetBody().str() == std::string(100, 'y'));
+
+    size_t got = 0;
+    request.Init();
+    buff.Append("POST /up HTTP/1.1\r\nContent-Length: 500\r\n\r\n");
+    assert(request.parse(buff) == HttpRequest::NO_REQUEST && request.HeadersDone());
+    request.SetBodySink(std::unique_ptr<BodySink>(new CallbackSink([&got](const char*, size_t len) {
+        got += len;
+        return true;
+    })));
+    buff.Append(std::string(500, 'c'));
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST && got == 500);
+    HttpRequest::maxBodySize = maxBody;
+    HttpRequest::memBodySize = memBody;
+
+    const int N = 100000;
+    long before = allocCount;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < N; i++) {
+        request.Init();
+        buff.RetrieveAll();
+        buff.Append(req);
+        request.parse(buff);
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("HttpRequest parse: %.0fns, %.2f allocs per request\n",
+        std::chrono::duration<double, std::nano>(end - start).count() / N,
+        (double)(allocCount - before) / N);
+}
+
+void TestHttpResponse() {
+    const char* dir = "./testres";
+    mkdir(dir, 0755);
+    FILE* fp = fopen("./testres/a.html", "w");
+    fputs("<html>hello</html>", fp);
+    fclose(fp);
+    FileCache::Instance()->Init(1 << 20, 1000);
+
+    std::shared_ptr<const CachedFile> f1, f2;
+    assert(FileCache::Instance()->Get(dir, "/a.html", 200, f1) == 200);
+    assert(FileCache::Instance()->Get(dir, "/a.html", 200, f2) == 200);
+    assert(f1 == f2 && f1->len == 18);
+    assert(f1->header[1] == "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\nkeep-alive: max=6, timeout=60\r\n"
+                            "Content-type: text/html\r\nContent-length: 18\r\n");
+    /* keep-alive 头部给出实际的空闲超时 */
+    size_t connLen;
+    const char *connLine;
+    SetKeepAliveTimeout(5000);
+    connLine = ConnectionHeader(true, &connLen);
+    assert(std::string(connLine, connLen) == "Connection: keep-alive\r\nkeep-alive: max=6, timeout=5\r\n");
+    SetKeepAliveTimeout(0);
+    connLine = ConnectionHeader(true, &connLen);
+    assert(std::string(connLine, connLen) == "Connection: keep-alive\r\nkeep-alive: max=6\r\n");
+    SetKeepAliveTimeout(60000);
+    assert(FileCache::Instance()->Get(dir, "/none.html", 200, f2) == 404 && !f2);
+    auto date = FileCache::DateLine();
+    assert(date->size() == 37 && date->compare(0, 6, "Date: ") == 0);
+
+    /* 静态文件响应: 头部与文件都不拷贝 */
+    std::string path = "/a.html";
+    HttpResponse response;
+    BufferChain chain;
+    response.Init(dir, path, true, 200);
+    response.MakeResponse(chain);
+    assert(chain.SegmentCount() == 4);
+    assert(chain.ReadableBytes() == f1->header[1].size() + date->size() + 2 + 18);
+
+    /* HEAD: 头部与 GET 相同, 不带内容, 长连接上下一个响应紧接其后 */
+    chain.RetrieveAll();
+    response.Init(dir, path, true, 200, METHOD_HEAD);
+    response.MakeResponse(chain);
+    std::string wire(chain.ReadableBytes(), '\0');
+    chain.Gather(&wire[0], wire.size());
+    chain.RetrieveAll();
+    std::string dateLine = wire.substr(f1->header[1].size(), date->size());
+    assert(dateLine.compare(0, 6, "Date: ") == 0);
+    assert(wire == f1->header[1] + dateLine + "\r\n");
+    response.Init(dir, path, true, 200, METHOD_HEAD);
+    response.SetContent(FindMimeType(".txt", 4), "hello");
+    response.MakeResponse(chain);
+    wire.assign(chain.ReadableBytes(), '\0');
+    chain.Gather(&wire[0], wire.size());
+    chain.RetrieveAll();
+    size_t headLen = wire.find("Date: ");
+    assert(headLen != std::string::npos);
+    assert(wire == wire.substr(0, headLen) + wire.substr(headLen, date->size()) + "Content-length: 5\r\n\r\n");
+    assert(wire.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    response.Init(dir, path, true, 200, METHOD_HEAD);
+    response.SetStream(nullptr, [](StreamWriter&) { assert(false); return false; });
+    response.MakeResponse(chain);
+    assert(!response.IsStreaming());
+    wire.assign(chain.ReadableBytes(), '\0');
+    chain.Gather(&wire[0], wire.size());
+    chain.RetrieveAll();
+    std::string tail = "Transfer-Encoding: chunked\r\n\r\n";
+    assert(wire.size() > tail.size() && wire.compare(wire.size() - tail.size(), tail.size(), tail) == 0);
+
+    /* 处理函数给出的状态码原样发出; 204/304 没有内容也没有 Content-length */
+    response.Init(dir, path, true, 201);
+    response.SetContent(FindMimeType(".txt", 4), "made");
+    response.MakeResponse(chain);
+    wire.assign(chain.ReadableBytes(), '\0');
+    chain.Gather(&wire[0], wire.size());
+    chain.RetrieveAll();
+    assert(wire.compare(0, 22, "HTTP/1.1 201 Created\r\n") == 0 && wire.compare(wire.size() - 8, 8, "\r\n\r\nmade") == 0);
+    response.Init(dir, path, true, 204);
+    response.MakeResponse(chain);
+    wire.assign(chain.ReadableBytes(), '\0');
+    chain.Gather(&wire[0], wire.size());
+    chain.RetrieveAll();
+    assert(wire.compare(0, 25, "HTTP/1.1 204 No Content\r\n") == 0 && wire.find("Content-length") == std::string::npos);
+    assert(wire.compare(wire.size() - 4, 4, "\r\n\r\n") == 0);
+    response.Init(dir, path, true, 299);
+    response.SetContent(FindMimeType(".txt", 4), "x");
+    response.MakeResponse(chain);
+    wire.assign(chain.ReadableBytes(), '\0');
+    chain.Gather(&wire[0], wire.size());
+    chain.RetrieveAll();
+    assert(response.Code() == 299 && wire.compare(0, 15, "HTTP/1.1 299 \r\n") == 0);
+
+    const int N = 100000;
+    long allocs = allocCount;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < N; i++) {
+        chain.RetrieveAll();
+        response.Init(dir, path, i & 1, 200);
+        response.MakeResponse(chain);
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("HttpResponse static file: %ldns, %.2f allocs per response\n",
+        (long)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / N,
+        (double)(allocCount - allocs) / N);
+
+
+    /* 流式响应: 10MB 内容按 16KB 生成, 发送链受水位约束, 对端按 chunked 解码 */
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    const size_t total = 10 * 1024 * 1024, piece = 16 * 1024;
+    std::string received;
+    std::thread reader([&received, &sv]() {
+        char buf[65536];
+        ssize_t n;
+        while((n = read(sv[1], buf, sizeof(buf))) > 0) {
+            received.append(buf, n);
+        }
+    });
+    std::shared_ptr<const std::string> block = std::make_shared<std::string>(piece, 'x');
+    size_t produced = 0, maxBuffered = 0;
+    chain.RetrieveAll();
+    start = std::chrono::steady_clock::now();
+    response.Init(dir, path, true, 200);
+    response.SetStream(FindMimeType(".txt", 4), [&](StreamWriter& writer) {
+        writer.WriteShared(block, block->data(), piece);
+        produced += piece;
+        return produced < total;
+    });
+    response.MakeResponse(chain);
+    assert(chain.ReadableBytes() > 0 && produced > 0 && response.IsStreaming());
+    int err = 0;
+    while(!chain.Empty() || response.IsStreaming()) {
+        if(response.IsStreaming()) {
+            response.Pump(chain);
+        }
+        maxBuffered = std::max(maxBuffered, chain.ReadableBytes());
+        if(chain.WriteFd(sv[0], &err) < 0) {
+            assert(err == EAGAIN);
+            usleep(100);
+        }
+    }
+    close(sv[0]);
+    reader.join();
+    close(sv[1]);
+    end = std::chrono::steady_clock::now();
+    assert(maxBuffered < HttpResponse::STREAM_LOW_WATER + piece + 64);
+    size_t hdrEnd = received.find("\r\n\r\n");
+    assert(received.find("Transfer-Encoding: chunked\r\n") < hdrEnd);
+    size_t bodyBytes = 0, pos = hdrEnd + 4;
+    while(true) {
+        size_t len = strtoul(received.c_str() + pos, nullptr, 16);
+        pos = received.find("\r\n", pos) + 2 + len + 2;
+        bodyBytes += len;
+        if(len == 0) {
+            break;
+        }
+    }
+    assert(bodyBytes == total && pos == received.size());
+    printf("HttpResponse stream %zuMB: %ldms, max buffered %zuKB\n", total >> 20,
+        (long)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(), maxBuffered >> 10);
+
+    /* 数据源暂时没有内容: 连接挂起, 数据源取得的唤醒函数只在挂起后通知一次主线程 */
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    HttpConn conn;
+    conn.init(sv[0], sockaddr_in());
+    std::vector<StreamWakeRef> notified;
+    StreamWake::notify = [&notified](const StreamWakeRef& w) { notified.push_back(w); };
+    std::function<void()> waker;
+    response.Init(dir, path, true, 200);
+    response.SetStream(FindMimeType(".txt", 4), [&](StreamWriter& writer) {
+        waker = writer.Waker();
+        return true;
+    });
+    chain.RetrieveAll();
+    response.Pump(chain, conn.Wake());
+    assert(chain.Empty() && response.IsStreaming() && waker);
+    waker();
+    assert(notified.empty() && !conn.Park());  /* 挂起前已唤醒, 直接继续发送 */
+    assert(conn.Park() && conn.Park());
+    waker();
+    waker();
+    assert(notified.size() == 1 && notified[0] == conn.Wake() && notified[0]->state == StreamWake::WOKEN);
+    notified[0]->state = StreamWake::RUNNING;
+    assert(conn.Park());
+    conn.Close();
+    waker();
+    assert(notified.size() == 1);
+    StreamWake::notify = nullptr;
+    response.StopStream();
+    close(sv[1]);
+
+    /* HTTP/1.0 请求流式响应: 不用 chunked, 即使请求 keep-alive 也以关闭连接结束 */
+    Router streamRouter;
+    streamRouter.Get("/s", [](HttpRequest&, HttpResponse& resp) {
+        auto left = std::make_shared<int>(3);
+        resp.SetStream(FindMimeType(".txt", 4), [left](StreamWriter& writer) {
+            writer.Write("abc");
+            return --*left > 0;
+        });
+    });
+    HttpConn::srcDir = dir;
+    HttpConn::router = &streamRouter;
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    HttpConn conn10;
+    conn10.init(sv[0], sockaddr_in());
+    std::string req10 = "GET /s HTTP/1.0\r\nConnection: keep-alive\r\n\r\n";
+    assert(write(sv[1], req10.data(), req10.size()) == (ssize_t)req10.size());
+    err = 0;
+    assert(conn10.read(&err) > 0 && conn10.process());
+    while(conn10.ToWriteBytes() > 0 || conn10.IsStreaming()) {
+        assert(conn10.write(&err) > 0);
+    }
+    assert(!conn10.IsKeepAlive());
+    conn10.Close();
+    received.clear();
+    char buf10[4096];
+    ssize_t n10;
+    while((n10 = read(sv[1], buf10, sizeof(buf10))) > 0) {
+        received.append(buf10, n10);
+    }
+    close(sv[1]);
+    assert(received.find("Connection: close\r\n") != std::string::npos);
+    assert(received.find("Transfer-Encoding") == std::string::npos);
+    assert(received.compare(received.size() - 13, 13, "\r\n\r\nabcabcabc") == 0);
+    HttpConn::router = nullptr;
+    HttpConn::srcDir = nullptr;
+
+    unlink("./testres/a.html");
+    rmdir(dir);
+}
+
+void TestRouter() {
+    Router router;
+    int hit = -1;
+    auto handler = [&hit](int id) {
+        return [&hit, id](HttpRequest&, HttpResponse&) { hit = id; };
+    };
+    assert(router.Get("/users/:id", handler(1)));
+    assert(router.Get("/users/:id/files/*path", handler(2)));
+    assert(router.Get("/users/me", handler(3)));
+    assert(router.Post("/users/:id", handler(4)));
+    assert(router.Get("/us", handler(5)));
+    assert(!router.Get("/users/:uid/posts", handler(6)));
+    assert(!router.Get("/users/me", handler(7)));
+
+    RouteParams params;
+    bool found = false;
+    auto match = [&](HTTP_METHOD method, const char* path) {
+        const Router::Handler* h = router.Match(method, path, strlen(path), params, &found);
+        hit = -1;
+        if(h) {
+            HttpRequest req;
+            HttpResponse res;
+            (*h)(req, res);
+        }
+        return hit;
+    };
+    assert(match(METHOD_GET, "/users/42") == 1 && params.cnt == 1 && params.values[0] == "42");
+    assert(match(METHOD_GET, "/users/me") == 3 && params.cnt == 0);
+    assert(match(METHOD_GET, "/users/42/files/a/b.txt?x=1") == 2 && params.values[1] == "a/b.txt");
+    assert(match(METHOD_GET, "/us") == 5 && match(METHOD_GET, "/use") == -1 && !found);
+    assert(match(METHOD_POST, "/users/7") == 4);
+    assert(match(METHOD_DELETE, "/users/7") == -1 && found);
+    /* HEAD 沿用 GET 的处理函数; 方法不符时给出路径支持的方法 */
+    assert(match(METHOD_HEAD, "/users/7") == 1 && match(METHOD_HEAD, "/users/me") == 3);
+    std::string allow;
+    assert(!router.Match(METHOD_DELETE, "/users/7", 8, params, &found, &allow) && allow == "GET, HEAD, POST");
+
+    /* 请求经 Dispatch: 参数写入请求, 未匹配走静态文件 */
+    HttpRequest request;
+    HttpResponse response;
+    Buffer buff;
+    std::string path;
+    buff.Append("GET /users/42/files/x.png HTTP/1.1\r\n\r\n");
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+    response.Init("./", request.GetPath(), true, 200);
+    router.Dispatch(request, response);
+    assert(hit == 2 && request.GetParam("id") == "42" && request.GetParam("path") == "x.png");
+    buff.Append("GET /login?from=x HTTP/1.1\r\n\r\n");
+    request.Init();
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+    response.Init("./", request.GetPath(), true, 200);
+    router.Dispatch(request, response);
+    assert(response.GetPath() == "/login.html");
+    buff.Append("DELETE /users/7 HTTP/1.1\r\n\r\n");
+    request.Init();
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+    response.Init("./", request.GetPath(), true, 200);
+    router.Dispatch(request, response);
+    BufferChain chain;
+    response.MakeResponse(chain);
+    std::string wire(chain.ReadableBytes(), '\0');
+    chain.Gather(&wire[0], wire.size());
+    assert(response.Code() == 405 && wire.find("\r\nAllow: GET, HEAD, POST\r\n") != std::string::npos);
+
+    /* 数千条路由, 查找不分配内存, 耗时与路径长度相关而与路由数无关 */
+    Router big;
+    const int N = 5000;
+    for(int i = 0; i < N; i++) {
+        std::string svc = "/api/v" + std::to_string(i % 3) + "/service" + std::to_string(i);
+        assert(big.Get(svc + "/items/:item", handler(i)));
+        assert(big.Post(svc + "/items/:item/tags/:tag", handler(i)));
+        assert(big.Get(svc + "/static/*file", handler(i)));
+    }
+    std::vector<std::string> paths;
+    for(int i = 0; i < 1000; i++) {
+        int k = i * 7 % N;
+        paths.push_back("/api/v" + std::to_string(k % 3) + "/service" + std::to_string(k) + "/items/" + std::to_string(i));
+    }
+    const int M = 1000000;
+    long allocs = allocCount;
+    size_t matched = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < M; i++) {
+        const std::string& p = paths[i % paths.size()];
+        matched += big.Match(METHOD_GET, p.data(), p.size(), params) != nullptr;
+    }
+    auto end = std::chrono::steady_clock::now();
+    assert(matched == M);
+    printf("Router %zu routes: %.0fns, %.2f allocs per lookup\n", big.Size(),
+        std::chrono::duration<double, std::nano>(end - start).count() / M,
+        (double)(allocCount - allocs) / M);
+}
+
+static std::string Unhex(const char* hex) {
+    std::string out;
+    for(; hex[0] && hex[1]; hex += 2) {
+        out += (char)strtol(std::string(hex, 2).c_str(), nullptr, 16);
+    }
+    return out;
+}
+
+static std::string H2Frame(uint8_t type, uint8_t flags, uint32_t id, const std::string& payload) {
+    std::string f;
+    f += (char)(payload.size() >> 16);
+    f += (char)(payload.size() >> 8);
+    f += (char)payload.size();
+    f += (char)type;
+    f += (char)flags;
+    for(int i = 3; i >= 0; i--) {
+        f += (char)(id >> (8 * i));
+    }
+    return f + payload;
+}
+
+void TestHttp2() {
+    /* RFC 7541 C.1 整数编码 */
+    std::string out;
+    HpackEncodeInt(out, 10, 5, 0);
+    HpackEncodeInt(out, 1337, 5, 0);
+    HpackEncodeInt(out, 42, 8, 0);
+    assert(out == Unhex("0a1f9a0a2a"));
+    const uint8_t* p = (const uint8_t*)out.data();
+    uint64_t v;
+    assert(HpackDecodeInt(p, p + 1, 5, v) && v == 10);
+    assert(HpackDecodeInt(p, p + 3, 5, v) && v == 1337);
+    assert(HpackDecodeInt(p, p + 1, 8, v) && v == 42);
+
+    /* RFC 7541 C.4: 同一连接上三个带 Huffman 编码的请求, 动态表逐步增长 */
+    HpackDecoder decoder;
+    const char* blocks[] = {
+        "828684418cf1e3c2e5f23a6ba0ab90f4ff",
+        "828684be5886a8eb10649cbf",
+        "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+    };
+    HeaderList headers;
+    for(const char* hex : blocks) {
+        std::string block = Unhex(hex);
+        headers.clear();
+        assert(decoder.Decode((const uint8_t*)block.data(), block.size(), headers));
+    }
+    assert(headers.size() == 5 && headers[1].second == "https" && headers[2].second == "/index.html");
+    assert(headers[3] == std::make_pair(std::string(":authority"), std::string("www.example.com")));
+    assert(headers[4] == std::make_pair(std::string("custom-key"), std::string("custom-value")));
+    std::string bad = Unhex("41ff");
+    assert(!decoder.Decode((const uint8_t*)bad.data(), bad.size(), headers));
+
+    /* 编码端: 第二次出现时命中动态表, 只占一个字节 */
+    HpackEncoder encoder;
+    HpackDecoder peer;
+    std::string first, second;
+    encoder.Encode(first, "content-type", "text/html", 9, true);
+    encoder.Encode(second, "content-type", "text/html", 9, true);
+    assert(second.size() == 1);
+    headers.clear();
+    assert(peer.Decode((const uint8_t*)first.data(), first.size(), headers));
+    assert(peer.Decode((const uint8_t*)second.data(), second.size(), headers));
+    assert(headers.size() == 2 && headers[1].second == "text/html");
+
+    /* HPACK 炸弹: 一个 4KB 字段加入动态表, 之后每个字节引用一次, 按解码后的大小拒绝 */
+    std::string bomb;
+    HpackEncoder bombEncoder;
+    bombEncoder.Encode(bomb, "x-bomb", std::string(4000, 'a'), true);
+    bomb.append(60000, (char)0xbe);
+    HpackDecoder limited;
+    limited.SetMaxListSize(Http2Session::MAX_HEADER_LIST);
+    headers.clear();
+    assert(!limited.Decode((const uint8_t*)bomb.data(), bomb.size(), headers) && limited.ListTooLarge());
+    assert(headers.size() < 20);
+    headers.clear();
+    assert(limited.Decode((const uint8_t*)first.data(), first.size(), headers) && !limited.ListTooLarge());
+
+    /* 会话: 两个 40KB 文件与一个 404 复用一条连接, DATA 帧按流交错, 受 65535 的连接窗口约束 */
+    const char* dir = "./testh2";
+    mkdir(dir, 0755);
+    std::string big(40 * 1024, 'b');
+    for(const char* name : {"./testh2/a.txt", "./testh2/b.txt"}) {
+        FILE* fp = fopen(name, "w");
+        fwrite(big.data(), 1, big.size(), fp);
+        fclose(fp);
+    }
+    Http2Session session(dir, nullptr);
+    Buffer in;
+    BufferChain chain;
+    HpackEncoder reqEncoder;
+    in.Append(H2_PREFACE, H2_PREFACE_LEN);
+    in.Append(H2Frame(H2_SETTINGS, 0, 0, ""));
+    const char* paths[] = {"/a.txt", "/b.txt", "/none.txt"};
+    for(int i = 0; i < 3; i++) {
+        std::string block;
+        reqEncoder.Encode(block, ":method", "GET", 3, false);
+        reqEncoder.Encode(block, ":path", paths[i], strlen(paths[i]), false);
+        reqEncoder.Encode(block, ":scheme", "http", 4, false);
+        in.Append(H2Frame(H2_HEADERS, H2_FLAG_END_HEADERS | H2_FLAG_END_STREAM, 2 * i + 1, block));
+    }
+    assert(session.Process(in, chain) && in.ReadableBytes() == 0);
+    session.Pump(chain);
+
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    std::string wire;
+    auto drain = [&]() {
+        int err = 0;
+        char buf[65536];
+        while(!chain.Empty()) {
+            assert(chain.WriteFd(sv[0], &err) > 0);
+            ssize_t n;
+            while((n = read(sv[1], buf, sizeof(buf))) > 0) {
+                wire.append(buf, n);
+            }
+        }
+    };
+    auto parse = [&](std::map<uint32_t, size_t>& data, std::vector<uint32_t>& order, std::map<uint32_t, int>& status) {
+        HpackDecoder respDecoder;
+        size_t pos = 0;
+        while(pos + 9 <= wire.size()) {
+            const uint8_t* f = (const uint8_t*)wire.data() + pos;
+            size_t len = (f[0] << 16) | (f[1] << 8) | f[2];
+            uint32_t id = (f[5] << 24) | (f[6] << 16) | (f[7] << 8) | f[8];
+            if(f[3] == H2_DATA) {
+                data[id] += len;
+                order.push_back(id);
+            } else if(f[3] == H2_HEADERS) {
+                HeaderList h;
+                assert(respDecoder.Decode(f + 9, len, h) && h[0].first == ":status");
+                status[id] = atoi(h[0].second.c_str());
+            }
+            pos += 9 + len;
+        }
+        assert(pos == wire.size());
+    };
+    drain();
+    std::map<uint32_t, size_t> data;
+    std::vector<uint32_t> order;
+    std::map<uint32_t, int> status;
+    parse(data, order, status);
+    assert(status[1] == 200 && status[3] == 200 && status[5] == 404);
+    assert(data[1] + data[3] + data[5] == 65535);
+    assert(order.size() >= 3 && order[0] == 1 && order[1] == 3 && order[2] == 5 && order[3] == 1);
+    assert(session.StreamCount() == 2 && !session.WantWrite());
+
+    /* 服务器退出: 已打开的流继续发送, 新流被拒绝, 流全部结束后才写出 GOAWAY */
+    session.Drain(chain);
+    assert(chain.Empty() && !session.IsClosing());
+    std::string block7;
+    reqEncoder.Encode(block7, ":method", "GET", 3, false);
+    reqEncoder.Encode(block7, ":path", "/a.txt", 6, false);
+    reqEncoder.Encode(block7, ":scheme", "http", 4, false);
+    in.Append(H2Frame(H2_HEADERS, H2_FLAG_END_HEADERS | H2_FLAG_END_STREAM, 7, block7));
+    assert(session.Process(in, chain) && session.StreamCount() == 2);
+
+    /* 连接窗口补足后发完剩余数据 */
+    in.Append(H2Frame(H2_WINDOW_UPDATE, 0, 0, Unhex("00100000")));
+    assert(session.Process(in, chain));
+    session.Pump(chain);
+    drain();
+    data.clear();
+    order.clear();
+    parse(data, order, status);
+    assert(data[1] == big.size() && data[3] == big.size() && data[7] == 0 && session.StreamCount() == 0);
+    assert(session.IsClosing() && wire[wire.size() - 17 + 3] == H2_GOAWAY);
+
+    /* 协议错误: 偶数流号的 HEADERS 导致 GOAWAY */
+    in.Append(H2Frame(H2_HEADERS, H2_FLAG_END_HEADERS, 2, ""));
+    assert(!session.Process(in, chain) && session.IsClosing());
+
+    /* 同样的炸弹分在 HEADERS + CONTINUATION 中发给会话: GOAWAY(ENHANCE_YOUR_CALM) */
+    Http2Session bombed(dir, nullptr);
+    Buffer bombIn;
+    bombIn.Append(H2_PREFACE, H2_PREFACE_LEN);
+    bombIn.Append(H2Frame(H2_SETTINGS, 0, 0, ""));
+    bombIn.Append(H2Frame(H2_HEADERS, 0, 1, bomb.substr(0, 16000)));
+    for(size_t pos = 16000; pos < bomb.size(); pos += 16000) {
+        bool last = pos + 16000 >= bomb.size();
+        bombIn.Append(H2Frame(H2_CONTINUATION, last ? H2_FLAG_END_HEADERS : 0, 1, bomb.substr(pos, 16000)));
+    }
+    drain();
+    wire.clear();
+    assert(!bombed.Process(bombIn, chain) && bombed.IsClosing());
+    drain();
+    assert(wire.size() >= 17 && wire[wire.size() - 17 + 3] == H2_GOAWAY && wire.back() == H2_ENHANCE_YOUR_CALM);
+    close(sv[0]);
+    close(sv[1]);
+    unlink("./testh2/a.txt");
+    unlink("./testh2/b.txt");
+    rmdir(dir);
+}
+
+/* 生成自签名证书, 写入 PEM 文件 */
+static void MakeSelfSigned(const char* certFile, const char* keyFile) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* x509 = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+    X509_set_pubkey(x509, key);
+    X509_NAME* name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+    X509_sign(x509, key, EVP_sha256());
+    FILE* fp = fopen(certFile, "w");
+    PEM_write_X509(fp, x509);
+    fclose(fp);
+    fp = fopen(keyFile, "w");
+    PEM_write_PrivateKey(fp, key, nullptr, nullptr, 0, nullptr, nullptr);
+    fclose(fp);
+    X509_free(x509);
+    EVP_PKEY_free(key);
+}
+
+void TestTls() {
+    mkdir("./testtls", 0755);
+    MakeSelfSigned("./testtls/cert.pem", "./testtls/key.pem");
+    TlsContext server;
+    assert(!server.Init("./testtls/none.pem", "./testtls/key.pem"));
+    assert(server.Init("./testtls/cert.pem", "./testtls/key.pem"));
+
+    SSL_CTX* clientCtx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_max_proto_version(clientCtx, TLS1_2_VERSION);
+    SSL_SESSION* session = nullptr;
+    const size_t total = 1 << 20;
+    for(int round = 0; round < 2; round++) {
+        int sv[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+        fcntl(sv[0], F_SETFL, O_NONBLOCK);
+        /* 客户端: 发一个请求, 收 1MB 响应, 第二轮用上一轮的会话恢复 */
+        bool reused = false;
+        std::string received;
+        std::thread client([&]() {
+            SSL* ssl = SSL_new(clientCtx);
+            SSL_set_fd(ssl, sv[1]);
+            static const unsigned char alpn[] = "\x02h2\x08http/1.1";
+            SSL_set_alpn_protos(ssl, alpn, sizeof(alpn) - 1);
+            if(session) {
+                SSL_set_session(ssl, session);
+            }
+            assert(SSL_connect(ssl) == 1);
+            reused = SSL_session_reused(ssl);
+            SSL_write(ssl, "GET / HTTP/1.1\r\n\r\n", 18);
+            char buf[65536];
+            int n;
+            while(received.size() < total && (n = SSL_read(ssl, buf, sizeof(buf))) > 0) {
+                received.append(buf, n);
+            }
+            if(!session) {
+                session = SSL_get1_session(ssl);
+            }
+            SSL_shutdown(ssl);
+            SSL_free(ssl);
+        });
+
+        std::unique_ptr<TlsConn> conn(server.NewConn(sv[0]));
+        Buffer in;
+        int err = 0;
+        while(in.ReadableBytes() < 18) {
+            ssize_t n = conn->Read(in, &err);
+            assert(n > 0 || (n < 0 && err == EAGAIN));
+            if(n < 0) {
+                usleep(100);
+            }
+        }
+        assert(conn->HandshakeDone() && conn->IsH2());
+        assert(in.RetrieveAllToStr() == "GET / HTTP/1.1\r\n\r\n");
+
+        /* 发送链中的小片段合并成记录后加密 */
+        BufferChain chain;
+        std::shared_ptr<const std::string> body = std::make_shared<std::string>(total - 6, 'z');
+        chain.AppendStatic("HTTP/1", 6);
+        chain.AppendShared(body, body->data(), body->size());
+        while(!chain.Empty()) {
+            if(conn->Write(chain, &err) < 0) {
+                assert(err == EAGAIN);
+                usleep(100);
+            }
+        }
+        client.join();
+        assert(received.size() == total && received.compare(0, 7, "HTTP/1z") == 0);
+        assert(reused == (round == 1));
+        conn->Shutdown();
+        conn.reset();
+        close(sv[0]);
+        close(sv[1]);
+    }
+    SSL_SESSION_free(session);
+    SSL_CTX_free(clientCtx);
+    unlink("./testtls/cert.pem");
+    unlink("./testtls/key.pem");
+    rmdir("./testtls");
+}
+
+void TestMetrics() {
+    /* 分桶: 小值精确, 桶号单调, 相对误差不超过 1/8 */
+    size_t last = 0;
+    for(uint64_t v = 0; v < (1ull << 20); v = v < 64 ? v + 1 : v + v / 7) {
+        size_t idx = Histogram::BucketIndex(v);
+        assert(idx >= last && idx < Histogram::BUCKETS);
+        last = idx;
+        uint64_t upper = Histogram::BucketUpper(idx);
+        assert(upper >= v && (v < Histogram::SUB_BUCKETS * 2 ? upper == v : upper - v <= v / Histogram::SUB_BUCKETS));
+        assert(idx == 0 || Histogram::BucketUpper(idx - 1) < v);
+    }
+    assert(Histogram::BucketIndex(~0ull) == Histogram::BUCKETS - 1);
+
+    Histogram hist;
+    for(uint64_t v = 1; v <= 10000; v++) {
+        hist.Record(v * 1000);
+    }
+    assert(hist.Count() == 10000 && hist.Sum() == 1000ull * 10000 * 10001 / 2);
+    uint64_t p50 = hist.Percentile(0.5), p99 = hist.Percentile(0.99);
+    assert(p50 >= 5000000 && p50 <= 5000000 * 9 / 8);
+    assert(p99 >= 9900000 && p99 <= 9900000 * 9 / 8);
+    assert(hist.Percentile(1.0) >= 10000000);
+
+    /* 多线程各写自己的分片, 合并后不丢计数 */
+    Metrics* metrics = Metrics::Instance();
+    uint64_t before = metrics->Counter(MC_BYTES_IN);
+    uint64_t before404 = metrics->StatusCount(404);
+    uint64_t beforeParse = metrics->Snapshot(MH_PARSE).Count();
+    const int threads = 4, loops = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; t++) {
+        workers.emplace_back([]() {
+            for(int i = 0; i < loops; i++) {
+                Metrics::Add(MC_BYTES_IN, 2);
+                Metrics::Observe(MH_PARSE, i);
+            }
+            Metrics::Status(404);
+        });
+    }
+    for(auto& w : workers) { w.join(); }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    assert(metrics->Counter(MC_BYTES_IN) - before == 2ull * threads * loops);
+    assert(metrics->StatusCount(404) - before404 == threads);
+    assert(metrics->Snapshot(MH_PARSE).Count() - beforeParse == 1ull * threads * loops);
+    printf("Metrics %d threads: %.2fns per counter + histogram update, %zu shards\n",
+           threads, (double)ns / threads / loops, metrics->ShardCount());
+
+    /* Prometheus 文本 */
+    metrics->AddGauge("test_gauge", "Test gauge.", []() { return 42.0; });
+    std::string text = metrics->Render();
+    metrics->ClearGauges();
+    assert(text.find("# TYPE webserver_received_bytes_total counter\n") != std::string::npos);
+    assert(text.find("webserver_http_responses_total{code=\"404\"} ") != std::string::npos);
+    assert(text.find("# TYPE webserver_request_parse_seconds histogram\n") != std::string::npos);
+    assert(text.find("webserver_request_parse_seconds_bucket{le=\"+Inf\"} ") != std::string::npos);
+    assert(text.find("webserver_latency_quantile_seconds{phase=\"parse\",quantile=\"0.99\"} ") != std::string::npos);
+    assert(text.find("webserver_test_gauge 42\n") != std::string::npos);
+    assert(metrics->Render().find("test_gauge") == std::string::npos);
+}
+
+void TestTracer() {
+    Tracer* tracer = Tracer::Instance();
+    assert(!Tracer::Enabled() && !Tracer::Sample());
+    tracer->SetSampleRate(4);
+    int sampled = 0;
+    for(int i = 0; i < 100; i++) {
+        sampled += Tracer::Sample();
+    }
+    assert(sampled == 25);
+
+    /* 环形缓冲区只保留最近 RING_SIZE 个 */
+    TraceSpan span;
+    memset(&span, 0, sizeof(span));
+    span.method = "GET";
+    span.code = 200;
+    for(size_t i = 0; i < Tracer::RING_SIZE + 10; i++) {
+        span.fd = static_cast<int>(i);
+        for(int p = 0; p < TRACE_PHASE_COUNT; p++) {
+            span.ts[p] = 1000000 + i * 1000 + p * 100;
+        }
+        Tracer::Record(span);
+    }
+    assert(tracer->Count() == Tracer::RING_SIZE);
+    std::string json = tracer->Dump(true);
+    assert(tracer->Count() == 0);
+    assert(json.find("\"tid\":9,") == std::string::npos && json.find("\"tid\":10,") != std::string::npos);
+
+    /* 缺失的时间点跳过, 路径中的引号转义 */
+    memset(span.ts, 0, sizeof(span.ts));
+    span.fd = 7;
+    snprintf(span.path, sizeof(span.path), "/a\"b");
+    span.ts[TP_START] = 2000;
+    span.ts[TP_PARSED] = 3500;
+    span.ts[TP_BUILT] = 4000;
+    span.ts[TP_LAST_BYTE] = 9000;
+    Tracer::Record(span);
+    json = tracer->Dump();
+    assert(json.find("{\"name\":\"GET /a\\\"b\",\"cat\":\"http\",\"ph\":\"X\",\"ts\":2.000,\"dur\":7.000,\"pid\":1,\"tid\":7") != std::string::npos);
+    assert(json.find("\"name\":\"read+parse\",\"cat\":\"http\",\"ph\":\"X\",\"ts\":2.000,\"dur\":1.500") != std::string::npos);
+    assert(json.find("\"name\":\"send\",\"cat\":\"http\",\"ph\":\"X\",\"ts\":4.000,\"dur\":5.000") != std::string::npos);
+    assert(json.find("dispatch") == std::string::npos && json.find("send wait") == std::string::npos);
+    tracer->Dump(true);
+    tracer->SetSampleRate(0);
+}
+
+void TestBuffer() {
+    Buffer buff(64);
+    std::string data(1000, 'a');
+    buff.Append(data);
+    assert(buff.ReadableBytes() == 1000 && buff.Capacity() >= 1000);
+    buff.Retrieve(600);
+    buff.Append(data);
+    assert(buff.ReadableBytes() == 1400);
+    assert(std::string(buff.Peek(), 400) == std::string(400, 'a'));
+    buff.RetrieveAll();
+    buff.ShrinkToFit();
+    assert(buff.Capacity() == 64 && buff.ReadableBytes() == 0);
+
+    /* FIONREAD 预留不超过 sizeHint, 其余留在内核中 */
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    int sockBuf = 1 << 20;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sockBuf, sizeof(sockBuf));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &sockBuf, sizeof(sockBuf));
+    std::string big(256 * 1024, 'r');
+    assert(write(sv[0], big.data(), big.size()) == (ssize_t)big.size());
+    int err = 0;
+    ssize_t got = buff.ReadFd(sv[1], &err, 4096);
+    assert(got > 0 && (size_t)got <= 4096 + 65536 && buff.Capacity() < big.size());
+    got = buff.ReadFd(sv[1], &err, big.size());
+    assert(buff.ReadableBytes() == big.size());
+    close(sv[0]);
+    close(sv[1]);
+    buff.RetrieveAll();
+    buff.ShrinkToFit();
+
+    /* 模拟请求: 追加报文后逐行取出 */
+    const std::string req = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n"
+        "Connection: keep-alive\r\nAccept: text/html\r\n\r\n";
+    const int N = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < N; i++) {
+        buff.Append(req);
+        while(buff.ReadableBytes() > 16) {
+            buff.Retrieve(16);
+        }
+        buff.RetrieveAll();
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("Buffer append/retrieve: %.1fns per request\n",
+        std::chrono::duration<double, std::nano>(end - start).count() / N);
+}
+
+void TestBufferChain() {
+    BufferChain chain;
+    auto body = std::make_shared<std::string>(100000, 'b');
+    chain.AppendStatic("HTTP/1.1 200 OK\r\n");
+    chain.Append("Content-length: ", 16);
+    chain.Append(std::to_string(body->size()) + "\r\n\r\n");
+    chain.AppendShared(body, body->data(), body->size());
+    assert(chain.SegmentCount() == 3);
+    std::string expect = "HTTP/1.1 200 OK\r\nContent-length: 100000\r\n\r\n" + *body;
+    assert(chain.ReadableBytes() == expect.size());
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    std::string got;
+    char buf[4096];
+    int err = 0;
+    while(!chain.Empty()) {
+        assert(chain.WriteFd(fds[1], &err) > 0 || err == EAGAIN);
+        while(got.size() < expect.size() - chain.ReadableBytes()) {
+            ssize_t n = read(fds[0], buf, sizeof(buf));
+            got.append(buf, n);
+        }
+    }
+    close(fds[0]);
+    close(fds[1]);
+    assert(got == expect);
+
+    /* 始终不清空的链(HTTP/2, 长时间的流): 已取出的片段与小块被回收, 稳定后不再分配 */
+    std::string piece(100, 'p');
+    chain.AppendStatic("x", 1);
+    for(int i = 0; i < 1000; i++) {
+        chain.Append(piece);
+        chain.AppendStatic("\r\n", 2);
+        chain.Retrieve(chain.ReadableBytes() - 1);
+    }
+    long allocs = allocCount;
+    for(int i = 0; i < 100000; i++) {
+        chain.Append(piece);
+        chain.AppendStatic("\r\n", 2);
+        chain.Retrieve(chain.ReadableBytes() - 1);
+    }
+    assert(allocCount - allocs == 0 && chain.SegmentCount() == 1 && chain.ReadableBytes() == 1);
+    chain.Append(piece);
+    std::string tail(chain.ReadableBytes(), '\0');
+    chain.Gather(&tail[0], tail.size());
+    assert(tail == "\n" + piece);
+}
+
+static long RssKB() {
+    long pages = 0, rss = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if(fp) {
+        if(fscanf(fp, "%ld %ld", &pages, &rss) != 2) { rss = 0; }
+        fclose(fp);
+    }
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void TestHeapTimer() {
+    HeapTimer timer;
+    std::vector<int> fired;
+    /* 回调中重新加入自己: 超时检查未到期时按剩余时间重新排队 */
+    int rearm = 2;
+    std::function<void()> check = [&] {
+        fired.push_back(1);
+        if(rearm-- > 0) {
+            timer.add(1, 0, check);
+        }
+    };
+    timer.add(1, 0, check);
+    timer.add(2, 0, [&] { fired.push_back(2); });
+    timer.add(3, 60000, [&] { fired.push_back(3); });
+    usleep(2000);
+    timer.tick();
+    timer.tick();
+    timer.tick();
+    assert(std::count(fired.begin(), fired.end(), 1) == 3 && std::count(fired.begin(), fired.end(), 2) == 1);
+    assert(timer.size() == 1 && timer.GetNextTick() > 50000);
+    /* doWork 先删除再回调, 回调中同样可以重新加入 */
+    timer.doWork(3);
+    assert(fired.back() == 3 && timer.size() == 0);
+    timer.add(4, 60000, [&] { timer.add(4, 30000, [&] { fired.push_back(5); }); });
+    timer.doWork(4);
+    assert(timer.size() == 1 && timer.GetNextTick() <= 30000);
+}
+
+void TestConnSlab() {
+    /* 空闲连接不持有缓冲区, 只占连接对象本身 */
+    const int N = 1 << 20;
+    long before = RssKB();
+    {
+        ConnSlab slab(N);
+        for(int fd = 0; fd < N; fd++) {
+            assert(slab.Get(fd)->ToWriteBytes() == 0);
+        }
+        assert(slab.Find(N - 1) == slab.Get(N - 1));
+        printf("ConnSlab %d idle conns: sizeof(HttpConn)=%zu, %ldMB\n",
+            N, sizeof(HttpConn), (RssKB() - before) / 1024);
+    }
+    auto buff = BufferPool::Instance()->Acquire();
+    buff->Append("abc", 3);
+    BufferPool::Instance()->Release(std::move(buff));
+    buff = BufferPool::Instance()->Acquire();
+    assert(buff->ReadableBytes() == 0);
+}
+
+void TestAdmission() {
+    AdmissionConfig config;
+    config.maxConns = 100;
+    config.perIpConns = 3;
+    config.connRate = 1000;
+    config.burstSec = 0.005;
+    config.reqRate = 100;
+    config.maxQueueDelayMs = 10;
+    Admission admission(config);
+    const uint32_t ip = inet_addr("10.0.0.1"), other = inet_addr("10.0.0.2");
+
+    /* 单 IP 并发上限, 关闭一个后可以再进 */
+    for(int i = 0; i < 3; i++) {
+        assert(admission.OnAccept(ip, i, false) == Admission::ADMIT);
+    }
+    assert(admission.OnAccept(ip, 3, false) == Admission::THROTTLED);
+    assert(admission.OnAccept(other, 3, false) == Admission::ADMIT);
+    admission.OnClose(ip);
+    assert(admission.OnAccept(ip, 3, false) == Admission::ADMIT);
+    assert(admission.OnAccept(ip, 100, false) == Admission::FULL);
+    assert(admission.OnAccept(inet_addr("10.0.0.3"), 4, true) == Admission::OVERLOADED);
+    assert(admission.Overloaded(20 * 1000000) && !admission.Overloaded(5 * 1000000));
+
+    /* 新建连接的令牌桶: 容量 5, 用完后约 1ms 补回一个 */
+    const uint32_t burst = inet_addr("10.0.1.1");
+    int admitted = 0;
+    for(int i = 0; i < 5; i++) {
+        if(admission.OnAccept(burst, 0, false) == Admission::ADMIT) {
+            admitted++;
+            admission.OnClose(burst);
+        }
+    }
+    assert(admitted == 5);
+    assert(admission.OnAccept(burst, 0, false) == Admission::THROTTLED);
+    usleep(3000);
+    assert(admission.OnAccept(burst, 0, false) == Admission::ADMIT);
+
+    /* 请求配额: 桶容量 1, 欠额以后拒绝 */
+    assert(admission.OnRequests(other, 1));
+    assert(!admission.OnRequests(other, 5));
+    assert(admission.OnRequests(inet_addr("10.9.9.9"), 100)); /* 没有连接记录的 IP 不限 */
+
+    /* 大量来源依次连接并断开, 空闲槽位被复用 */
+    for(uint32_t i = 0; i < 100000; i++) {
+        uint32_t addr = htonl(0x0b000000 + i);
+        assert(admission.OnAccept(addr, 0, false) == Admission::ADMIT);
+        admission.OnClose(addr);
+    }
+
+    size_t len = 0;
+    std::string resp = Admission::Response(Admission::OVERLOADED, &len);
+    assert(resp.size() == len && resp.find(" 503 ") != std::string::npos);
+    assert(resp.size() - resp.find("\r\n\r\n") - 4 == 12);
+    resp = Admission::Response(Admission::THROTTLED, &len);
+    assert(resp.size() == len && resp.find(" 429 ") != std::string::npos);
+    assert(resp.size() - resp.find("\r\n\r\n") - 4 == 18);
+
+    /* 线程池排队延迟: 单线程执行慢任务, 后面的任务都要等 */
+    ThreadPool pool(1);
+    std::atomic<int> done(0);
+    for(int i = 0; i < 20; i++) {
+        pool.AddTask([&done] { usleep(1000); done++; });
+    }
+    while(done < 20) {
+        usleep(1000);
+    }
+    printf("ThreadPool queue delay after 20 x 1ms tasks: %.2fms\n", pool.QueueDelay() / 1e6);
+    assert(pool.QueueDelay() > 1000000);
+
+    /* 重新加载: 从不限制到单 IP 限制, 表变大时保留已有连接计数 */
+    AdmissionConfig open;
+    open.maxConns = 100;
+    Admission reload(open);
+    assert(reload.OnAccept(ip, 0, false) == Admission::ADMIT && reload.OnAccept(ip, 1, false) == Admission::ADMIT);
+    open.perIpConns = 2;
+    reload.Reload(open);
+    assert(reload.OnAccept(ip, 2, false) == Admission::ADMIT);
+    assert(reload.OnAccept(ip, 3, false) == Admission::ADMIT);
+    assert(reload.OnAccept(ip, 4, false) == Admission::THROTTLED);
+    open.maxConns = 10000;
+    reload.Reload(open);
+    assert(reload.OnAccept(ip, 4, false) == Admission::THROTTLED);
+    reload.OnClose(ip);
+    assert(reload.OnAccept(ip, 3, false) == Admission::ADMIT);
+    assert(reload.OnAccept(ip, 10000, false) == Admission::FULL);
+}
+
+void TestConfig() {
+    ServerConfig config;
+    std::string err;
+    assert(config.port == 1316 && config.admission.maxQueueDelayMs == 100);
+    assert(Config::Set(config, "threads", "8", &err) && config.threadNum == 8);
+    assert(Config::Set(config, "cache.max_bytes", "16M", &err) && config.cacheBytes == 16u << 20);
+    assert(Config::Set(config, "admission.conn_rate", "2.5", &err) && config.admission.connRate == 2.5);
+    assert(Config::Set(config, "linger", "on", &err) && config.optLinger);
+    assert(Config::Set(config, "user_db", "./bin/user.db", &err) && config.localUserDb == "./bin/user.db");
+    assert(Config::Get(config, "cache.max_bytes") == "16777216" && Config::Get(config, "linger") == "true");
+    assert(!Config::Set(config, "port", "80", &err) && err.find("port") != std::string::npos);
+    assert(!Config::Set(config, "threads", "1.5", &err) && !Config::Set(config, "threads", "8x", &err));
+    assert(!Config::Set(config, "linger", "maybe", &err) && !Config::Set(config, "nope", "1", &err));
+    assert(!Config::Set(config, "idle_timeout_ms", "3000000000", &err) && config.timeoutMs == 60000);
+    assert(Config::Set(config, "timeout.drain_ms", "2147483647", &err) && config.timeouts.drainMs == INT_MAX);
+    assert(Config::Reloadable("log_level") && !Config::Reloadable("threads") && !Config::Reloadable("nope"));
+    assert(Config::Secret("sql.password") && !Config::Secret("sql.user") && !Config::Secret("nope"));
+
+    /* 文件: 注释与空行, 值中可以有 # 与 =; 命令行覆盖文件 */
+    const char* path = "./testconfig.conf";
+    FILE* fp = fopen(path, "w");
+    fputs("# comment\n\nport = 2000\n  log_level=2  \nsql.password = a#b=c\ntimeout.header_ms = 500\n", fp);
+    fclose(fp);
+    const char* argv[] = {"server", "-c", path, "--port=3000", "--threads", "2"};
+    ServerConfig parsed;
+    assert(Config::Parse(6, (char**)argv, parsed, &err));
+    assert(parsed.port == 3000 && parsed.threadNum == 2 && parsed.logLevel == 2);
+    assert(parsed.sqlPwd == "a#b=c" && parsed.timeouts.headerMs == 500);
+
+    /* 重新加载: 文件修改后重新生成, 命令行的值仍然优先 */
+    fp = fopen(path, "w");
+    fputs("port = 2000\nlog_level = 3\n", fp);
+    fclose(fp);
+    ServerConfig next = parsed;
+    assert(Config::Load(next, &err) && next.port == 3000 && next.logLevel == 3 && next.timeouts.headerMs == 10000);
+    std::vector<std::string> diff = Config::Diff(parsed, next);
+    assert(diff.size() == 3 && diff[0] == "log_level" && diff[1] == "sql.password" && diff[2] == "timeout.header_ms");
+
+    /* Dump 的输出可以原样读回 */
+    fp = fopen(path, "w");
+    fputs(Config::Dump(parsed).c_str(), fp);
+    fclose(fp);
+    ServerConfig dumped;
+    assert(Config::LoadFile(path, dumped, &err) && Config::Diff(parsed, dumped).empty());
+
+    fp = fopen(path, "w");
+    fputs("port = 2000\nthreads\n", fp);
+    fclose(fp);
+    assert(!Config::LoadFile(path, dumped, &err) && err.find(":2:") != std::string::npos);
+    unlink(path);
+}
+
+void TestAffinity() {
+    std::vector<int> cpus;
+    assert(ParseCpuList("0-2,5", &cpus) && cpus == std::vector<int>({0, 1, 2, 5}));
+    assert(ParseCpuList(" 3, 1\n", &cpus) && cpus == std::vector<int>({3, 1}));
+    assert(ParseCpuList("", &cpus) && cpus.empty());
+    for(const char* bad : {"3-1", "1x", "-1", "0,,1", "2-", "0,", "1024"}) {
+        assert(!ParseCpuList(bad, &cpus));
+    }
+    ServerConfig config;
+    std::string err;
+    assert(!Config::Set(config, "cpu.workers", "2-", &err) && Config::Set(config, "cpu.workers", "0", &err));
+
+    /* 默认不做任何限制 */
+    Placement plan;
+    ServerConfig defaults;
+    assert(PlanPlacement(defaults, &plan, &err));
+    assert(plan.reactor.empty() && plan.workers.empty() && plan.node == -1);
+    config.cpuReactor = 0;
+    assert(PlanPlacement(config, &plan, &err));
+    assert(plan.reactor == std::vector<int>({0}) && plan.workers.size() == 1 && plan.workers[0] == std::vector<int>({0}));
+    assert(plan.node == (plan.cpuNode.empty() ? -1 : plan.cpuNode[0]));
+    config.cpuReactor = 1023;
+    assert(!PlanPlacement(config, &plan, &err) && err.find("1023") != std::string::npos);
+
+    Placement remote;
+    remote.cpuNode = {0, 1, -1};
+    remote.node = 0;
+    assert(remote.Remote(1) && !remote.Remote(0) && !remote.Remote(2) && !remote.Remote(-1) && !remote.Remote(7));
+
+    /* 每个工作线程启动时各调用一次 onStart */
+    std::atomic<int> started(0);
+    {
+        ThreadPool pool(3, [&](size_t i) {
+            started.fetch_or(1 << i);
+            assert(PinThread({0}) && sched_getcpu() == 0);
+        });
+    }
+    assert(started == 7);
+}
+
+void TestLocalAuth() {
+    const char* path = "./testuser.db";
+    unlink(path);
+    const int N = 100000;
+    {
+        LocalAuth auth(path);
+        assert(auth.IsOpen());
+        for(int i = 0; i < N; i++) {
+            assert(auth.Register("user" + std::to_string(i), "pwd" + std::to_string(i)));
+        }
+        assert(!auth.Register("user0", "other"));
+    }
+    auto start = std::chrono::steady_clock::now();
+    LocalAuth auth(path);
+    auto loaded = std::chrono::steady_clock::now();
+    assert(auth.UserCount() == N);
+    for(int i = 0; i < N; i++) {
+        assert(auth.Login("user" + std::to_string(i), "pwd" + std::to_string(i)));
     }
-    getchar();
+    assert(!auth.Login("user1", "pwd0"));
+    auto end = std::chrono::steady_clock::now();
+    printf("LocalAuth load %d users: %ldus, login QPS: %.0f\n", N,
+        (long)std::chrono::duration_cast<std::chrono::microseconds>(loaded - start).count(),
+        N / std::chrono::duration<double>(end - loaded).count());
 }
 
 int main() {
+    TestBuffer();
+    TestBufferChain();
+    TestConnSlab();
+    TestHeapTimer();
+    TestAdmission();
+    TestConfig();
+    TestAffinity();
+    TestHttpRequest();
+    TestHttpResponse();
+    TestRouter();
+    TestHttp2();
+    TestTls();
+    TestMetrics();
+    TestTracer();
+    TestLocalAuth();
     TestLog();
     TestThreadPool();
 }
\ No newline at end of file